@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2015-2019 Dubalu LLC. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "benchmark/benchmark.h"
+
+#include <regex>
+#include <string>
+#include <vector>
+
+#include "datetime.h"
+#include "datetime_match.hh"
+
+
+static const std::regex date_re(R"(([0-9]{4})([-/ ]?)(0[1-9]|1[0-2])\2(0[0-9]|[12][0-9]|3[01])([T ]?([01]?[0-9]|2[0-3]):([0-5][0-9])(:([0-5][0-9])([.,]([0-9]+))?)?([ ]*[+-]([01]?[0-9]|2[0-3]):([0-5][0-9])|Z)?)?([ ]*\|\|[ ]*([+-/\dyMwdhms]+))?)", std::regex::optimize);
+static const std::regex date_math_re("([+-]\\d+|\\/{1,2})([dyMwhms])", std::regex::optimize);
+
+
+// A mix of dates not handled by Iso8601Parser and strings that are not dates,
+// which is what guessing field types sees most of the time.
+static const std::vector<std::string> dates{
+	"2019-01-01 10:00:00.123 +05:30",
+	"2019/12/31T23:59:59||+1d/M",
+	"20190101T1:00Z",
+	"2019-01-01 || -10y//d",
+	"Hello World",
+	"123456789",
+	"2019-02-30T24:00",
+	"not a date at all",
+};
+
+
+static void BM_DateRegex(benchmark::State& state) {
+	std::cmatch m;
+	while (state.KeepRunning()) {
+		for (const auto& date : dates) {
+			benchmark::DoNotOptimize(std::regex_match(date.c_str(), date.c_str() + date.size(), m, date_re));
+		}
+	}
+	state.SetItemsProcessed(state.iterations() * dates.size());
+}
+BENCHMARK(BM_DateRegex);
+
+
+static void BM_DateMatch(benchmark::State& state) {
+	Datetime::DateMatch m;
+	while (state.KeepRunning()) {
+		for (const auto& date : dates) {
+			benchmark::DoNotOptimize(m.match(date));
+		}
+	}
+	state.SetItemsProcessed(state.iterations() * dates.size());
+}
+BENCHMARK(BM_DateMatch);
+
+
+static void BM_DateMathRegex(benchmark::State& state) {
+	const std::string date_math("+1y-2M+3w/d//h+10m-59s");
+	while (state.KeepRunning()) {
+		std::cregex_iterator next(date_math.c_str(), date_math.c_str() + date_math.size(), date_math_re, std::regex_constants::match_continuous);
+		std::cregex_iterator end;
+		size_t size_match = 0;
+		for (; next != end; ++next) {
+			size_match += next->length(0);
+		}
+		benchmark::DoNotOptimize(size_match);
+	}
+}
+BENCHMARK(BM_DateMathRegex);
+
+
+static void BM_DateMathMatch(benchmark::State& state) {
+	const std::string date_math("+1y-2M+3w/d//h+10m-59s");
+	while (state.KeepRunning()) {
+		benchmark::DoNotOptimize(Datetime::date_math_match(date_math, [](std::string_view, char) { }));
+	}
+}
+BENCHMARK(BM_DateMathMatch);
+
+
+static void BM_IsDate(benchmark::State& state) {
+	while (state.KeepRunning()) {
+		for (const auto& date : dates) {
+			benchmark::DoNotOptimize(Datetime::isDate(date));
+		}
+	}
+	state.SetItemsProcessed(state.iterations() * dates.size());
+}
+BENCHMARK(BM_IsDate);
+
+BENCHMARK_MAIN();
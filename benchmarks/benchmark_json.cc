@@ -0,0 +1,164 @@
+/*
+ * Copyright (C) 2019 Dubalu LLC. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "benchmark/benchmark.h"
+
+#include <string>
+
+#include "database_utils.h"
+#include "msgpack.h"
+#include "msgpack.hpp"
+#include "rapidjson/document.h"
+#include "xchange/rapidjson.hpp"
+#include "xchange/rapidjson_sax.hpp"
+
+
+// Small document, as typically indexed one at a time.
+static const std::string tweet = R"({
+	"_id": 1,
+	"user": "Kronuz",
+	"postDate": "2016-11-15T13:12:00",
+	"message": "Trying out Xapiand, so far, so good... so what!",
+	"retweets": 12,
+	"score": 0.75,
+	"sensitive": false,
+	"tags": ["xapiand", "search", "engine"],
+	"location": {"_point": {"_latitude": 40.4165, "_longitude": -3.70256}},
+})";
+
+
+// Bigger document with nested objects and arrays of numbers.
+static std::string
+make_document(int entries)
+{
+	std::string json = "{\"_id\": \"doc\", \"entries\": [";
+	for (int i = 0; i < entries; ++i) {
+		if (i) {
+			json += ", ";
+		}
+		json += "{\"name\": \"entry " + std::to_string(i) + "\", \"value\": " + std::to_string(i * 31) + ", \"ratio\": " + std::to_string(i / 7.0) + ", \"active\": " + (i % 2 ? "true" : "false") + ", \"ids\": [1, 2, 3, -4, 5000000000]}";
+	}
+	json += "]}";
+	return json;
+}
+
+
+static void
+dom_parse(const std::string& json)
+{
+	rapidjson::Document doc;
+	doc.Parse<rapidjson::kParseCommentsFlag | rapidjson::kParseTrailingCommasFlag>(json.data(), json.size());
+	msgpack::zone zone;
+	msgpack::object obj(doc, zone);
+	benchmark::DoNotOptimize(obj);
+}
+
+
+static void
+sax_parse(const std::string& json)
+{
+	msgpack::zone zone;
+	msgpack::object obj;
+	msgpack::json_parse(zone, json, obj);
+	benchmark::DoNotOptimize(obj);
+}
+
+
+// What the server actually does with request bodies: a MsgPack (zone
+// included) out of the JSON, swapped in place (assigning would copy it).
+static void
+json_load_parse(const std::string& json)
+{
+	MsgPack body;
+	auto obj = json_load(json);
+	body.swap(obj);
+	benchmark::DoNotOptimize(body);
+}
+
+
+static void BM_JSON_DOM_Tweet(benchmark::State& state) {
+	while (state.KeepRunning()) {
+		dom_parse(tweet);
+	}
+	state.SetBytesProcessed(state.iterations() * tweet.size());
+}
+BENCHMARK(BM_JSON_DOM_Tweet);
+
+static void BM_JSON_SAX_Tweet(benchmark::State& state) {
+	while (state.KeepRunning()) {
+		sax_parse(tweet);
+	}
+	state.SetBytesProcessed(state.iterations() * tweet.size());
+}
+BENCHMARK(BM_JSON_SAX_Tweet);
+
+static void BM_JSON_Load_Tweet(benchmark::State& state) {
+	while (state.KeepRunning()) {
+		json_load_parse(tweet);
+	}
+	state.SetBytesProcessed(state.iterations() * tweet.size());
+}
+BENCHMARK(BM_JSON_Load_Tweet);
+
+static void BM_JSON_DOM_Document(benchmark::State& state) {
+	auto json = make_document(state.range(0));
+	while (state.KeepRunning()) {
+		dom_parse(json);
+	}
+	state.SetBytesProcessed(state.iterations() * json.size());
+}
+BENCHMARK(BM_JSON_DOM_Document)->Arg(10)->Arg(1000);
+
+static void BM_JSON_SAX_Document(benchmark::State& state) {
+	auto json = make_document(state.range(0));
+	while (state.KeepRunning()) {
+		sax_parse(json);
+	}
+	state.SetBytesProcessed(state.iterations() * json.size());
+}
+BENCHMARK(BM_JSON_SAX_Document)->Arg(10)->Arg(1000);
+
+static void BM_JSON_Load_Document(benchmark::State& state) {
+	auto json = make_document(state.range(0));
+	while (state.KeepRunning()) {
+		json_load_parse(json);
+	}
+	state.SetBytesProcessed(state.iterations() * json.size());
+}
+BENCHMARK(BM_JSON_Load_Document)->Arg(10)->Arg(1000);
+
+static void BM_JSON_Load_NDJSON(benchmark::State& state) {
+	std::string ndjson;
+	for (int i = 0; i < state.range(0); ++i) {
+		ndjson += make_document(10) + "\n";
+	}
+	while (state.KeepRunning()) {
+		MsgPack body;
+		auto obj = ndjson_load(ndjson);
+		body.swap(obj);
+		benchmark::DoNotOptimize(body);
+	}
+	state.SetBytesProcessed(state.iterations() * ndjson.size());
+}
+BENCHMARK(BM_JSON_Load_NDJSON)->Arg(100);
+
+BENCHMARK_MAIN();
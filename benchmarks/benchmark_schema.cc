@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2019 Dubalu LLC. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "benchmark/benchmark.h"
+
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "database_handler.h"
+#include "database_utils.h"
+#include "msgpack.h"
+#include "schema.h"
+
+
+// Small document, as typically indexed one at a time.
+static const std::string tweet = R"({
+	"user": "Kronuz",
+	"postDate": "2016-11-15T13:12:00",
+	"message": "Trying out Xapiand, so far, so good... so what!",
+	"retweets": 12,
+	"score": 0.75,
+	"sensitive": false,
+	"tags": ["xapiand", "search", "engine"],
+	"author": {"name": "German", "followers": 1234, "verified": true},
+})";
+
+
+// Document with many nested fields, all of them already in the schema.
+static std::string
+make_document(int fields)
+{
+	std::string json = "{\"group\": {";
+	for (int i = 0; i < fields; ++i) {
+		if (i) {
+			json += ", ";
+		}
+		json += "\"field" + std::to_string(i) + "\": {\"name\": \"value " + std::to_string(i) + "\", \"count\": " + std::to_string(i) + "}";
+	}
+	json += "}}";
+	return json;
+}
+
+
+// Schema with all the fields of object, as left after indexing it once.
+static std::shared_ptr<const MsgPack>
+make_schema(const MsgPack& object, DatabaseHandler& db_handler)
+{
+	Schema schema(Schema::get_initial_schema(), nullptr, "");
+	std::shared_ptr<std::pair<std::string, const Data>> old_document_pair;
+	schema.index(object, MsgPack("doc"), old_document_pair, db_handler);
+	return schema.get_modified_schema();
+}
+
+
+// Indexing into an unmodified (shared) schema, after the first document the
+// fields get their specification from the schema's index plan.
+static void
+index_documents(benchmark::State& state, const std::string& json)
+{
+	DatabaseHandler db_handler;
+	auto object = json_load(json);
+	auto shared_schema = make_schema(object, db_handler);
+	while (state.KeepRunning()) {
+		Schema schema(shared_schema, nullptr, "");
+		std::shared_ptr<std::pair<std::string, const Data>> old_document_pair;
+		auto indexed = schema.index(object, MsgPack("doc"), old_document_pair, db_handler);
+		benchmark::DoNotOptimize(indexed);
+	}
+}
+
+
+static void BM_Schema_Index_Tweet(benchmark::State& state) {
+	index_documents(state, tweet);
+}
+BENCHMARK(BM_Schema_Index_Tweet);
+
+static void BM_Schema_Index_Document(benchmark::State& state) {
+	index_documents(state, make_document(state.range(0)));
+}
+BENCHMARK(BM_Schema_Index_Document)->Arg(10)->Arg(100);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2015-2019 Dubalu LLC. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "benchmark/benchmark.h"
+
+#include <string>
+#include <vector>
+
+#include "string_metric.h"
+
+
+// Field values of realistic lengths (names, titles and short descriptions).
+static const std::vector<std::string> values{
+	"Healed",
+	"Sealed",
+	"Web Applications",
+	"PHP Web Applications",
+	"Web Database Applications with PHP & MySQL",
+	"Building Web Database Applications with Visual Studio 6",
+	"WebRAD: Building Database Applications on the Web with Visual FoxPro and Web Connection",
+};
+
+
+static const std::vector<std::string> patterns{
+	"Healed",
+	"Web Aplications",
+	"Web Database Applications",
+	"Creating Database Web Applications with PHP and ASP",
+};
+
+
+// Dynamic programming, comparing against both strings.
+template <typename Metric>
+static void BM_MetricDP(benchmark::State& state) {
+	const auto& pattern = patterns[state.range(0)];
+	Metric metric(pattern);
+	while (state.KeepRunning()) {
+		for (const auto& value : values) {
+			benchmark::DoNotOptimize(metric.distance(pattern, value));
+		}
+	}
+	state.SetItemsProcessed(state.iterations() * values.size());
+}
+
+
+// Bit-parallel, comparing against the precomputed pattern.
+template <typename Metric>
+static void BM_MetricBitParallel(benchmark::State& state) {
+	Metric metric(patterns[state.range(0)]);
+	while (state.KeepRunning()) {
+		for (const auto& value : values) {
+			benchmark::DoNotOptimize(metric.distance(value));
+		}
+	}
+	state.SetItemsProcessed(state.iterations() * values.size());
+}
+
+
+BENCHMARK_TEMPLATE(BM_MetricDP, Levenshtein)->DenseRange(0, 3);
+BENCHMARK_TEMPLATE(BM_MetricBitParallel, Levenshtein)->DenseRange(0, 3);
+BENCHMARK_TEMPLATE(BM_MetricDP, LCSubsequence)->DenseRange(0, 3);
+BENCHMARK_TEMPLATE(BM_MetricBitParallel, LCSubsequence)->DenseRange(0, 3);
+
+BENCHMARK_MAIN();
@@ -64,6 +64,16 @@ TEST(SortQueryTest, Geo) {
 }
 
 
+TEST(SortQueryTest, Shards) {
+	EXPECT_EQ(sort_test_shards(), 0);
+}
+
+
+TEST(SortQueryTest, ShardsAfter) {
+	EXPECT_EQ(sort_test_shards_after(), 0);
+}
+
+
 int main(int argc, char **argv) {
 	auto initializer = Initializer::create();
 	::testing::InitGoogleTest(&argc, argv);
@@ -32,6 +32,31 @@ TEST(WALTest, Working) {
 }
 
 
+TEST(WALTest, GroupCommit) {
+	EXPECT_EQ(test_wal_batch(), 0);
+}
+
+
+TEST(WALTest, DeferredPartialBlock) {
+	EXPECT_EQ(test_wal_partial_block(), 0);
+}
+
+
+TEST(WALTest, FlushOnEviction) {
+	EXPECT_EQ(test_wal_eviction(), 0);
+}
+
+
+TEST(WALTest, FlushOnBytes) {
+	EXPECT_EQ(test_wal_flush_on_bytes(), 0);
+}
+
+
+TEST(WALTest, FlushOnDelay) {
+	EXPECT_EQ(test_wal_flush_on_delay(), 0);
+}
+
+
 int main(int argc, char **argv) {
 	auto initializer = Initializer::create();
 	::testing::InitGoogleTest(&argc, argv);
@@ -23,8 +23,10 @@
 #include "test_sort.h"
 
 #include "../src/datetime.h"
+#include "../src/repr.hh"
 #include "../src/schema.h"
 #include "../src/serialise.h"
+#include "../src/string.hh"
 #include "utils.h"
 
 
@@ -1063,3 +1065,173 @@ int sort_test_geo() {
 		RETURN(1);
 	}
 }
+
+
+/*
+ * The same documents split in two shards: odd "_id"s go to the first shard
+ * and even ones to the second, so combined docids match the "_id"s and ties
+ * are broken just as in the single database.
+ */
+static Endpoints shards_endpoints() {
+	static DB_Test db_shard1(".db_sort_shard1.db", std::vector<std::string>(), DB_WRITABLE | DB_CREATE_OR_OPEN | DB_NO_WAL);
+	static DB_Test db_shard2(".db_sort_shard2.db", std::vector<std::string>(), DB_WRITABLE | DB_CREATE_OR_OPEN | DB_NO_WAL);
+	static bool indexed = false;
+	if (!indexed) {
+		indexed = true;
+		for (int i = 1; i <= 10; ++i) {
+			auto& db_shard = i % 2 ? db_shard1 : db_shard2;
+			auto doc = path_test_sort + "doc" + std::to_string(i) + ".txt";
+			std::string buffer;
+			if (!read_file_contents(doc, &buffer)) {
+				THROW(Error, "Can not read the file %s", doc);
+			}
+			db_shard.db_handler.index(std::to_string(i), false, db_shard.get_body(buffer, JSON_CONTENT_TYPE).second, true, ct_type_t(JSON_CONTENT_TYPE));
+		}
+	}
+
+	Endpoints endpoints;
+	endpoints.add(create_endpoint(db_shard1.name_database));
+	endpoints.add(create_endpoint(db_shard2.name_database));
+	return endpoints;
+}
+
+
+static int make_shards_search(const std::vector<sort_t> _tests) {
+	DatabaseHandler db_handler;
+	db_handler.reset(shards_endpoints(), DB_OPEN, HTTP_GET);
+
+	int cont = 0;
+	query_field_t query;
+
+	auto schema = db_handler.get_schema();
+	auto spc_id = schema->get_data_id();
+	auto id_type = spc_id.get_type();
+
+	for (const auto& test : _tests) {
+		query.query.clear();
+		query.query.push_back(test.query);
+		query.sort = test.sort;
+
+		// Searched twice, the second time sort keys may come from the cache.
+		for (int run = 0; run < 2; ++run) {
+			try {
+				auto mset = db_handler.get_mset(query, nullptr, nullptr);
+				if (mset.size() != test.expect_result.size()) {
+					++cont;
+					L_ERR("ERROR: Different number of documents. Obtained %u. Expected: %zu.", mset.size(), test.expect_result.size());
+				} else {
+					auto m = mset.begin();
+					for (auto it = test.expect_result.begin(); m != mset.end(); ++it, ++m) {
+						auto document = db_handler.get_document(*m);
+						auto val = Unserialise::MsgPack(id_type, document.get_value(0)).to_string();
+						if (it->compare(val) != 0) {
+							++cont;
+							L_ERR("ERROR: Result = %s:%s   Expected = %s:%s", ID_FIELD_NAME, val, ID_FIELD_NAME, *it);
+						}
+					}
+				}
+			} catch (const std::exception& exc) {
+				L_EXC("ERROR: %s", exc.what());
+				++cont;
+			}
+		}
+	}
+
+	return cont;
+}
+
+
+int sort_test_shards() {
+	INIT_LOG
+	try {
+		int cont = make_shards_search(integer_tests);
+		cont += make_shards_search(float_tests);
+		if (cont == 0) {
+			L_DEBUG("Testing sort in shards is correct!");
+		} else {
+			L_ERR("ERROR: Testing sort in shards has mistakes.");
+		}
+		RETURN(cont);
+	} catch (const Xapian::Error &exc) {
+		L_EXC("ERROR: %s", exc.get_description());
+		RETURN(1);
+	} catch (const std::exception &exc) {
+		L_EXC("ERROR: %s", exc.what());
+		RETURN(1);
+	}
+}
+
+
+/*
+ * Pages through the shards with search-after cursors, a few documents at
+ * a time; cursors keep combined docids, the pages must not skip or repeat
+ * any document.
+ */
+static int make_shards_after_search(const std::vector<sort_t> _tests) {
+	DatabaseHandler db_handler;
+	db_handler.reset(shards_endpoints(), DB_OPEN, HTTP_GET);
+
+	int cont = 0;
+	query_field_t query;
+	query.is_after = true;
+	query.limit = 3;
+
+	auto schema = db_handler.get_schema();
+	auto spc_id = schema->get_data_id();
+	auto id_type = spc_id.get_type();
+
+	for (const auto& test : _tests) {
+		query.query.clear();
+		query.query.push_back(test.query);
+		query.sort = test.sort;
+		query.after.clear();
+
+		std::vector<std::string> result;
+		try {
+			while (result.size() <= test.expect_result.size()) {
+				auto mset = db_handler.get_mset(query, nullptr, nullptr);
+				if (mset.size() == 0) {
+					break;
+				}
+				for (auto m = mset.begin(); m != mset.end(); ++m) {
+					auto document = db_handler.get_document(*m);
+					result.push_back(Unserialise::MsgPack(id_type, document.get_value(0)).to_string());
+				}
+				auto m_last = mset.back();
+				query.after = cursor_t(m_last.get_sort_key(), *m_last).serialise();
+			}
+		} catch (const std::exception& exc) {
+			L_EXC("ERROR: %s", exc.what());
+			++cont;
+			continue;
+		}
+
+		if (result != test.expect_result) {
+			++cont;
+			L_ERR("ERROR: Different pages. Obtained %s. Expected: %s.", repr(string::join(result, ", ")), repr(string::join(test.expect_result, ", ")));
+		}
+	}
+
+	return cont;
+}
+
+
+int sort_test_shards_after() {
+	INIT_LOG
+	try {
+		int cont = make_shards_after_search(integer_tests);
+		cont += make_shards_after_search(positive_tests);
+		if (cont == 0) {
+			L_DEBUG("Testing search-after in shards is correct!");
+		} else {
+			L_ERR("ERROR: Testing search-after in shards has mistakes.");
+		}
+		RETURN(cont);
+	} catch (const Xapian::Error &exc) {
+		L_EXC("ERROR: %s", exc.get_description());
+		RETURN(1);
+	} catch (const std::exception &exc) {
+		L_EXC("ERROR: %s", exc.what());
+		RETURN(1);
+	}
+}
@@ -56,3 +56,6 @@ int sort_test_positives();
 int sort_test_date();
 int sort_test_boolean();
 int sort_test_geo();
+
+int sort_test_shards();
+int sort_test_shards_after();
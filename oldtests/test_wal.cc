@@ -22,12 +22,21 @@
 
 #include "test_wal.h"
 
+#include <chrono>
+#include <random>
+#include <thread>
+
+#include "../src/cuuid/uuid.h"
 #include "../src/database.h"
 #include "../src/database_wal.h"
+#include "../src/fs.hh"
+#include "../src/opts.h"
 
 
 const std::string test_db(".test_wal.db");
 const std::string restored_db(".backup_wal.db");
+const std::string batch_wal(".test_wal_batch.db");
+const std::string evicted_wal(".test_wal_evicted.db");
 
 
 uint32_t get_checksum(int fd) {
@@ -172,3 +181,240 @@ int restore_database() {
 #endif
 	RETURN(1);
 }
+
+
+// Counts the committed lines a fresh reader sees in the WAL.
+static size_t count_wal_lines(const std::string& path) {
+	DatabaseWAL wal(path);
+	size_t count = 0;
+	for (auto it = wal.find(0); it != wal.end(); ++it) {
+		++count;
+	}
+	return count;
+}
+
+
+// Polls the WAL (which may be getting committed meanwhile) until it has
+// at least the given number of lines.
+static bool wait_wal_lines(const std::string& path, size_t lines, std::chrono::milliseconds timeout) {
+	auto deadline = std::chrono::steady_clock::now() + timeout;
+	while (true) {
+		try {
+			if (count_wal_lines(path) >= lines) {
+				return true;
+			}
+		} catch (const StorageException&) { }
+		if (std::chrono::steady_clock::now() >= deadline) {
+			return false;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+}
+
+
+static void write_wal_lines(DatabaseWALWriterThread& thread, const std::string& path, const UUID& uuid, const std::vector<std::string>& values) {
+	for (const auto& value : values) {
+		thread.write_line(path, uuid, 0, DatabaseWAL::Type::SET_METADATA, value, false);
+	}
+}
+
+
+static std::vector<std::string> wal_values(size_t num_values, size_t size) {
+	std::vector<std::string> values;
+	for (size_t i = 0; i < num_values; ++i) {
+		values.push_back(std::string(size, static_cast<char>('a' + i % 26)));
+	}
+	return values;
+}
+
+
+int test_wal_batch() {
+	INIT_LOG
+	int cont = 0;
+
+	delete_files(batch_wal);
+	build_path_index(batch_wal);
+
+	try {
+		UUIDGenerator generator;
+		auto uuid = generator();
+		DatabaseWALWriterThread thread;
+
+		// Lines wait in the deferred partial block until the group commit.
+		write_wal_lines(thread, batch_wal, uuid, wal_values(10, 16));
+		if (count_wal_lines(batch_wal) != 0) {
+			L_ERR("ERROR: WAL lines are visible before the group commit");
+			++cont;
+		}
+
+		thread.flush();
+		auto count = count_wal_lines(batch_wal);
+		if (count != 10) {
+			L_ERR("ERROR: Group commit flushed %zu WAL lines, expected 10", count);
+			++cont;
+		}
+
+		// The next batch keeps appending to the same partial block.
+		write_wal_lines(thread, batch_wal, uuid, wal_values(5, 16));
+		thread.flush();
+		count = count_wal_lines(batch_wal);
+		if (count != 15) {
+			L_ERR("ERROR: Group commit flushed %zu WAL lines, expected 15", count);
+			++cont;
+		}
+
+		// Flushing an empty batch is a no-op.
+		thread.flush();
+		count = count_wal_lines(batch_wal);
+		if (count != 15) {
+			L_ERR("ERROR: Empty group commit changed the WAL to %zu lines, expected 15", count);
+			++cont;
+		}
+	} catch (const std::exception& exc) {
+		L_EXC("ERROR: %s", exc.what());
+		++cont;
+	}
+
+	delete_files(batch_wal);
+	RETURN(cont);
+}
+
+
+int test_wal_partial_block() {
+	INIT_LOG
+	int cont = 0;
+
+	delete_files(batch_wal);
+	build_path_index(batch_wal);
+
+	try {
+		UUIDGenerator generator;
+		auto uuid = generator();
+		DatabaseWALWriterThread thread;
+
+		// Random (incompressible) lines of assorted sizes, so batches end
+		// anywhere within a block and lines straddle block boundaries.
+		std::mt19937 rng(42);
+		std::uniform_int_distribution<size_t> size_dist(1, 3 * STORAGE_BLOCK_SIZE / 2);
+		std::uniform_int_distribution<int> char_dist(0, 255);
+		std::vector<std::string> written;
+		for (size_t batch = 0; batch < 20; ++batch) {
+			std::vector<std::string> values;
+			for (size_t i = 0; i < batch % 4 + 1; ++i) {
+				std::string value(size_dist(rng), '\0');
+				for (auto& c : value) {
+					c = static_cast<char>(char_dist(rng));
+				}
+				values.push_back(std::move(value));
+			}
+			write_wal_lines(thread, batch_wal, uuid, values);
+			thread.flush();
+			written.insert(written.end(), values.begin(), values.end());
+
+			auto count = count_wal_lines(batch_wal);
+			if (count != written.size()) {
+				L_ERR("ERROR: After batch %zu the WAL has %zu lines, expected %zu", batch, count, written.size());
+				++cont;
+			}
+		}
+	} catch (const std::exception& exc) {
+		L_EXC("ERROR: %s", exc.what());
+		++cont;
+	}
+
+	delete_files(batch_wal);
+	RETURN(cont);
+}
+
+
+int test_wal_eviction() {
+	INIT_LOG
+	int cont = 0;
+
+	delete_files(batch_wal);
+	delete_files(evicted_wal);
+	build_path_index(batch_wal);
+	build_path_index(evicted_wal);
+
+	auto max_databases = opts.max_databases;
+	opts.max_databases = 1;
+	try {
+		UUIDGenerator generator;
+		DatabaseWALWriterThread thread;
+
+		// Writing to a second WAL evicts the first one mid-batch,
+		// which has to commit its lines on the way out.
+		write_wal_lines(thread, evicted_wal, generator(), wal_values(3, 16));
+		write_wal_lines(thread, batch_wal, generator(), wal_values(4, 16));
+		auto count = count_wal_lines(evicted_wal);
+		if (count != 3) {
+			L_ERR("ERROR: Evicted WAL has %zu lines, expected 3", count);
+			++cont;
+		}
+
+		thread.flush();
+		count = count_wal_lines(evicted_wal);
+		if (count != 3) {
+			L_ERR("ERROR: Evicted WAL has %zu lines after the group commit, expected 3", count);
+			++cont;
+		}
+		count = count_wal_lines(batch_wal);
+		if (count != 4) {
+			L_ERR("ERROR: WAL has %zu lines after the group commit, expected 4", count);
+			++cont;
+		}
+	} catch (const std::exception& exc) {
+		L_EXC("ERROR: %s", exc.what());
+		++cont;
+	}
+	opts.max_databases = max_databases;
+
+	delete_files(batch_wal);
+	delete_files(evicted_wal);
+	RETURN(cont);
+}
+
+
+// Sets a metadata key through the asynchronous WAL writers and checks
+// the line gets committed within the given time, with nothing else queued.
+static int test_wal_group_commit(std::size_t delay, std::size_t bytes, std::chrono::milliseconds timeout) {
+	int cont = 0;
+
+	// Group commit options are read at the start of each batch.
+	auto wal_group_commit_delay = opts.wal_group_commit_delay;
+	auto wal_group_commit_bytes = opts.wal_group_commit_bytes;
+	opts.wal_group_commit_delay = delay;
+	opts.wal_group_commit_bytes = bytes;
+	try {
+		DB_Test db_wal(batch_wal, std::vector<std::string>(), DB_WRITABLE | DB_CREATE_OR_OPEN);
+		const auto& path = db_wal.endpoints[0].path;
+		auto lines = count_wal_lines(path);
+		db_wal.db_handler.set_metadata(std::string("key"), std::string("value"));
+		if (!wait_wal_lines(path, lines + 1, timeout)) {
+			L_ERR("ERROR: Group commit did not flush within %lld ms", static_cast<long long>(timeout.count()));
+			++cont;
+		}
+	} catch (const std::exception& exc) {
+		L_EXC("ERROR: %s", exc.what());
+		++cont;
+	}
+	opts.wal_group_commit_delay = wal_group_commit_delay;
+	opts.wal_group_commit_bytes = wal_group_commit_bytes;
+
+	delete_files(batch_wal);
+	return cont;
+}
+
+
+int test_wal_flush_on_bytes() {
+	INIT_LOG
+	// The latency budget is far too long, only the byte limit can close the batch.
+	RETURN(test_wal_group_commit(60000, 1, std::chrono::seconds(5)));
+}
+
+
+int test_wal_flush_on_delay() {
+	INIT_LOG
+	// The byte limit is never reached, the latency budget has to close the batch.
+	RETURN(test_wal_group_commit(100, WAL_GROUP_COMMIT_BYTES, std::chrono::seconds(5)));
+}
@@ -29,3 +29,8 @@ uint32_t get_checksum(int fd);
 bool dir_compare(const std::string& dir1, const std::string& dir2);
 int create_db_wal();
 int restore_database();
+int test_wal_batch();
+int test_wal_partial_block();
+int test_wal_eviction();
+int test_wal_flush_on_bytes();
+int test_wal_flush_on_delay();
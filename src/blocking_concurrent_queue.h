@@ -28,6 +28,7 @@
 #include "moodycamel/blockingconcurrentqueue.h"
 #else
 
+#include <chrono>
 #include <condition_variable>
 
 #include "concurrent_queue.h"
@@ -84,6 +85,19 @@ public:
 		item = std::move(ConcurrentQueue<T>::queue.front());
 		ConcurrentQueue<T>::queue.pop_front();
 	}
+
+	template<typename U, typename Rep, typename Period>
+	bool wait_dequeue_timed(U& item, const std::chrono::duration<Rep, Period>& timeout) {
+		std::unique_lock<std::mutex> lk(*ConcurrentQueue<T>::mtx);
+		if (!cond.wait_for(lk, timeout, [&]{
+			return !ConcurrentQueue<T>::queue.empty();
+		})) {
+			return false;
+		}
+		item = std::move(ConcurrentQueue<T>::queue.front());
+		ConcurrentQueue<T>::queue.pop_front();
+		return true;
+	}
 };
 
 }
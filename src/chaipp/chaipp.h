@@ -26,10 +26,15 @@
 
 #if XAPIAND_CHAISCRIPT
 
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <mutex>
 #include <unordered_map>
 
 #include "exception.h"
 #include "lru.h"
+#include "metrics.h"
 #include "module.h"
 
 
@@ -51,17 +56,36 @@ class Processor {
 
 
 	class Engine {
-		ScriptLRU script_lru;
-		std::mutex mtx;
+		// The LRU is striped by script hash so compiling (or looking up)
+		// different scripts doesn't serialise all client threads.
+		struct Shard {
+			ScriptLRU script_lru;
+			std::mutex mtx;
+
+			explicit Shard(ssize_t shard_size)
+				: script_lru(shard_size) { }
+		};
+
+		std::array<std::unique_ptr<Shard>, SCRIPTS_CACHE_SHARDS> shards;
 
 	public:
-		explicit Engine(ssize_t max_size)
-			: script_lru(max_size) { }
+		explicit Engine(ssize_t shard_size) {
+			for (auto& shard : shards) {
+				shard = std::make_unique<Shard>(shard_size);
+			}
+		}
 
 		std::shared_ptr<Processor> compile(size_t script_hash, size_t body_hash, const std::string& script_body) {
-			std::unique_lock<std::mutex> lk(mtx);
-			auto it = script_lru.find(script_hash);
-			if (it != script_lru.end()) {
+			auto& shard = *shards[script_hash % SCRIPTS_CACHE_SHARDS];
+			std::unique_lock<std::mutex> lk(shard.mtx, std::try_to_lock);
+			if (!lk.owns_lock()) {
+				Metrics::metrics()
+					.xapiand_script_cache_contention
+					.Increment();
+				lk.lock();
+			}
+			auto it = shard.script_lru.find(script_hash);
+			if (it != shard.script_lru.end()) {
 				if (script_body.empty() || it->second.first == body_hash) {
 					return it->second.second;
 				}
@@ -71,7 +95,7 @@ class Processor {
 			auto processor = std::make_shared<Processor>(script_body);
 
 			lk.lock();
-			return script_lru.emplace(script_hash, std::make_pair(body_hash, std::move(processor))).first->second.second;
+			return shard.script_lru.emplace(script_hash, std::make_pair(body_hash, std::move(processor))).first->second.second;
 		}
 
 		std::shared_ptr<Processor> compile(const std::string& script_name, const std::string& script_body) {
@@ -155,7 +179,7 @@ public:
 	}
 
 	static Engine& engine() {
-		static Engine* engine = new Engine(SCRIPTS_CACHE_SIZE);
+		static Engine* engine = new Engine(SCRIPTS_CACHE_SHARD_SIZE);
 		return *engine;
 	}
 
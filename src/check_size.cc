@@ -68,6 +68,7 @@
 #include "geospatial/point.h"
 #include "geospatial/polygon.h"
 #include "metrics/basic_string_metric.h"
+#include "metrics/bit_parallel.h"
 #include "metrics/jaccard.h"
 #include "metrics/jaro.h"
 #include "metrics/jaro_winkler.h"
@@ -246,6 +247,8 @@ CHECK_MAX_SIZE(SMALL, (Polygon))
 
 // metrics/basic_string_metric.h
 CHECK_MAX_SIZE(SMALL, (Counter))
+// metrics/bit_parallel.h
+CHECK_MAX_SIZE(SMALL, (PatternMatchVector))
 // metrics/jaccard.h
 CHECK_MAX_SIZE(SMALL, (Jaccard))
 // metrics/jaro.h
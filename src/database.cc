@@ -22,14 +22,20 @@
 
 #include "database.h"
 
-#include <algorithm>              // for std::move
+#include <algorithm>              // for std::move, std::sort
+#include <atomic>                 // for std::atomic_bool
+#include <exception>              // for std::exception_ptr, std::rethrow_exception
+#include <future>                 // for std::future
+#include <mutex>                  // for std::mutex, std::lock_guard
 #include <sys/types.h>            // for uint32_t, uint8_t, ssize_t
+#include <thread>                 // for std::this_thread::sleep_until
+#include <unordered_map>          // for std::unordered_map
 
 #include "cassert.h"              // for ASSERT
 #include "database_data.h"        // for Locator
 #include "database_flags.h"       // DB_*
 #include "database_pool.h"        // for DatabaseEndpoint
-#include "database_handler.h"     // for committer
+#include "database_handler.h"     // for committer, shard_searcher
 #include "database_wal.h"         // for DatabaseWAL, DatabaseWALWriter
 #include "exception.h"            // for THROW, Error, MSG_Error, Exception, DocNot...
 #include "fs.hh"                  // for exists, build_path_index
@@ -38,7 +44,9 @@
 #include "log.h"                  // for L_OBJ, L_CALL
 #include "lz4/xxhash.h"           // for XXH32_update, XXH32_state_t
 #include "manager.h"              // for XapiandManager, sig_exit, trigger_replication
+#include "metrics.h"              // for Metrics::metrics
 #include "msgpack.h"              // for MsgPack
+#include "opts.h"                 // for opts::*
 #include "random.hh"              // for random_int
 #include "repr.hh"                // for repr
 #include "storage.h"              // for STORAGE_BLOCK_SIZE, StorageCorruptVolume...
@@ -87,6 +95,8 @@
 
 #define STORAGE_SYNC_MODE STORAGE_FULL_SYNC
 
+#define STORAGE_SCRUB_DELAY std::chrono::minutes(10)
+
 
 //  ____        _        ____  _
 // |  _ \  __ _| |_ __ _/ ___|| |_ ___  _ __ __ _  __ _  ___
@@ -185,8 +195,10 @@ DataHeader::validate(void* param, void* /*unused*/)
 		THROW(StorageCorruptVolume, "Bad data storage header magic number");
 	}
 
+	// Storages opened without a database (i.e. by the scrubber)
+	// can only validate the volume's magic number.
 	auto database = static_cast<Database*>(param);
-	if (UUID(head.uuid) != database->get_uuid()) {
+	if (database && UUID(head.uuid) != database->get_uuid()) {
 		THROW(StorageCorruptVolume, "Data storage UUID mismatch");
 	}
 }
@@ -204,6 +216,189 @@ DataStorage::open(std::string_view relative_path)
 {
 	return Storage<DataHeader, DataBinHeader, DataBinFooter>::open(relative_path, flags);
 }
+
+
+//  ____                  _     _
+// / ___|  ___ _ __ _   _| |__ | |__   ___ _ __
+// \___ \ / __| '__| | | | '_ \| '_ \ / _ \ '__|
+//  ___) | (__| |  | |_| | |_) | |_) |  __/ |
+// |____/ \___|_|   \__,_|_.__/|_.__/ \___|_|
+//
+
+struct StorageScrubStatus {
+	bool running = false;
+	std::chrono::system_clock::time_point started;
+	std::chrono::system_clock::time_point finished;
+	size_t volumes = 0;
+	size_t bins = 0;
+	size_t bytes = 0;
+	std::vector<std::string> errors;
+};
+
+// Where the last pass stopped: volumes before it (and bins before the
+// offset in it) were already verified. Volumes are append only, so each
+// pass only needs to verify what's been written since.
+struct StorageScrubPosition {
+	unsigned long long volume = 0;
+	uint32_t offset = 0;
+};
+
+static std::mutex storage_scrub_mtx;
+static std::unordered_map<std::string, StorageScrubStatus> storage_scrub_statuses;
+static std::unordered_map<std::string, StorageScrubPosition> storage_scrub_positions;
+static std::atomic_bool storage_scrub_stopping(false);
+
+
+void
+storage_scrub(const std::string& path)
+{
+	L_CALL("storage_scrub(%s)", repr(path));
+
+	StorageScrubStatus status;
+	status.running = true;
+	status.started = std::chrono::system_clock::now();
+	StorageScrubPosition position;
+	{
+		std::lock_guard<std::mutex> lk(storage_scrub_mtx);
+		auto& current = storage_scrub_statuses[path];
+		if (current.running) {
+			return;
+		}
+		current.running = true;
+		current.started = status.started;
+		position = storage_scrub_positions[path];
+	}
+
+	auto& metrics = Metrics::metrics();
+
+	// Volumes are verified through their own file descriptors (they are
+	// append only) so readers and writers are never blocked by scrubbing.
+	Storage<DataHeader, DataBinHeader, DataBinFooter> storage(path, nullptr);
+	try {
+		auto volumes = storage.get_volumes_range(DATA_STORAGE_PATH);
+		if (position.volume < volumes.first) {
+			position.volume = volumes.first;
+			position.offset = 0;
+		}
+		for (auto volume = position.volume; volume <= volumes.second && !storage_scrub_stopping.load(std::memory_order_relaxed); ++volume) {
+			auto volume_path = string::format(DATA_STORAGE_PATH "%llu", volume);
+			try {
+				storage.open(volume_path, STORAGE_OPEN);
+				if (storage.closed()) {
+					continue;
+				}
+				if (position.volume == volume && position.offset) {
+					storage.seek(position.offset);
+				}
+				++status.volumes;
+				char buf[LZ4_BLOCK_SIZE];
+				while (!storage_scrub_stopping.load(std::memory_order_relaxed)) {
+					size_t bin_bytes = 0;
+					try {
+						while (auto read_size = storage.read(buf, sizeof(buf))) {
+							bin_bytes += read_size;
+						}
+					} catch (const StorageNotFound&) {
+						// Deleted bins carry no checksum to verify, skip them.
+						storage.skip();
+						position = { volume, storage.tell() };
+						continue;
+					}
+					position = { volume, storage.tell() };
+					++status.bins;
+					status.bytes += bin_bytes;
+					metrics.xapiand_storage_scrubbed_bins.Increment();
+					metrics.xapiand_storage_scrubbed_bytes.Increment(bin_bytes);
+					if (opts.scrub_rate) {
+						// Throttle to the configured bytes per second
+						auto expected = std::chrono::microseconds(status.bytes * 1000000ULL / opts.scrub_rate);
+						std::this_thread::sleep_until(status.started + expected);
+					}
+				}
+			} catch (const StorageEOF&) {
+			} catch (const StorageException& exc) {
+				// Bins can't be framed past a corrupt one, so move on to the next volume.
+				status.errors.push_back(string::format("%s: %s", volume_path, exc.get_message()));
+				metrics.xapiand_storage_scrub_errors.Increment();
+				L_ERR("Data storage scrub of %s failed: %s: %s", repr(path), volume_path, exc.get_message());
+			}
+			storage.close();
+			// Only the last volume can still grow, the next pass resumes
+			// from where this one stopped in it.
+			if (volume < volumes.second && !storage_scrub_stopping.load(std::memory_order_relaxed)) {
+				position = { volume + 1, 0 };
+			}
+		}
+	} catch (const Exception& exc) {
+		status.errors.push_back(exc.get_message());
+		metrics.xapiand_storage_scrub_errors.Increment();
+		L_ERR("Data storage scrub of %s failed: %s", repr(path), exc.get_message());
+	}
+
+	status.running = false;
+	status.finished = std::chrono::system_clock::now();
+
+	L_DEBUG("Data storage scrub of %s finished after %s: %zu volumes, %zu bins, %zu bytes, %zu errors", repr(path), string::from_delta(status.started, status.finished), status.volumes, status.bins, status.bytes, status.errors.size());
+
+	std::lock_guard<std::mutex> lk(storage_scrub_mtx);
+	storage_scrub_statuses[path] = std::move(status);
+	// The position is gone if a full pass was asked for in the meantime.
+	auto it = storage_scrub_positions.find(path);
+	if (it != storage_scrub_positions.end()) {
+		it->second = position;
+	}
+}
+
+
+void
+storage_scrub_rewind(const std::string& path)
+{
+	L_CALL("storage_scrub_rewind(%s)", repr(path));
+
+	std::lock_guard<std::mutex> lk(storage_scrub_mtx);
+	storage_scrub_positions.erase(path);
+}
+
+
+MsgPack
+storage_scrub_status(const std::string& path)
+{
+	L_CALL("storage_scrub_status(%s)", repr(path));
+
+	std::lock_guard<std::mutex> lk(storage_scrub_mtx);
+	auto it = storage_scrub_statuses.find(path);
+	if (it == storage_scrub_statuses.end()) {
+		return {
+			{"status", "pending"},
+		};
+	}
+	const auto& status = it->second;
+	if (status.running && status.finished < status.started) {
+		return {
+			{"status", "running"},
+		};
+	}
+	MsgPack errors(MsgPack::Type::ARRAY);
+	for (const auto& error : status.errors) {
+		errors.push_back(error);
+	}
+	return {
+		{"status", status.running ? "running" : "done"},
+		{"finished", std::chrono::duration_cast<std::chrono::seconds>(status.finished.time_since_epoch()).count()},
+		{"took", std::chrono::duration_cast<std::chrono::nanoseconds>(status.finished - status.started).count() / 1e9},
+		{"volumes", status.volumes},
+		{"bins", status.bins},
+		{"bytes", status.bytes},
+		{"errors", errors},
+	};
+}
+
+
+void
+storage_scrub_stop()
+{
+	storage_scrub_stopping.store(true, std::memory_order_relaxed);
+}
 #endif  // XAPIAND_DATA_STORAGE
 
 
@@ -214,6 +409,47 @@ DataStorage::open(std::string_view relative_path)
 // |____/ \__,_|\__\__,_|_.__/ \__,_|___/\___|
 //
 
+#ifdef XAPIAND_CLUSTERING
+// Endpoint of the primary node of the index of endpoint
+// (or endpoint itself, if it can't be resolved).
+static Endpoint
+primary_endpoint(const Endpoint& endpoint)
+{
+	try {
+		return XapiandManager::resolve_index_endpoint(Endpoint{endpoint.path}, true);
+	} catch (const CheckoutErrorEndpointNotAvailable&) {
+		return endpoint;
+	}
+}
+
+
+// Reads can be routed to any active replica (see --read-routing), which
+// might not have received the database yet or not be caught up enough to
+// open it. Those fall back to reading from the primary; returns false if
+// endpoint already is the primary.
+static bool
+open_primary(const Endpoint& endpoint, int flags, Xapian::Database& rsdb, bool& localdb)
+{
+	auto primary = primary_endpoint(endpoint);
+	if (primary.node.lower_name() == endpoint.node.lower_name()) {
+		return false;
+	}
+	L_DATABASE("Endpoint %s not available, reading from the primary %s", repr(endpoint.to_string()), repr(primary.to_string()));
+	if (primary.is_local()) {
+		RANDOM_ERRORS_DB_THROW(Xapian::DatabaseOpeningError, "Random Error");
+		rsdb = Xapian::Database(primary.path, Xapian::DB_OPEN);
+		localdb = true;
+	} else {
+		int port = (primary.node.binary_port == XAPIAND_BINARY_SERVERPORT) ? XAPIAND_BINARY_PROXY : primary.node.binary_port;
+		RANDOM_ERRORS_DB_THROW(Xapian::DatabaseOpeningError, "Random Error");
+		rsdb = Xapian::Remote::open(primary.node.host(), port, 10000, 10000, flags, primary.path);
+		localdb = false;
+	}
+	return true;
+}
+#endif  // XAPIAND_CLUSTERING
+
+
 Database::Database(DatabaseEndpoint& endpoints_, int flags_)
 	: endpoints(endpoints_),
 	  flags(flags_),
@@ -339,10 +575,10 @@ Database::reopen_writable()
 	if (localdb) {
 		if ((flags & DB_NOSTORAGE) != DB_NOSTORAGE) {
 			writable_storages.push_back(std::make_unique<DataStorage>(endpoint.path, this, STORAGE_OPEN | STORAGE_WRITABLE | STORAGE_CREATE | STORAGE_COMPRESS | STORAGE_SYNC_MODE));
-			storages.push_back(std::make_unique<DataStorage>(endpoint.path, this, STORAGE_OPEN));
+			storages.push_back(std::make_unique<DataStorage>(endpoint.path, this, STORAGE_OPEN | STORAGE_MMAP));
 		} else {
 			writable_storages.push_back(std::unique_ptr<DataStorage>(nullptr));
-			storages.push_back(std::make_unique<DataStorage>(endpoint.path, this, STORAGE_OPEN));
+			storages.push_back(std::make_unique<DataStorage>(endpoint.path, this, STORAGE_OPEN | STORAGE_MMAP));
 		}
 	} else {
 		writable_storages.push_back(std::unique_ptr<DataStorage>(nullptr));
@@ -416,8 +652,18 @@ Database::reopen_readable()
 			: Xapian::DB_OPEN;
 		if (!endpoint.is_local()) {
 			int port = (endpoint.node.binary_port == XAPIAND_BINARY_SERVERPORT) ? XAPIAND_BINARY_PROXY : endpoint.node.binary_port;
-			RANDOM_ERRORS_DB_THROW(Xapian::DatabaseOpeningError, "Random Error");
-			rsdb = Xapian::Remote::open(endpoint.node.host(), port, 10000, 10000, _flags, endpoint.path);
+			try {
+				RANDOM_ERRORS_DB_THROW(Xapian::DatabaseOpeningError, "Random Error");
+				rsdb = Xapian::Remote::open(endpoint.node.host(), port, 10000, 10000, _flags, endpoint.path);
+			} catch (const Xapian::DatabaseOpeningError& exc) {
+				if (!open_primary(endpoint, _flags, rsdb, localdb)) {
+					throw;
+				}
+			} catch (const Xapian::NetworkError& exc) {
+				if (!open_primary(endpoint, _flags, rsdb, localdb)) {
+					throw;
+				}
+			}
 #ifdef XAPIAN_LOCAL_DB_FALLBACK
 			try {
 				RANDOM_ERRORS_DB_THROW(Xapian::DatabaseOpeningError, "Random Error");
@@ -430,16 +676,16 @@ Database::reopen_readable()
 					localdb = true;
 				} else {
 					try {
-						// If remote is master (it should be), try triggering replication
-						trigger_replication()->delayed_debounce(std::chrono::milliseconds{random_int(0, 3000)}, endpoint.path, endpoint, Endpoint{endpoint.path});
+						// Reads may come from any replica, replicate from the primary
+						trigger_replication()->delayed_debounce(std::chrono::milliseconds{random_int(0, 3000)}, endpoint.path, primary_endpoint(endpoint), Endpoint{endpoint.path});
 						incomplete.store(true, std::memory_order_relaxed);
 					} catch (...) { }
 				}
 			} catch (const Xapian::DatabaseOpeningError& exc) {
 				if (!exists(endpoint.path + "iamglass")) {
 					try {
-						// If remote is master (it should be), try triggering replication
-						trigger_replication()->delayed_debounce(std::chrono::milliseconds{random_int(0, 3000)}, endpoint.path, endpoint, Endpoint{endpoint.path});
+						// Reads may come from any replica, replicate from the primary
+						trigger_replication()->delayed_debounce(std::chrono::milliseconds{random_int(0, 3000)}, endpoint.path, primary_endpoint(endpoint), Endpoint{endpoint.path});
 						incomplete.store(true, std::memory_order_relaxed);
 					} catch (...) { }
 				}
@@ -487,7 +733,7 @@ Database::reopen_readable()
 #ifdef XAPIAND_DATA_STORAGE
 		if (localdb) {
 			// WAL required on a local database, open it.
-			storages.push_back(std::make_unique<DataStorage>(endpoint.path, this, STORAGE_OPEN));
+			storages.push_back(std::make_unique<DataStorage>(endpoint.path, this, STORAGE_OPEN | STORAGE_MMAP));
 		} else {
 			storages.push_back(std::unique_ptr<DataStorage>(nullptr));
 		}
@@ -1021,6 +1267,11 @@ Database::storage_commit()
 			storage->commit();
 		}
 	}
+
+	// Verify what's been written in the background once writes settle.
+	if (opts.num_scrubbers) {
+		scrubber()->delayed_debounce(STORAGE_SCRUB_DELAY, endpoints[0].path, endpoints[0].path);
+	}
 }
 #endif  // XAPIAND_DATA_STORAGE
 
@@ -1439,6 +1690,146 @@ Database::get_document(Xapian::docid did, bool assume_valid_)
 }
 
 
+std::vector<DocumentData>
+Database::get_documents_data(const std::vector<Xapian::docid>& dids, bool stored, Xapian::valueno slot)
+{
+	L_CALL("Database::get_documents_data(<%zu dids>, %s, %u)", dids.size(), stored ? "true" : "false", slot);
+
+	std::vector<DocumentData> results(dids.size());
+
+	RANDOM_ERRORS_DB_THROW(Xapian::DatabaseError, "Random Error");
+
+	L_DATABASE_WRAP_BEGIN("Database::get_documents_data:BEGIN {endpoint:%s, flags:(%s)}", repr(endpoints.to_string()), readable_flags(flags));
+	L_DATABASE_WRAP_END("Database::get_documents_data:END {endpoint:%s, flags:(%s)}", repr(endpoints.to_string()), readable_flags(flags));
+
+	db();
+
+	// Group positions by the shard owning the document (documents are
+	// interleaved among shards) and sort each group by docid so every
+	// shard is visited in a single, mostly sequential, pass.
+	auto n_shards = _databases.size();
+	ASSERT(n_shards > 0);
+	std::vector<std::vector<size_t>> shards(n_shards);
+	for (size_t pos = 0; pos < dids.size(); ++pos) {
+		ASSERT(dids[pos] > 0);
+		shards[(dids[pos] - 1) % n_shards].push_back(pos);
+	}
+	for (auto& positions : shards) {
+		std::sort(positions.begin(), positions.end(), [&](size_t a, size_t b) {
+			return dids[a] < dids[b];
+		});
+	}
+
+	// Each shard has its own Xapian::Database (and storage), so they can
+	// be read concurrently (using the shard searchers, when there are
+	// any) while this database is checked out.
+	auto fetch = [&](size_t shard) {
+		auto& rdb = _databases[shard].first;
+		for (auto pos : shards[shard]) {
+			auto did = dids[pos];
+			auto shard_did = (did - 1) / n_shards + 1;
+#ifdef HAVE_XAPIAN_DATABASE_GET_DOCUMENT_WITH_FLAGS
+			auto doc = rdb.get_document(shard_did, Xapian::DOC_ASSUME_VALID);
+#else
+			auto doc = rdb.get_document(shard_did);
+#endif
+			auto& result = results[pos];
+			result.data = doc.get_data();
+			if (slot != Xapian::BAD_VALUENO) {
+				result.value = doc.get_value(slot);
+			}
+			if (stored) {
+				auto data = Data(std::string(result.data));
+				auto locator = data.get("");
+				if (locator != nullptr && (locator->type == Locator::Type::stored || locator->type == Locator::Type::compressed_stored) && locator->raw.empty()) {
+#ifdef XAPIAND_DATA_STORAGE
+					const auto& storage = storages[shard];
+					if (storage) {
+						storage->open(string::format(DATA_STORAGE_PATH "%u", locator->volume));
+						storage->seek(static_cast<uint32_t>(locator->offset));
+						result.blob = storage->read();
+						continue;
+					}
+#endif /* XAPIAND_DATA_STORAGE */
+					std::string locator_key;
+					locator_key.push_back('\x00');
+					locator_key.append(serialise_length(locator->volume));
+					locator_key.append(serialise_length(locator->offset));
+					result.blob = rdb.get_metadata(locator_key);
+				}
+			}
+		}
+	};
+
+	for (int t = DB_RETRIES; t; --t) {
+		try {
+			std::vector<size_t> pending;
+			for (size_t shard = 0; shard < n_shards; ++shard) {
+				if (!shards[shard].empty()) {
+					pending.push_back(shard);
+				}
+			}
+			auto& searcher = shard_searcher();
+			if (searcher && pending.size() > 1) {
+				std::vector<std::future<void>> futures;
+				futures.reserve(pending.size() - 1);
+				for (size_t i = 1; i < pending.size(); ++i) {
+					futures.push_back(searcher->async(fetch, pending[i]));
+				}
+				std::exception_ptr eptr;
+				try {
+					fetch(pending[0]);
+				} catch (...) {
+					eptr = std::current_exception();
+				}
+				for (auto& future : futures) {
+					try {
+						future.get();
+					} catch (...) {
+						if (!eptr) {
+							eptr = std::current_exception();
+						}
+					}
+				}
+				if (eptr) {
+					std::rethrow_exception(eptr);
+				}
+			} else {
+				for (auto shard : pending) {
+					fetch(shard);
+				}
+			}
+			break;
+		} catch (const Xapian::DatabaseModifiedError& exc) {
+			if (t == 0) { throw; }
+		} catch (const Xapian::DatabaseOpeningError& exc) {
+			if (t == 0) { do_close(true, true, transaction, false); throw; }
+		} catch (const Xapian::NetworkError& exc) {
+			if (t == 0) { do_close(true, true, transaction, false); throw; }
+		} catch (const Xapian::DatabaseError& exc) {
+			if (exc.get_msg() == "Database has been closed") {
+				if (t == 0) { do_close(true, true, transaction, false); throw; }
+				do_close(false, is_closed(), transaction, false);
+			} else {
+				throw;
+			}
+		} catch (const Xapian::InvalidArgumentError&) {
+			THROW(DocNotFoundError, "Document not found");
+		} catch (const Xapian::DocNotFoundError&) {
+			THROW(DocNotFoundError, "Document not found");
+		}
+		reopen();
+		db();
+		if (_databases.size() != n_shards) {
+			THROW(Error, "Database shards changed while fetching documents");
+		}
+		L_DATABASE_WRAP_END("Database::get_documents_data:END {endpoint:%s, flags:(%s)} (%d retries)", repr(endpoints.to_string()), readable_flags(flags), DB_RETRIES - t);
+	}
+
+	return results;
+}
+
+
 std::string
 Database::get_metadata(const std::string& key, int subdatabase)
 {
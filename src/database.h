@@ -61,6 +61,14 @@ inline std::string readable_flags(int flags) {
 	return string::join(values, "|");
 }
 
+
+// Document data as returned by Database::get_documents_data()
+struct DocumentData {
+	std::string data;   // document data
+	std::string blob;   // stored blob (if requested and the data has one)
+	std::string value;  // value in the requested slot (if any)
+};
+
 //  ____        _        _
 // |  _ \  __ _| |_ __ _| |__   __ _ ___  ___
 // | | | |/ _` | __/ _` | '_ \ / _` / __|/ _ \
@@ -180,6 +188,7 @@ public:
 
 	Xapian::docid find_document(const std::string& term_id);
 	Xapian::Document get_document(Xapian::docid did, bool assume_valid_ = false);
+	std::vector<DocumentData> get_documents_data(const std::vector<Xapian::docid>& dids, bool stored = false, Xapian::valueno slot = Xapian::BAD_VALUENO);
 
 	std::vector<std::string> get_metadata_keys();
 	std::string get_metadata(const std::string& key, int subdatabase = 0);
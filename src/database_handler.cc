@@ -25,9 +25,14 @@
 #include <algorithm>                        // for min, move
 #include <array>                            // for std::array
 #include <cctype>                           // for tolower
-#include <exception>                        // for std::exception
+#include <exception>                        // for std::exception, std::exception_ptr
+#include <future>                           // for std::future
+#include <map>                              // for std::map
+#include <queue>                            // for std::priority_queue
+#include <unordered_set>                    // for std::unordered_set
 #include <utility>                          // for std::move
 
+#include "base_x.hh"                        // for Base62
 #include "blocking_concurrent_queue.h"      // for BlockingConcurrentQueue
 #include "cast.h"                           // for Cast
 #include "database.h"                       // for Database
@@ -38,11 +43,13 @@
 #include "lock_database.h"                  // for lock_database
 #include "log.h"                            // for L_CALL
 #include "manager.h"                        // for XapiandManager
+#include "metrics.h"                        // for Metrics::metrics
 #include "msgpack.h"                        // for MsgPack
 #include "msgpack_patcher.h"                // for apply_patch
 #include "multivalue/aggregation.h"         // for AggregationMatchSpy
 #include "multivalue/keymaker.h"            // for Multi_MultiValueKeyMaker
 #include "opts.h"                           // for opts::
+#include "query_cache.h"                    // for query_cache
 #include "query_dsl.h"                      // for QUERYDSL_QUERY, QueryDSL
 #include "rapidjson/document.h"             // for Document
 #include "repr.hh"                          // for repr
@@ -50,6 +57,7 @@
 #include "schemas_lru.h"                    // for SchemasLRU
 #include "script.h"                         // for Script
 #include "serialise.h"                      // for cast, serialise, type
+#include "sort_keys_cache.h"                // for sort_keys_cache
 
 #if defined(XAPIAND_V8)
 #include "v8pp/v8pp.h"                      // for v8pp namespace
@@ -89,6 +97,11 @@ constexpr const char RESPONSE_VALUES[]              = "#values";
 constexpr const char RESPONSE_VOLUME[]              = "#volume";
 constexpr const char RESPONSE_WDF[]                 = "#wdf";
 
+// Operations accepted by the bulk endpoint.
+constexpr const char BULK_INDEX[]                   = "index";
+constexpr const char BULK_UPDATE[]                  = "update";
+constexpr const char BULK_DELETE[]                  = "delete";
+
 constexpr size_t NON_STORED_SIZE_LIMIT = 1024 * 1024;
 
 const std::string dump_metadata_header ("xapiand-dump-meta");
@@ -141,6 +154,34 @@ to_docid(std::string_view document_id)
 }
 
 
+std::string
+cursor_t::serialise() const
+{
+	return Base62::inverted().encode(serialise_length(did) + serialise_string(sort_key));
+}
+
+
+cursor_t
+cursor_t::unserialise(std::string_view cursor)
+{
+	try {
+		auto serialised = Base62::inverted().decode(cursor);
+		const char *p = serialised.data();
+		const char *p_end = p + serialised.size();
+		auto did = static_cast<Xapian::docid>(unserialise_length(&p, p_end));
+		auto sort_key = unserialise_string(&p, p_end);
+		if (did == 0 || p != p_end) {
+			THROW(ClientError, "Invalid cursor: %s", repr(cursor));
+		}
+		return cursor_t(std::string(sort_key), did);
+	} catch (const SerialisationError&) {
+		THROW(ClientError, "Invalid cursor: %s", repr(cursor));
+	} catch (const std::invalid_argument&) {
+		THROW(ClientError, "Invalid cursor: %s", repr(cursor));
+	}
+}
+
+
 static void
 inject_blob(Data& data, const MsgPack& obj)
 {
@@ -242,6 +283,34 @@ public:
 };
 
 
+// Accepts only the documents sorted after the cursor: by sort key (if
+// any) and then by docid. Shards map their own docids back to the ones
+// of the combined database, which are the ones the cursor keeps.
+class SearchAfterDecider : public Xapian::MatchDecider {
+	const Xapian::KeyMaker* sorter;
+	const cursor_t& after;
+	Xapian::docid n_shards;
+	Xapian::docid shard;
+
+public:
+	SearchAfterDecider(const Xapian::KeyMaker* sorter_, const cursor_t& after_, Xapian::docid n_shards_ = 1, Xapian::docid shard_ = 0)
+		: sorter(sorter_),
+		  after(after_),
+		  n_shards(n_shards_),
+		  shard(shard_) { }
+
+	bool operator() (const Xapian::Document& doc) const override {
+		if (sorter != nullptr) {
+			auto sort_key = (*sorter)(doc);
+			if (sort_key != after.sort_key) {
+				return sort_key > after.sort_key;
+			}
+		}
+		return (doc.get_docid() - 1) * n_shards + shard + 1 > after.did;
+	}
+};
+
+
 //  ____        _        _                    _   _                 _ _
 // |  _ \  __ _| |_ __ _| |__   __ _ ___  ___| | | | __ _ _ __   __| | | ___ _ __
 // | | | |/ _` | __/ _` | '_ \ / _` / __|/ _ \ |_| |/ _` | '_ \ / _` | |/ _ \ '__|
@@ -316,9 +385,29 @@ DatabaseHandler::check()
 	}
 
 	try {
+#ifdef XAPIAND_DATA_STORAGE
+		// Data storage volumes are verified by the background scrubbers,
+		// report the last results and schedule a new (full) pass.
+		auto& path = endpoints[0].path;
+		MsgPack storage;
+		if (opts.num_scrubbers) {
+			storage = storage_scrub_status(path);
+			storage_scrub_rewind(path);
+			scrubber()->debounce(path, path);
+		} else {
+			storage = MsgPack({
+				{"status", "disabled"},
+			});
+		}
+		return {
+			{"errors", Xapian::Database::check(path)},
+			{"storage", storage},
+		};
+#else
 		return {
 			{"errors", Xapian::Database::check(endpoints[0].path)},
 		};
+#endif
 	} catch (const Xapian::Error &error) {
 		return {
 			{"error", error.get_description()},
@@ -350,8 +439,22 @@ DatabaseHandler::get_document_term(std::string_view term_id)
 
 
 #if defined(XAPIAND_CHAISCRIPT) || defined(XAPIAND_V8)
-std::mutex DatabaseHandler::documents_mtx;
-std::unordered_map<std::string, std::shared_ptr<std::pair<std::string, const Data>>> DatabaseHandler::documents;
+std::array<DatabaseHandler::DocumentsShard, DOCUMENT_CHANGES_SHARDS> DatabaseHandler::documents_shards;
+
+
+std::pair<DatabaseHandler::DocumentsShard&, std::unique_lock<std::mutex>>
+DatabaseHandler::lock_documents_shard(const std::string& key)
+{
+	auto& shard = documents_shards[std::hash<std::string>{}(key) % DOCUMENT_CHANGES_SHARDS];
+	std::unique_lock<std::mutex> lk(shard.mtx, std::try_to_lock);
+	if (!lk.owns_lock()) {
+		Metrics::metrics()
+			.xapiand_document_changes_contention
+			.Increment();
+		lk.lock();
+	}
+	return { shard, std::move(lk) };
+}
 
 
 template<typename Processor>
@@ -661,10 +764,10 @@ DatabaseHandler::patch(const MsgPack& document_id, const MsgPack& patches, bool
 }
 
 
-DataType
-DatabaseHandler::merge(const MsgPack& document_id, bool stored, const MsgPack& body, bool commit, const ct_type_t& ct_type)
+std::tuple<std::string, Xapian::Document, MsgPack>
+DatabaseHandler::prepare_merge(const MsgPack& document_id, bool stored, const MsgPack& body, const ct_type_t& ct_type)
 {
-	L_CALL("DatabaseHandler::merge(%s, %s, <body>, %s, %s/%s)", repr(document_id.to_string()), stored ? "true" : "false", commit ? "true" : "false", ct_type.first, ct_type.second);
+	L_CALL("DatabaseHandler::prepare_merge(%s, %s, <body>, %s/%s)", repr(document_id.to_string()), stored ? "true" : "false", ct_type.first, ct_type.second);
 
 	if ((flags & DB_WRITABLE) != DB_WRITABLE) {
 		THROW(Error, "database is read-only");
@@ -698,28 +801,28 @@ DatabaseHandler::merge(const MsgPack& document_id, bool stored, const MsgPack& b
 					}
 					data.update(ct_type, blob);
 				}
-				return index(document_id, obj, data, old_document_pair, commit);
+				return prepare(document_id, obj, data, old_document_pair);
 			case MsgPack::Type::NIL:
 			case MsgPack::Type::UNDEFINED:
 				data.erase(ct_type);
-				return index(document_id, obj, data, old_document_pair, commit);
+				return prepare(document_id, obj, data, old_document_pair);
 			case MsgPack::Type::MAP:
 				if (stored) {
 					THROW(ClientError, "Objects of this type cannot be put in storage");
 				}
 				if (obj.empty()) {
 					inject_data(data, body);
-					return index(document_id, body, data, old_document_pair, commit);
+					return prepare(document_id, body, data, old_document_pair);
 				} else {
 					obj.update(body);
 					inject_data(data, obj);
-					return index(document_id, obj, data, old_document_pair, commit);
+					return prepare(document_id, obj, data, old_document_pair);
 				}
 			default:
 				THROW(ClientError, "Indexed object must be a JSON, a MsgPack or a blob, is %s", body.getStrType());
 		}
 
-		return index(document_id, obj, data, old_document_pair, commit);
+		return prepare(document_id, obj, data, old_document_pair);
 	} catch (...) {
 		if (old_document_pair != nullptr) {
 			dec_document_change_cnt(old_document_pair);
@@ -729,6 +832,22 @@ DatabaseHandler::merge(const MsgPack& document_id, bool stored, const MsgPack& b
 }
 
 
+DataType
+DatabaseHandler::merge(const MsgPack& document_id, bool stored, const MsgPack& body, bool commit, const ct_type_t& ct_type)
+{
+	L_CALL("DatabaseHandler::merge(%s, %s, <body>, %s, %s/%s)", repr(document_id.to_string()), stored ? "true" : "false", commit ? "true" : "false", ct_type.first, ct_type.second);
+
+	auto prepared = prepare_merge(document_id, stored, body, ct_type);
+	auto& term_id = std::get<0>(prepared);
+	auto& doc = std::get<1>(prepared);
+	auto& data_obj = std::get<2>(prepared);
+
+	lock_database lk_db(this);
+	auto did = database()->replace_document_term(term_id, std::move(doc), commit);
+	return std::make_pair(std::move(did), std::move(data_obj));
+}
+
+
 void
 DatabaseHandler::write_schema(const MsgPack& obj, bool replace)
 {
@@ -1174,27 +1293,38 @@ DatabaseHandler::dump_documents()
 
 
 
-std::tuple<std::string, Xapian::Document, MsgPack>
-DatabaseHandler::prepare_document(const MsgPack& obj)
+static MsgPack
+get_document_id(const MsgPack& obj)
 {
-	L_CALL("DatabaseHandler::prepare_document(<obj>)");
-
 	MsgPack document_id;
 
-	auto f_it = obj.find(ID_FIELD_NAME);
-	if (f_it != obj.end()) {
-		const auto& field = f_it.value();
-		if (field.is_map()) {
-			auto f_it_end = field.end();
-			auto fv_it = field.find(RESERVED_VALUE);
-			if (fv_it != f_it_end) {
-				document_id = fv_it.value();
+	if (obj.is_map()) {
+		auto f_it = obj.find(ID_FIELD_NAME);
+		if (f_it != obj.end()) {
+			const auto& field = f_it.value();
+			if (field.is_map()) {
+				auto f_it_end = field.end();
+				auto fv_it = field.find(RESERVED_VALUE);
+				if (fv_it != f_it_end) {
+					document_id = fv_it.value();
+				}
+			} else {
+				document_id = field;
 			}
-		} else {
-			document_id = field;
 		}
 	}
 
+	return document_id;
+}
+
+
+std::tuple<std::string, Xapian::Document, MsgPack>
+DatabaseHandler::prepare_document(const MsgPack& obj)
+{
+	L_CALL("DatabaseHandler::prepare_document(<obj>)");
+
+	auto document_id = get_document_id(obj);
+
 	Data data;
 	inject_data(data, obj);
 
@@ -1304,6 +1434,187 @@ DatabaseHandler::restore_documents(const MsgPack& docs)
 }
 
 
+void
+DatabaseHandler::bulk(const std::function<const MsgPack*()>& next_operation, const ct_type_t& ct_type, const bulk_status_t& status)
+{
+	L_CALL("DatabaseHandler::bulk(<next_operation>)");
+
+	if ((flags & DB_WRITABLE) != DB_WRITABLE) {
+		THROW(Error, "Database is read-only");
+	}
+
+	// Operations are taken from next_operation (possibly while they are
+	// still being received) and prepared (schema, terms, values and data)
+	// in parallel by the shared bulk preparers pool, then applied by this
+	// thread, which is the only writer, in the same order they were
+	// received; operations on an id already seen in the batch are prepared
+	// by the writer too, so they see the effect of the previous ones. The
+	// whole batch ends with a single commit (and thus a single WAL revision).
+	struct Operation {
+		size_t pos = 0;
+		std::string op;
+		MsgPack document_id;
+		MsgPack body;
+		bool serial = false;
+		std::tuple<std::string, Xapian::Document, MsgPack> prepared;
+		std::exception_ptr eptr;
+	};
+
+	// Maximum number of operations being prepared at any given time.
+	constexpr size_t limit_max = 512;
+
+	// Prepared operations come back through this queue, it's shared with
+	// the tasks so it outlives requests aborted while they're still queued.
+	auto queue = std::make_shared<BlockingConcurrentQueue<Operation>>();
+
+	auto& preparer = bulk_preparer();
+
+	std::unordered_set<std::string> seen;
+	std::map<size_t, Operation> pending;
+	size_t pos = 0;
+	size_t processed = 0;
+	size_t preparing = 0;
+
+	// Write operations, in order.
+	auto write = [&](Operation&& operation) {
+		auto operation_pos = operation.pos;
+		pending.emplace(operation_pos, std::move(operation));
+		for (auto it = pending.begin(); it != pending.end() && it->first == processed; it = pending.erase(it)) {
+			auto& item = it->second;
+			Xapian::docid did = 0;
+			if (!item.eptr) {
+				try {
+					if (item.op == BULK_DELETE) {
+						lock_database lk_db(this);
+						did = database()->find_document(get_prefixed_term_id(item.document_id));
+						database()->delete_document(did, false);
+					} else {
+						if (item.serial) {
+							if (item.op == BULK_UPDATE) {
+								item.prepared = prepare_merge(item.document_id, false, item.body, ct_type);
+							} else {
+								item.prepared = prepare(item.document_id, false, item.body, ct_type);
+							}
+						}
+						lock_database lk_db(this);
+						did = database()->replace_document_term(std::get<0>(item.prepared), std::move(std::get<1>(item.prepared)), false);
+					}
+				} catch (...) {
+					item.eptr = std::current_exception();
+				}
+			}
+			status(item.op, item.document_id, did, item.eptr);
+			++processed;
+		}
+	};
+
+	// Collect prepared operations, blocking (until one is ready) if wait
+	// is set. Returns false if the server is detaching.
+	auto collect = [&](bool wait) {
+		Operation item;
+		while (preparing != 0) {
+			if (wait) {
+				if (!queue->wait_dequeue_timed(item, 100ms)) {
+					if (XapiandManager::manager()->is_detaching()) {
+						return false;
+					}
+					continue;
+				}
+				wait = false;
+			} else if (!queue->try_dequeue(item)) {
+				break;
+			}
+			--preparing;
+			write(std::move(item));
+		}
+		return true;
+	};
+
+	try {
+		while (auto operation = next_operation()) {
+			if (XapiandManager::manager()->is_detaching()) {
+				break;
+			}
+			Operation item;
+			item.pos = pos++;
+			try {
+				if (!operation->is_map() || operation->size() != 1) {
+					THROW(ClientError, "Bulk operation must be an object with one of '%s', '%s' or '%s'", BULK_INDEX, BULK_UPDATE, BULK_DELETE);
+				}
+				auto it = operation->begin();
+				item.op = it->str();
+				const auto& body = it.value();
+				if (item.op == BULK_DELETE) {
+					item.document_id = body.is_map() ? get_document_id(body) : body;
+					if (!item.document_id) {
+						THROW(ClientError, "Document must have an 'id'");
+					}
+				} else if (item.op == BULK_INDEX || item.op == BULK_UPDATE) {
+					item.document_id = get_document_id(body);
+					item.body = body;
+				} else {
+					THROW(ClientError, "Unknown bulk operation: %s", repr(item.op));
+				}
+				if (item.document_id) {
+					item.serial = !seen.insert(item.document_id.serialise()).second;
+				}
+			} catch (...) {
+				item.eptr = std::current_exception();
+			}
+			if (!item.eptr && !item.serial && item.op != BULK_DELETE && preparer && !preparer->finished()) {
+				auto shared_item = std::make_shared<Operation>(std::move(item));
+				if (preparer->enqueue([queue, shared_item, endpoints = endpoints, flags = flags, method = method, ct_type = ct_type]() {
+					auto& item = *shared_item;
+					try {
+						DatabaseHandler db_handler(endpoints, flags, method);
+						if (item.op == BULK_UPDATE) {
+							item.prepared = db_handler.prepare_merge(item.document_id, false, item.body, ct_type);
+						} else {
+							item.prepared = db_handler.prepare(item.document_id, false, item.body, ct_type);
+						}
+					} catch (...) {
+						item.eptr = std::current_exception();
+					}
+					queue->enqueue(std::move(item));
+				})) {
+					++preparing;
+					if (!collect(preparing >= limit_max)) {
+						break;
+					}
+					continue;
+				}
+				// The pool didn't take it, the writer prepares it instead.
+				shared_item->serial = true;
+				write(std::move(*shared_item));
+			} else {
+				// Nothing to prepare (or it must be prepared by the writer).
+				write(std::move(item));
+			}
+			if (!collect(false)) {
+				break;
+			}
+		}
+	} catch (...) {
+		// The source of operations failed (e.g. a malformed or incomplete
+		// body), operations already dispatched are still written and the
+		// error is raised once they are.
+		while (preparing != 0 && collect(true)) { }
+		if (processed != 0) {
+			lock_database lk_db(this);
+			database()->commit();
+		}
+		throw;
+	}
+
+	while (preparing != 0 && collect(true)) { }
+
+	if (processed != 0) {
+		lock_database lk_db(this);
+		database()->commit();
+	}
+}
+
+
 MSet
 DatabaseHandler::get_all_mset(Xapian::docid initial, size_t limit)
 {
@@ -1359,6 +1670,25 @@ DatabaseHandler::get_mset(const query_field_t& query_field, const MsgPack* qdsl,
 	auto limit = query_field.limit;
 	auto check_at_least = query_field.check_at_least;
 	auto offset = query_field.offset;
+	auto is_after = query_field.is_after;
+	auto after_str = query_field.after;
+
+	// Xapian objects are not thread safe, so every shard searched in
+	// parallel gets its very own copy of the query built from scratch.
+	auto build_query = [&]() {
+		switch (method) {
+			case HTTP_GET:
+			case HTTP_POST: {
+				QueryDSL query_object(schema);
+				if (qdsl && qdsl->find(QUERYDSL_QUERY) != qdsl->end()) {
+					return query_object.get_query(qdsl->at(QUERYDSL_QUERY));
+				}
+				return query_object.get_query(query_object.make_dsl_query(query_field));
+			}
+			default:
+				return Xapian::Query();
+		}
+	};
 
 	Xapian::Query query;
 	std::unique_ptr<Multi_MultiValueKeyMaker> sorter;
@@ -1372,11 +1702,7 @@ DatabaseHandler::get_mset(const query_field_t& query_field, const MsgPack* qdsl,
 				query_object.get_sorter(sorter, value);
 			}
 
-			if (qdsl && qdsl->find(QUERYDSL_QUERY) != qdsl->end()) {
-				query = query_object.get_query(qdsl->at(QUERYDSL_QUERY));
-			} else {
-				query = query_object.get_query(query_object.make_dsl_query(query_field));
-			}
+			query = build_query();
 
 			if (qdsl && qdsl->find(QUERYDSL_OFFSET) != qdsl->end()) {
 				auto value = qdsl->at(QUERYDSL_OFFSET);
@@ -1405,6 +1731,19 @@ DatabaseHandler::get_mset(const query_field_t& query_field, const MsgPack* qdsl,
 				}
 			}
 
+			if (qdsl && qdsl->find(QUERYDSL_AFTER) != qdsl->end()) {
+				auto value = qdsl->at(QUERYDSL_AFTER);
+				if (value.is_string()) {
+					is_after = true;
+					after_str = value.as_str();
+				} else if (value.is_null()) {
+					is_after = true;
+					after_str.clear();
+				} else {
+					THROW(ClientError, "The %s must be a string", QUERYDSL_AFTER);
+				}
+			}
+
 			break;
 		}
 
@@ -1465,12 +1804,89 @@ DatabaseHandler::get_mset(const query_field_t& query_field, const MsgPack* qdsl,
 		fuzzy_rset = get_rset(query, query_field.fuzzy.n_rset);
 	}
 
+	// Search-after cursors page through the results in a stable order
+	// (sort key then docid, with no relevance involved) by filtering out
+	// everything up to the cursor, instead of ranking and skipping an offset.
+	cursor_t after;
+	std::unique_ptr<SearchAfterDecider> after_decider;
+	if (is_after) {
+		offset = 0;
+		if (!after_str.empty()) {
+			after = cursor_t::unserialise(after_str);
+			after_decider = std::make_unique<SearchAfterDecider>(sorter.get(), after);
+		}
+	}
+
 	MSet mset{};
 
+	// Shards can only be searched independently when nothing
+	// needs the whole (combined) database to be computed. That
+	// includes relevance: each shard would weight its matches using
+	// its own statistics (document counts, lengths and frequencies),
+	// so only results ordered by sort keys or by docid (search-after
+	// cursors, boolean weighted) are searched in parallel; relevance
+	// there only breaks ties between documents with the same keys (and
+	// the weights and percentages reported are each shard's own).
+	bool parallel = (
+		shard_searcher() &&
+		(sorter || is_after) &&
+		collapse_key == Xapian::BAD_VALUENO &&
+		!query_field.is_nearest &&
+		!query_field.is_fuzzy
+	);
+
 	lock_database lk_db(this);
+
+	// Repeated searches are answered from the query cache for as long as
+	// none of the shards has changed, cached results are tagged with the
+	// revision of every shard so any commit invalidates them. Writable
+	// (volatile) databases can have uncommitted changes the revision
+	// doesn't reflect, so those are never cached.
+	auto& cache = query_cache();
+	std::string cache_key;
+	if (cache && !query_field.as_volatile && !database()->is_writable() && !query_field.is_nearest && !query_field.is_fuzzy) {
+		cache_key = get_mset_cache_key(query_field, qdsl);
+		if (!cache_key.empty()) {
+			auto revision = get_shards_revision();
+			if (!revision.empty()) {
+				auto cached = cache->get(cache_key, revision);
+				if (cached) {
+					if (aggs != nullptr && !cached->aggregations.empty()) {
+						aggs->merge_results(cached->aggregations);
+					}
+					return cached->mset;
+				}
+			} else {
+				cache_key.clear();
+			}
+		}
+	}
+
+	// Match deciders only get shard-local docids but cursors keep the
+	// combined ones, so sharded searches after a cursor always search
+	// each shard on its own and map docids back, as get_shards_mset does.
+	bool sharded_after = after_decider && database()->_databases.size() > 1;
+	if (sharded_after && !parallel && (collapse_key != Xapian::BAD_VALUENO || query_field.is_nearest || query_field.is_fuzzy)) {
+		THROW(ClientError, "Search-after cursors cannot be used together with collapse, nearest or fuzzy in sharded indexes");
+	}
+
 	for (int t = DB_RETRIES; t >= 0; --t) {
 		try {
+			if ((parallel || sharded_after) && database()->_databases.size() > 1) {
+				mset = get_shards_mset(query, build_query, sorter.get(), aggs, is_after ? &after : nullptr, offset, limit, check_at_least);
+				break;
+			}
 			auto final_query = query;
+			if (sorter && sort_keys_cache() && !query_field.as_volatile && !database()->is_writable() && database()->_databases.size() == 1) {
+				// Sort keys of plain fields are reused from previous searches
+				// for as long as the database hasn't changed. Key makers only
+				// get shard-local docids, which collide across shards, so
+				// sharded searches don't use the cache.
+				auto revision = get_shards_revision();
+				if (!revision.empty()) {
+					sorter->use_columns(endpoints.to_string(), revision);
+				}
+			}
 			Xapian::Enquire enquire(*db());
 			if (collapse_key != Xapian::BAD_VALUENO) {
 				enquire.set_collapse_key(collapse_key, query_field.collapse_max);
@@ -1478,7 +1894,12 @@ DatabaseHandler::get_mset(const query_field_t& query_field, const MsgPack* qdsl,
 			if (aggs != nullptr) {
 				enquire.add_matchspy(aggs);
 			}
-			if (sorter) {
+			if (is_after) {
+				enquire.set_weighting_scheme(Xapian::BoolWeight());
+				if (sorter) {
+					enquire.set_sort_by_key(sorter.get(), false);
+				}
+			} else if (sorter) {
 				enquire.set_sort_by_key_then_relevance(sorter.get(), false);
 			}
 			if (query_field.is_nearest) {
@@ -1490,7 +1911,7 @@ DatabaseHandler::get_mset(const query_field_t& query_field, const MsgPack* qdsl,
 				final_query = Xapian::Query(Xapian::Query::OP_OR, final_query, Xapian::Query(Xapian::Query::OP_ELITE_SET, eset.begin(), eset.end(), query_field.fuzzy.n_term));
 			}
 			enquire.set_query(final_query);
-			mset = enquire.get_mset(offset, limit, check_at_least);
+			mset = enquire.get_mset(offset, limit, check_at_least, nullptr, after_decider.get());
 			break;
 		} catch (const Xapian::DatabaseModifiedError& exc) {
 			if (t == 0) { THROW(TimeOutError, "Database was modified, try again: %s", exc.get_description()); }
@@ -1512,6 +1933,202 @@ DatabaseHandler::get_mset(const query_field_t& query_field, const MsgPack* qdsl,
 		database()->reopen();
 	}
 
+	if (!cache_key.empty()) {
+		// The revision is taken again as the database could
+		// have been reopened while retrying the search.
+		auto revision = get_shards_revision();
+		if (!revision.empty()) {
+			cache->set(cache_key, std::make_shared<const cached_query_t>(std::move(revision), mset, aggs != nullptr ? aggs->serialise_results() : ""));
+		}
+	}
+
+	return mset;
+}
+
+
+std::string
+DatabaseHandler::get_mset_cache_key(const query_field_t& query_field, const MsgPack* qdsl)
+{
+	L_CALL("DatabaseHandler::get_mset_cache_key(<query_field>, %s)", qdsl ? repr(qdsl->to_string()) : "null");
+
+	std::string key;
+	key.append(serialise_string(endpoints.to_string()));
+	key.append(serialise_length(method));
+	key.append(serialise_length(query_field.query.size()));
+	for (const auto& query : query_field.query) {
+		key.append(serialise_string(query));
+	}
+	key.append(serialise_length(query_field.sort.size()));
+	for (const auto& sort : query_field.sort) {
+		key.append(serialise_string(sort));
+	}
+	key.append(serialise_length(query_field.offset));
+	key.append(serialise_length(query_field.limit));
+	key.append(serialise_length(query_field.check_at_least));
+	key.append(serialise_string(query_field.collapse));
+	key.append(serialise_length(query_field.collapse_max));
+	key.append(serialise_length(query_field.is_after));
+	key.append(serialise_string(query_field.after));
+	key.append(serialise_string(query_field.metric));
+	key.append(serialise_length(query_field.icase));
+	key.append(serialise_string(query_field.time));
+	key.append(serialise_string(query_field.period));
+	// The QueryDSL (including any sort, limit and aggregations
+	// in it) goes in canonical form, with its keys sorted.
+	if (qdsl) {
+		QueryCache::canonicalise(key, *qdsl);
+	}
+	return key;
+}
+
+
+std::string
+DatabaseHandler::get_shards_revision()
+{
+	L_CALL("DatabaseHandler::get_shards_revision()");
+
+	// Remote shards are never cached, there's no way of knowing
+	// when they change without asking their nodes every time.
+	std::string revision;
+#if HAVE_XAPIAN_DATABASE_GET_REVISION
+	for (auto& shard : database()->_databases) {
+		if (!shard.second) {
+			return "";
+		}
+		revision.append(serialise_length(shard.first.get_revision()));
+	}
+#endif
+	return revision;
+}
+
+
+MSet
+DatabaseHandler::get_shards_mset(const Xapian::Query& query, const std::function<Xapian::Query()>& build_query, Xapian::KeyMaker* sorter, AggregationMatchSpy* aggs, const cursor_t* cursor, unsigned offset, unsigned limit, unsigned check_at_least)
+{
+	L_CALL("DatabaseHandler::get_shards_mset(%s, %u, %u, %u)", repr(query.get_description()), offset, limit, check_at_least);
+
+	auto& shards = database()->_databases;
+	auto n_shards = shards.size();
+
+	// Every shard must return enough matches to fill the requested
+	// page by itself, the final page is then merged from all of them.
+	// Aggregations are computed per shard by their own match spy and
+	// merged back into the given one once all shards are done.
+	std::vector<Xapian::Enquire> enquires;
+	std::vector<std::unique_ptr<Xapian::MatchSpy>> spies;
+	std::vector<std::unique_ptr<SearchAfterDecider>> deciders(n_shards);
+	enquires.reserve(n_shards);
+	for (size_t shard = 0; shard < n_shards; ++shard) {
+		auto& enquire = enquires.emplace_back(shards[shard].first);
+		if (aggs != nullptr) {
+			auto& spy = spies.emplace_back(aggs->clone());
+			enquire.add_matchspy(spy.get());
+		}
+		if (cursor != nullptr) {
+			enquire.set_weighting_scheme(Xapian::BoolWeight());
+			if (sorter != nullptr) {
+				enquire.set_sort_by_key(sorter, false);
+			}
+			if (cursor->did != 0) {
+				deciders[shard] = std::make_unique<SearchAfterDecider>(sorter, *cursor, n_shards, shard);
+			}
+		} else if (sorter != nullptr) {
+			enquire.set_sort_by_key_then_relevance(sorter, false);
+		}
+		enquire.set_query(shard == 0 ? query : build_query());
+	}
+
+	std::vector<Xapian::MSet> msets(n_shards);
+	auto search = [&](size_t shard) {
+		msets[shard] = enquires[shard].get_mset(0, offset + limit, check_at_least, nullptr, deciders[shard].get());
+	};
+
+	// Without the shard searcher pool shards are searched one after the other.
+	auto& searcher = shard_searcher();
+	std::vector<std::future<void>> futures;
+	futures.reserve(n_shards - 1);
+	if (searcher) {
+		for (size_t shard = 1; shard < n_shards; ++shard) {
+			futures.push_back(searcher->async(search, shard));
+		}
+	}
+	std::exception_ptr eptr;
+	try {
+		search(0);
+		if (!searcher) {
+			for (size_t shard = 1; shard < n_shards; ++shard) {
+				search(shard);
+			}
+		}
+	} catch (...) {
+		eptr = std::current_exception();
+	}
+	for (auto& future : futures) {
+		try {
+			future.get();
+		} catch (...) {
+			if (!eptr) {
+				eptr = std::current_exception();
+			}
+		}
+	}
+	if (eptr) {
+		std::rethrow_exception(eptr);
+	}
+
+	for (auto& spy : spies) {
+		aggs->merge_results(spy->serialise_results());
+	}
+
+	// k-way merge of the (already sorted) shard results
+	struct Head {
+		size_t shard;
+		Xapian::MSetIterator it;
+		Xapian::docid did;
+	};
+	auto after = [&](const Head& a, const Head& b) {
+		if (sorter != nullptr) {
+			auto a_key = a.it.get_sort_key();
+			auto b_key = b.it.get_sort_key();
+			if (a_key != b_key) {
+				return a_key > b_key;
+			}
+		}
+		auto a_weight = a.it.get_weight();
+		auto b_weight = b.it.get_weight();
+		if (a_weight != b_weight) {
+			return a_weight < b_weight;
+		}
+		return a.did > b.did;
+	};
+	std::priority_queue<Head, std::vector<Head>, decltype(after)> heads(after);
+
+	Xapian::doccount matches_estimated = 0;
+	for (size_t shard = 0; shard < n_shards; ++shard) {
+		auto& shard_mset = msets[shard];
+		matches_estimated += shard_mset.get_matches_estimated();
+		auto it = shard_mset.begin();
+		if (it != shard_mset.end()) {
+			heads.push({ shard, it, (*it - 1) * static_cast<Xapian::docid>(n_shards) + static_cast<Xapian::docid>(shard) + 1 });
+		}
+	}
+
+	MSet mset;
+	Xapian::doccount rank = 0;
+	while (!heads.empty() && rank < offset + limit) {
+		auto head = heads.top();
+		heads.pop();
+		if (rank >= offset) {
+			mset.push_back(head.did, rank, head.it.get_weight(), head.it.get_percent(), sorter != nullptr ? head.it.get_sort_key() : std::string());
+		}
+		++rank;
+		if (++head.it != msets[head.shard].end()) {
+			head.did = (*head.it - 1) * static_cast<Xapian::docid>(n_shards) + static_cast<Xapian::docid>(head.shard) + 1;
+			heads.push(head);
+		}
+	}
+	mset.set_matches_estimated(matches_estimated);
+
 	return mset;
 }
 
@@ -1655,6 +2272,16 @@ DatabaseHandler::get_document(std::string_view document_id)
 }
 
 
+std::vector<DocumentData>
+DatabaseHandler::get_documents_data(const std::vector<Xapian::docid>& dids, bool stored, Xapian::valueno slot)
+{
+	L_CALL("DatabaseHandler::get_documents_data(<%zu dids>, %s, %u)", dids.size(), stored ? "true" : "false", slot);
+
+	lock_database lk_db(this);
+	return database()->get_documents_data(dids, stored, slot);
+}
+
+
 Xapian::docid
 DatabaseHandler::get_docid(std::string_view document_id)
 {
@@ -1819,12 +2446,13 @@ DatabaseHandler::get_document_change_seq(std::string_view term_id, bool validate
 	auto key = endpoints[0].path + std::string(term_id);
 	bool is_local = endpoints[0].is_local();
 
-	std::unique_lock<std::mutex> lk(DatabaseHandler::documents_mtx);
+	auto [shard, lk] = lock_documents_shard(key);
+	auto& documents = shard.documents;
 
-	auto it = is_local ? DatabaseHandler::documents.find(key) : DatabaseHandler::documents.end();
+	auto it = is_local ? documents.find(key) : documents.end();
 
 	std::shared_ptr<std::pair<std::string, const Data>> current_document_pair;
-	if (it == DatabaseHandler::documents.end()) {
+	if (it == documents.end()) {
 		lk.unlock();
 
 		// Get document from database
@@ -1840,7 +2468,7 @@ DatabaseHandler::get_document_change_seq(std::string_view term_id, bool validate
 		lk.lock();
 
 		if (is_local) {
-			it = DatabaseHandler::documents.emplace(key, current_document_pair).first;
+			it = documents.emplace(key, current_document_pair).first;
 			current_document_pair = it->second;
 		}
 	} else {
@@ -1860,12 +2488,13 @@ DatabaseHandler::set_document_change_seq(const std::shared_ptr<std::pair<std::st
 	auto key = endpoints[0].path + new_document_pair->first;
 	bool is_local = endpoints[0].is_local();
 
-	std::unique_lock<std::mutex> lk(DatabaseHandler::documents_mtx);
+	auto [shard, lk] = lock_documents_shard(key);
+	auto& documents = shard.documents;
 
-	auto it = is_local ? DatabaseHandler::documents.find(key) : DatabaseHandler::documents.end();
+	auto it = is_local ? documents.find(key) : documents.end();
 
 	std::shared_ptr<std::pair<std::string, const Data>> current_document_pair;
-	if (it == DatabaseHandler::documents.end()) {
+	if (it == documents.end()) {
 		if (old_document_pair != nullptr) {
 			lk.unlock();
 
@@ -1878,7 +2507,7 @@ DatabaseHandler::set_document_change_seq(const std::shared_ptr<std::pair<std::st
 			lk.lock();
 
 			if (is_local) {
-				it = DatabaseHandler::documents.emplace(key, current_document_pair).first;
+				it = documents.emplace(key, current_document_pair).first;
 				current_document_pair = it->second;
 			}
 		}
@@ -1891,9 +2520,9 @@ DatabaseHandler::set_document_change_seq(const std::shared_ptr<std::pair<std::st
 	current_document_pair.reset();
 	old_document_pair.reset();
 
-	if (it != DatabaseHandler::documents.end()) {
+	if (it != documents.end()) {
 		if (it->second.use_count() == 1) {
-			DatabaseHandler::documents.erase(it);
+			documents.erase(it);
 		} else if (accepted) {
 			it->second = new_document_pair;
 		}
@@ -1912,18 +2541,19 @@ DatabaseHandler::dec_document_change_cnt(std::shared_ptr<std::pair<std::string,
 	auto key = endpoints[0].path + old_document_pair->first;
 	bool is_local = endpoints[0].is_local();
 
-	std::lock_guard<std::mutex> lk(DatabaseHandler::documents_mtx);
+	auto [shard, lk] = lock_documents_shard(key);
+	auto& documents = shard.documents;
 
-	auto it = DatabaseHandler::documents.end();
+	auto it = documents.end();
 	if (is_local) {
-		it = DatabaseHandler::documents.find(key);
+		it = documents.find(key);
 	}
 
 	old_document_pair.reset();
 
-	if (it != DatabaseHandler::documents.end()) {
+	if (it != documents.end()) {
 		if (it->second.use_count() == 1) {
-			DatabaseHandler::documents.erase(it);
+			documents.erase(it);
 		}
 	}
 }
@@ -24,6 +24,10 @@
 
 #include "config.h"
 
+#include <array>                             // for std::array
+#include <exception>                         // for std::exception_ptr
+#include <functional>                        // for std::function
+#include <iterator>                          // for std::prev
 #include <memory>                            // for shared_ptr, make_shared
 #include <stddef.h>                          // for size_t
 #include <string>                            // for string
@@ -40,6 +44,7 @@
 #include "lock_database.h"                   // for LockableDatabase
 #include "opts.h"                            // for opts::*
 #include "thread.hh"                         // for ThreadPolicyType::*
+#include "threadpool.hh"                     // for ThreadPool
 
 
 class AggregationMatchSpy;
@@ -60,6 +65,24 @@ struct similar_field_t;
 Xapian::docid to_docid(std::string_view document_id);
 
 
+// Search-after cursor, the position (sort key and docid) of the last hit
+// of a page; the following page starts right after it, so deep pages cost
+// the same as the first one instead of ranking and skipping an offset.
+struct cursor_t {
+	std::string sort_key;
+	Xapian::docid did;
+
+	cursor_t() : did{0} { }
+
+	cursor_t(std::string sort_key_, Xapian::docid did_) :
+		sort_key{std::move(sort_key_)},
+		did{did_} { }
+
+	std::string serialise() const;
+	static cursor_t unserialise(std::string_view cursor);
+};
+
+
 // MSet is a thin wrapper, as Xapian::MSet keeps enquire->db references; this
 // only keeps a set of Xapian::docid internally (mostly) so it's thread safe
 // across database checkouts.
@@ -69,12 +92,14 @@ class MSet {
 		Xapian::doccount rank;
 		double weight;
 		int percent;
+		std::string sort_key;
 
 		MSetItem(const Xapian::MSetIterator& it) :
 			did{*it},
 			rank{it.get_rank()},
 			weight{it.get_weight()},
-			percent{it.get_percent()} { }
+			percent{it.get_percent()},
+			sort_key{it.get_sort_key()} { }
 
 		MSetItem(Xapian::docid did) :
 			did{did},
@@ -114,6 +139,10 @@ class MSet {
 		auto get_percent() const {
 			return it->percent;
 		}
+
+		const auto& get_sort_key() const {
+			return it->sort_key;
+		}
 	};
 
 	items_t items;
@@ -155,10 +184,26 @@ public:
 		return MSetIterator(items.end());
 	}
 
+	auto back() const {
+		return MSetIterator(std::prev(items.end()));
+	}
+
 	void push_back(Xapian::docid did) {
 		items.push_back(did);
 		++matches_estimated;
 	}
+
+	void push_back(Xapian::docid did, Xapian::doccount rank, double weight, int percent, std::string sort_key) {
+		auto& item = items.emplace_back(did);
+		item.rank = rank;
+		item.weight = weight;
+		item.percent = percent;
+		item.sort_key = std::move(sort_key);
+	}
+
+	void set_matches_estimated(Xapian::doccount matches_estimated_) {
+		matches_estimated = matches_estimated_;
+	}
 };
 
 using DataType = std::pair<Xapian::docid, MsgPack>;
@@ -174,8 +219,14 @@ class DatabaseHandler : protected LockableDatabase {
 	std::shared_ptr<std::unordered_set<std::string>> context;
 
 #if defined(XAPIAND_V8) || defined(XAPIAND_CHAISCRIPT)
-	static std::mutex documents_mtx;
-	static std::unordered_map<std::string, std::shared_ptr<std::pair<std::string, const Data>>> documents;
+	// Document changes seen by scripts, striped by key (database path
+	// and term id) so scripted updates of unrelated documents don't contend.
+	struct DocumentsShard {
+		std::mutex mtx;
+		std::unordered_map<std::string, std::shared_ptr<std::pair<std::string, const Data>>> documents;
+	};
+	static std::array<DocumentsShard, DOCUMENT_CHANGES_SHARDS> documents_shards;
+	static std::pair<DocumentsShard&, std::unique_lock<std::mutex>> lock_documents_shard(const std::string& key);
 
 	template<typename ProcessorCompile>
 	std::unique_ptr<MsgPack> call_script(const MsgPack& object, std::string_view term_id, size_t script_hash, size_t body_hash, std::string_view script_body, std::shared_ptr<std::pair<std::string, const Data>>& old_document_pair);
@@ -188,6 +239,11 @@ class DatabaseHandler : protected LockableDatabase {
 
 	std::unique_ptr<Xapian::ExpandDecider> get_edecider(const similar_field_t& similar);
 
+	std::string get_mset_cache_key(const query_field_t& query_field, const MsgPack* qdsl);
+	std::string get_shards_revision();
+
+	MSet get_shards_mset(const Xapian::Query& query, const std::function<Xapian::Query()>& build_query, Xapian::KeyMaker* sorter, AggregationMatchSpy* aggs, const cursor_t* cursor, unsigned offset, unsigned limit, unsigned check_at_least);
+
 	bool update_schema(std::chrono::time_point<std::chrono::system_clock> schema_begins);
 
 public:
@@ -199,6 +255,8 @@ public:
 
 	void reset(const Endpoints& endpoints_, int flags_=0, enum http_method method_=HTTP_GET, const std::shared_ptr<std::unordered_set<std::string>>& context_=nullptr);
 
+	using LockableDatabase::checkout_time;
+
 #if XAPIAND_DATABASE_WAL
 	MsgPack repr_wal(uint32_t start_revision, uint32_t end_revision, bool unserialised);
 #endif
@@ -210,6 +268,7 @@ public:
 	DataType index(const MsgPack& document_id, bool stored, const MsgPack& body, bool commit, const ct_type_t& ct_type);
 	DataType patch(const MsgPack& document_id, const MsgPack& patches, bool commit, const ct_type_t& ct_type);
 	DataType merge(const MsgPack& document_id, bool stored, const MsgPack& body, bool commit, const ct_type_t& ct_type);
+	std::tuple<std::string, Xapian::Document, MsgPack> prepare_merge(const MsgPack& document_id, bool stored, const MsgPack& body, const ct_type_t& ct_type);
 
 	void write_schema(const MsgPack& obj, bool replace);
 	void delete_schema();
@@ -228,6 +287,9 @@ public:
 	std::tuple<std::string, Xapian::Document, MsgPack> prepare_document(const MsgPack& obj);
 	void restore_documents(const MsgPack& docs);
 
+	using bulk_status_t = std::function<void(std::string_view op, const MsgPack& document_id, Xapian::docid did, const std::exception_ptr& eptr)>;
+	void bulk(const std::function<const MsgPack*()>& next_operation, const ct_type_t& ct_type, const bulk_status_t& status);
+
 	std::string get_prefixed_term_id(const MsgPack& document_id);
 
 	std::vector<std::string> get_metadata_keys();
@@ -240,6 +302,7 @@ public:
 	Document get_document(std::string_view document_id);
 	Document get_document_term(const std::string& term_id);
 	Document get_document_term(std::string_view term_id);
+	std::vector<DocumentData> get_documents_data(const std::vector<Xapian::docid>& dids, bool stored = false, Xapian::valueno slot = Xapian::BAD_VALUENO);
 	Xapian::docid get_docid(std::string_view document_id);
 
 	void delete_document(std::string_view document_id, bool commit = false);
@@ -304,3 +367,30 @@ inline auto& committer(bool create = true) {
 	ASSERT(!create || committer);
 	return committer;
 }
+
+
+inline auto& shard_searcher(bool create = true) {
+	static auto shard_searcher = create && opts.num_shard_searchers ? std::make_unique<ThreadPool<std::function<void()>, ThreadPolicyType::searchers>>("SS%02zu", opts.num_shard_searchers) : nullptr;
+	return shard_searcher;
+}
+
+
+inline auto& bulk_preparer(bool create = true) {
+	static auto bulk_preparer = create && opts.num_bulk_preparers ? std::make_unique<ThreadPool<std::function<void()>, ThreadPolicyType::preparers>>("BP%02zu", opts.num_bulk_preparers) : nullptr;
+	return bulk_preparer;
+}
+
+
+#ifdef XAPIAND_DATA_STORAGE
+void storage_scrub(const std::string& path);
+void storage_scrub_rewind(const std::string& path);
+MsgPack storage_scrub_status(const std::string& path);
+void storage_scrub_stop();
+
+
+inline auto& scrubber(bool create = true) {
+	static auto scrubber = create ? make_unique_debouncer<std::string, 1000, 1000, 3000000, ThreadPolicyType::scrubbers>("SB--", "SB%02zu", opts.num_scrubbers, storage_scrub) : nullptr;
+	ASSERT(!create || scrubber);
+	return scrubber;
+}
+#endif /* XAPIAND_DATA_STORAGE */
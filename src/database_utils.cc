@@ -22,7 +22,7 @@
 
 #include "database_utils.h"
 
-#include <algorithm>                                 // for count, replace
+#include <algorithm>                                 // for count, replace, std::copy
 #include <chrono>                                    // for seconds, duration_cast
 #include <cstdio>                                    // for snprintf, size_t
 #include <cstring>                                   // for strlen
@@ -41,7 +41,9 @@
 #include "rapidjson/error/error.h"                   // for ParseResult
 #include "schema.h"                                  // for FieldType
 #include "serialise.h"                               // for Serialise
+#include "split.h"                                   // for Split
 #include "storage.h"                                 // for STORAGE_BIN_HEADER_MAGIC and STORAGE_BIN_FOOTER_MAGIC
+#include "xchange/rapidjson_sax.hpp"                 // for msgpack::json_parse
 
 
 std::string prefixed(std::string_view term, std::string_view field_prefix, char field_type)
@@ -128,42 +130,92 @@ int read_uuid(std::string_view dir, std::array<unsigned char, 16>& uuid)
 }
 
 
+static void json_parse_error(const rapidjson::ParseResult& parse_done, std::string_view str)
+{
+	constexpr size_t tabsize = 3;
+	std::string tabs(tabsize, ' ');
+	auto offset = parse_done.Offset();
+	char buffer[20];
+	auto a = str.substr(0, offset);
+	auto line = std::count(a.begin(), a.end(), '\n') + 1;
+	if (line > 1) {
+		auto f = a.rfind("\n");
+		if (f != std::string::npos) {
+			a = a.substr(f + 1);
+		}
+	}
+	snprintf(buffer, sizeof(buffer), "%zu. ", line);
+	auto b = str.substr(offset);
+	b = b.substr(0, b.find("\n"));
+	auto tsz = std::count(a.begin(), a.end(), '\t');
+	auto col = a.size() + 1;
+	auto sz = col - 1 - tsz + tsz * tabsize;
+	std::string snippet(buffer);
+	auto indent = sz + snippet.size();
+	snippet.append(a);
+	snippet.append(b);
+	snippet.push_back('\n');
+	snippet.append(indent, ' ');
+	snippet.push_back('^');
+	size_t p = 0;
+	while ((p = snippet.find("\t", p)) != std::string::npos) {
+		snippet.replace(p, 1, tabs);
+		++p;
+	}
+	THROW(ClientError, "JSON parse error at line %zu, col: %zu : %s\n%s", line, col, GetParseError_En(parse_done.Code()), snippet);
+}
+
+
 void json_load(rapidjson::Document& doc, std::string_view str)
 {
 	rapidjson::ParseResult parse_done = doc.Parse<rapidjson::kParseCommentsFlag | rapidjson::kParseTrailingCommasFlag>(str.data(), str.size());
 	if (!parse_done) {
-		constexpr size_t tabsize = 3;
-		std::string tabs(tabsize, ' ');
-		auto offset = parse_done.Offset();
-		char buffer[20];
-		auto a = str.substr(0, offset);
-		auto line = std::count(a.begin(), a.end(), '\n') + 1;
-		if (line > 1) {
-			auto f = a.rfind("\n");
-			if (f != std::string::npos) {
-				a = a.substr(f + 1);
-			}
+		json_parse_error(parse_done, str);
+	}
+}
+
+
+MsgPack json_load(std::string_view str)
+{
+	// Parse straight into a msgpack::zone (no intermediate rapidjson::Document)
+	auto zone = std::make_shared<msgpack::zone>();
+	msgpack::object obj;
+	rapidjson::ParseResult parse_done = msgpack::json_parse(*zone, str, obj);
+	if (!parse_done) {
+		json_parse_error(parse_done, str);
+	}
+	return MsgPack(zone, obj);
+}
+
+
+MsgPack ndjson_load(std::string_view str)
+{
+	// Every line is parsed into the same msgpack::zone, where the array
+	// holding them all is built too (no copies)
+	auto zone = std::make_shared<msgpack::zone>();
+	std::vector<msgpack::object> objs;
+	for (auto line : Split<std::string_view>(str, '\n')) {
+		auto end = line.find_last_not_of(" \t\r");
+		if (end == std::string_view::npos) {
+			continue;
 		}
-		snprintf(buffer, sizeof(buffer), "%zu. ", line);
-		auto b = str.substr(offset);
-		b = b.substr(0, b.find("\n"));
-		auto tsz = std::count(a.begin(), a.end(), '\t');
-		auto col = a.size() + 1;
-		auto sz = col - 1 - tsz + tsz * tabsize;
-		std::string snippet(buffer);
-		auto indent = sz + snippet.size();
-		snippet.append(a);
-		snippet.append(b);
-		snippet.push_back('\n');
-		snippet.append(indent, ' ');
-		snippet.push_back('^');
-		size_t p = 0;
-		while ((p = snippet.find("\t", p)) != std::string::npos) {
-			snippet.replace(p, 1, tabs);
-			++p;
+		line = line.substr(0, end + 1);
+		msgpack::object obj;
+		rapidjson::ParseResult parse_done = msgpack::json_parse(*zone, line, obj);
+		if (!parse_done) {
+			json_parse_error(parse_done, line);
 		}
-		THROW(ClientError, "JSON parse error at line %zu, col: %zu : %s\n%s", line, col, GetParseError_En(parse_done.Code()), snippet);
+		objs.push_back(obj);
+	}
+	msgpack::object obj;
+	obj.type = msgpack::type::ARRAY;
+	obj.via.array.size = objs.size();
+	obj.via.array.ptr = nullptr;
+	if (!objs.empty()) {
+		obj.via.array.ptr = static_cast<msgpack::object*>(zone->allocate_align(sizeof(msgpack::object) * objs.size()));
+		std::copy(objs.begin(), objs.end(), obj.via.array.ptr);
 	}
+	return MsgPack(zone, obj);
 }
 
 
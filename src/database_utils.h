@@ -182,13 +182,17 @@ struct query_field_t {
 	std::string period;
 	std::string selector;
 
+	// Search-after cursor (empty for the first page).
+	bool is_after;
+	std::string after;
+
 	// Only used when the sort type is string.
 	std::string metric;
 	bool icase;
 
 	query_field_t()
 		: offset(0), limit(10), check_at_least(0), as_volatile(false), spelling(true), synonyms(false), commit(false),
-		  unique_doc(false), is_fuzzy(false), is_nearest(false), collapse_max(1), icase(false) { }
+		  unique_doc(false), is_fuzzy(false), is_nearest(false), collapse_max(1), is_after(false), icase(false) { }
 };
 
 
@@ -212,6 +216,8 @@ std::string normalize_uuid(const std::string& uuid);
 MsgPack normalize_uuid(const MsgPack& uuid);
 int read_uuid(std::string_view dir, std::array<unsigned char, 16>& uuid);
 void json_load(rapidjson::Document& doc, std::string_view str);
+MsgPack json_load(std::string_view str);
+MsgPack ndjson_load(std::string_view str);
 rapidjson::Document to_json(std::string_view str);
 std::string msgpack_to_html(const msgpack::object& o);
 std::string msgpack_map_value_to_html(const msgpack::object& o);
@@ -32,6 +32,7 @@
 
 #if XAPIAND_DATABASE_WAL
 
+#include <algorithm>                // for std::find
 #include <array>                    // for std::array
 #include <errno.h>                  // for errno
 #include <fcntl.h>                  // for O_CREAT, O_WRONLY, O_EXCL
@@ -46,7 +47,6 @@
 #include "exception.h"              // for THROW, Error
 #include "error.hh"                 // for error:name, error::description
 #include "fs.hh"                    // for exists
-#include "ignore_unused.h"          // for ignore_unused
 #include "io.hh"                    // for io::*
 #include "log.h"                    // for L_OBJ, L_CALL, L_INFO, L_ERR, L_WARNING
 #include "manager.h"                // for XapiandManager
@@ -71,6 +71,7 @@
 
 #define WAL_STORAGE_PATH "wal."
 #define WAL_SYNC_MODE     STORAGE_ASYNC_SYNC
+#define WAL_WRITE_MODE    (STORAGE_OPEN | STORAGE_WRITABLE | STORAGE_CREATE | STORAGE_DEFERRED_WRITE | WAL_SYNC_MODE)
 
 
 void
@@ -108,6 +109,7 @@ WalHeader::validate(void* param, void* /*unused*/)
 DatabaseWAL::DatabaseWAL(std::string_view base_path_)
 	: Storage<WalHeader, WalBinHeader, WalBinFooter>(base_path_, this),
 	  validate_uuid(false),
+	  _pending_update(false),
 	  _revision(0),
 	  _database(nullptr)
 {
@@ -123,6 +125,7 @@ DatabaseWAL::DatabaseWAL(std::string_view base_path_)
 DatabaseWAL::DatabaseWAL(Database* database_)
 	: Storage<WalHeader, WalBinHeader, WalBinFooter>(database_->endpoints[0].path, this),
 	  validate_uuid(true),
+	  _pending_update(false),
 	  _revision(0),
 	  _database(database_)
 {
@@ -712,7 +715,7 @@ DatabaseWAL::init_database()
 }
 
 
-void
+size_t
 DatabaseWAL::write_line(const UUID& uuid, Xapian::rev revision, Type type, std::string_view data, bool send_update)
 {
 	L_CALL("DatabaseWAL::write_line(%s, %llu, Type::%s, <data>, %s)", ::repr(uuid.to_string()), revision, names[toUType(type)], send_update ? "true" : "false");
@@ -738,7 +741,7 @@ DatabaseWAL::write_line(const UUID& uuid, Xapian::rev revision, Type type, std::
 		if (closed()) {
 			auto volumes = get_volumes_range(WAL_STORAGE_PATH, revision, revision);
 			auto volume = (volumes.first <= volumes.second) ? volumes.second : revision;
-			open(string::format(WAL_STORAGE_PATH "%llu", volume), STORAGE_OPEN | STORAGE_WRITABLE | STORAGE_CREATE | WAL_SYNC_MODE);
+			open(string::format(WAL_STORAGE_PATH "%llu", volume), WAL_WRITE_MODE);
 			if (header.head.revision != volume) {
 				L_DEBUG("Mismatch in WAL revision %llu: %s volume %llu", header.head.revision, ::repr(base_path), volume);
 				THROW(StorageCorruptVolume, "Mismatch in WAL revision");
@@ -754,7 +757,7 @@ DatabaseWAL::write_line(const UUID& uuid, Xapian::rev revision, Type type, std::
 
 		if (slot >= WAL_SLOTS) {
 			// We need a new volume, the old one is full
-			open(string::format(WAL_STORAGE_PATH "%llu", revision), STORAGE_OPEN | STORAGE_WRITABLE | STORAGE_CREATE | WAL_SYNC_MODE);
+			open(string::format(WAL_STORAGE_PATH "%llu", revision), WAL_WRITE_MODE);
 			if (header.head.revision != revision) {
 				L_DEBUG("Mismatch in WAL revision %llu: %s volume %llu", header.head.revision, ::repr(base_path), revision);
 				THROW(StorageCorruptVolume, "Mismatch in WAL revision");
@@ -778,7 +781,7 @@ DatabaseWAL::write_line(const UUID& uuid, Xapian::rev revision, Type type, std::
 			if (slot + 1 < WAL_SLOTS) {
 				header.slot[slot + 1] = header.slot[slot];
 			} else {
-				open(string::format(WAL_STORAGE_PATH "%llu", revision + 1), STORAGE_OPEN | STORAGE_WRITABLE | STORAGE_CREATE | WAL_SYNC_MODE);
+				open(string::format(WAL_STORAGE_PATH "%llu", revision + 1), WAL_WRITE_MODE);
 				if (header.head.revision != revision + 1) {
 					L_DEBUG("Mismatch in WAL revision %llu: %s volume %llu", header.head.revision, ::repr(base_path), revision + 1);
 					THROW(StorageCorruptVolume, "Mismatch in WAL revision");
@@ -786,18 +789,10 @@ DatabaseWAL::write_line(const UUID& uuid, Xapian::rev revision, Type type, std::
 			}
 		}
 
-		commit();
+		// Lines get committed (and fsynced) by flush(), once per group commit.
+		_pending_update = _pending_update || send_update;
 
-#ifdef XAPIAND_CLUSTERING
-		if (!opts.solo) {
-			// On COMMIT, let the updaters do their job
-			if (send_update) {
-				db_updater()->debounce(base_path, base_path);
-			}
-		}
-#else
-	ignore_unused(send_update);
-#endif
+		return line.size();
 
 	} catch (const StorageException& exc) {
 		L_ERR("WAL ERROR in %s: %s", ::repr(base_path), exc.get_message());
@@ -805,6 +800,34 @@ DatabaseWAL::write_line(const UUID& uuid, Xapian::rev revision, Type type, std::
 			.xapiand_wal_errors
 			.Increment();
 	}
+
+	return 0;
+}
+
+
+void
+DatabaseWAL::flush()
+{
+	L_CALL("DatabaseWAL::flush()");
+
+	try {
+		commit();
+	} catch (const StorageException& exc) {
+		L_ERR("WAL ERROR in %s: %s", ::repr(base_path), exc.get_message());
+		Metrics::metrics()
+			.xapiand_wal_errors
+			.Increment();
+	}
+
+#ifdef XAPIAND_CLUSTERING
+	if (!opts.solo) {
+		// On COMMIT, let the updaters do their job
+		if (_pending_update) {
+			db_updater()->debounce(base_path, base_path);
+		}
+	}
+#endif
+	_pending_update = false;
 }
 
 
@@ -881,14 +904,20 @@ DatabaseWAL::get_current_line(uint32_t end_off)
 //
 
 DatabaseWALWriterThread::DatabaseWALWriterThread() noexcept :
-	_wal_writer(nullptr)
+	_wal_writer(nullptr),
+	lru(opts.max_databases),
+	_batch_lines(0),
+	_batch_bytes(0)
 {
 }
 
 
 DatabaseWALWriterThread::DatabaseWALWriterThread(size_t idx, DatabaseWALWriter* wal_writer) noexcept :
 	_wal_writer(wal_writer),
-	_name(string::format(wal_writer->_format, idx))
+	_name(string::format(wal_writer->_format, idx)),
+	lru(opts.max_databases),
+	_batch_lines(0),
+	_batch_bytes(0)
 {
 }
 
@@ -946,19 +975,48 @@ void
 DatabaseWALWriterThread::operator()()
 {
 	_wal_writer->_workers.fetch_add(1, std::memory_order_relaxed);
-	while (!_wal_writer->_finished.load(std::memory_order_acquire)) {
+	std::vector<std::string> done;
+	bool ending = false;
+	while (!ending && !_wal_writer->_finished.load(std::memory_order_acquire)) {
 		DatabaseWALWriterTask task;
 		_queue.wait_dequeue(task);
-		if likely(task) {
-			try {
-				task(*this);
-			} catch (...) {
-				L_EXC("ERROR: Task died with an unhandled exception");
+		// Group commit: keep taking tasks until the batch is big enough or
+		// its latency budget runs out, then commit each touched WAL once.
+		const auto max_delay = std::chrono::milliseconds(opts.wal_group_commit_delay);
+		const auto max_bytes = opts.wal_group_commit_bytes;
+		auto deadline = std::chrono::steady_clock::now() + max_delay;
+		while (true) {
+			if likely(task) {
+				try {
+					task(*this);
+				} catch (...) {
+					L_EXC("ERROR: Task died with an unhandled exception");
+				}
+				done.push_back(std::move(task.path));
+			} else if (_wal_writer->_ending.load(std::memory_order_acquire)) {
+				ending = true;
+				break;
+			} else {
+				break;
+			}
+			if (_batch_bytes >= max_bytes) {
+				break;
+			}
+			auto now = std::chrono::steady_clock::now();
+			if (now < deadline) {
+				if (!_queue.wait_dequeue_timed(task, deadline - now)) {
+					break;
+				}
+			} else if (!_queue.try_dequeue(task)) {
+				break;
 			}
-			dec_producer_token(task.path);
-		} else if (_wal_writer->_ending.load(std::memory_order_acquire)) {
-			break;
 		}
+		flush();
+		// Producer tokens are released only once lines are committed.
+		for (auto& path : done) {
+			dec_producer_token(path);
+		}
+		done.clear();
 	}
 	_wal_writer->_workers.fetch_sub(1, std::memory_order_relaxed);
 }
@@ -977,12 +1035,56 @@ DatabaseWALWriterThread::wal(const std::string& path)
 {
 	auto it = lru.find(path);
 	if (it == lru.end()) {
-		it = lru.emplace(path, std::make_unique<DatabaseWAL>(path)).first;
+		// WALs dropped while in a batch get flushed first, so their pending
+		// update isn't lost (a later flush() would only reopen them).
+		it = lru.emplace_and([](const std::unique_ptr<DatabaseWAL>& dropped, ssize_t size, ssize_t max_size) {
+			if (size > max_size) {
+				dropped->flush();
+				return lru::DropAction::evict;
+			}
+			return lru::DropAction::stop;
+		}, path, std::make_unique<DatabaseWAL>(path)).first;
 	}
 	return *it->second;
 }
 
 
+void
+DatabaseWALWriterThread::write_line(const std::string& path, const UUID& uuid, Xapian::rev revision, DatabaseWAL::Type type, std::string_view data, bool send_update)
+{
+	if (_batch_paths.empty()) {
+		_batch_start = std::chrono::steady_clock::now();
+	}
+	if (std::find(_batch_paths.begin(), _batch_paths.end(), path) == _batch_paths.end()) {
+		_batch_paths.push_back(path);
+	}
+	_batch_bytes += wal(path).write_line(uuid, revision, type, data, send_update);
+	++_batch_lines;
+}
+
+
+void
+DatabaseWALWriterThread::flush()
+{
+	if (_batch_paths.empty()) {
+		return;
+	}
+
+	for (auto& path : _batch_paths) {
+		wal(path).flush();
+	}
+
+	auto& metrics = Metrics::metrics();
+	metrics.xapiand_wal_batch_lines.Observe(_batch_lines);
+	metrics.xapiand_wal_batch_bytes.Observe(_batch_bytes);
+	metrics.xapiand_wal_batch_latency.Observe(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - _batch_start).count() / 1e9);
+
+	_batch_paths.clear();
+	_batch_lines = 0;
+	_batch_bytes = 0;
+}
+
+
 DatabaseWALWriter::DatabaseWALWriter(const char* format, std::size_t num_threads) :
 	_threads(num_threads),
 	_format(format),
@@ -1003,6 +1105,7 @@ DatabaseWALWriter::execute(DatabaseWALWriterTask&& task)
 	static thread_local DatabaseWALWriterThread thread(0, this);
 	inc_producer_token(task.path);
 	task(thread);
+	thread.flush();
 }
 
 
@@ -1104,8 +1207,7 @@ DatabaseWALWriterTask::write_add_document(DatabaseWALWriterThread& thread)
 	auto line = doc.serialise();
 	L_DATABASE("write_add_document {path:%s, rev:%llu}: %s", repr(path), revision, repr(line));
 
-	auto& wal = thread.wal(path);
-	wal.write_line(uuid, revision, DatabaseWAL::Type::ADD_DOCUMENT, line, false);
+	thread.write_line(path, uuid, revision, DatabaseWAL::Type::ADD_DOCUMENT, line, false);
 
 	L_DATABASE_NOW(end);
 	L_DATABASE("Database WAL writer of %s succeeded after %s", repr(path), string::from_delta(start, end));
@@ -1120,8 +1222,7 @@ DatabaseWALWriterTask::write_delete_document_term(DatabaseWALWriterThread& threa
 	auto line = serialise_string(term_word_val);  // term
 	L_DATABASE("write_delete_document_term {path:%s, rev:%llu}: %s", repr(path), revision, repr(line));
 
-	auto& wal = thread.wal(path);
-	wal.write_line(uuid, revision, DatabaseWAL::Type::DELETE_DOCUMENT_TERM, line, false);
+	thread.write_line(path, uuid, revision, DatabaseWAL::Type::DELETE_DOCUMENT_TERM, line, false);
 
 	L_DATABASE_NOW(end);
 	L_DATABASE("Database WAL writer of %s succeeded after %s", repr(path), string::from_delta(start, end));
@@ -1137,8 +1238,7 @@ DatabaseWALWriterTask::write_remove_spelling(DatabaseWALWriterThread& thread)
 	line.append(term_word_val);  // word
 	L_DATABASE("write_remove_spelling {path:%s, rev:%llu}: %s", repr(path), revision, repr(line));
 
-	auto& wal = thread.wal(path);
-	wal.write_line(uuid, revision, DatabaseWAL::Type::REMOVE_SPELLING, line, false);
+	thread.write_line(path, uuid, revision, DatabaseWAL::Type::REMOVE_SPELLING, line, false);
 
 	L_DATABASE_NOW(end);
 	L_DATABASE("Database WAL writer of %s succeeded after %s", repr(path), string::from_delta(start, end));
@@ -1152,8 +1252,7 @@ DatabaseWALWriterTask::write_commit(DatabaseWALWriterThread& thread)
 
 	L_DATABASE("write_commit {path:%s, rev:%llu}", repr(path), revision);
 
-	auto& wal = thread.wal(path);
-	wal.write_line(uuid, revision, DatabaseWAL::Type::COMMIT, "", send_update);
+	thread.write_line(path, uuid, revision, DatabaseWAL::Type::COMMIT, "", send_update);
 
 	L_DATABASE_NOW(end);
 	L_DATABASE("Database WAL writer of %s succeeded after %s", repr(path), string::from_delta(start, end));
@@ -1169,8 +1268,7 @@ DatabaseWALWriterTask::write_replace_document(DatabaseWALWriterThread& thread)
 	line.append(doc.serialise());
 	L_DATABASE("write_replace_document {path:%s, rev:%llu}: %s", repr(path), revision, repr(line));
 
-	auto& wal = thread.wal(path);
-	wal.write_line(uuid, revision, DatabaseWAL::Type::REPLACE_DOCUMENT, line, false);
+	thread.write_line(path, uuid, revision, DatabaseWAL::Type::REPLACE_DOCUMENT, line, false);
 
 	L_DATABASE_NOW(end);
 	L_DATABASE("Database WAL writer of %s succeeded after %s", repr(path), string::from_delta(start, end));
@@ -1186,8 +1284,7 @@ DatabaseWALWriterTask::write_replace_document_term(DatabaseWALWriterThread& thre
 	line.append(doc.serialise());
 	L_DATABASE("write_replace_document_term {path:%s, rev:%llu}: %s", repr(path), revision, repr(line));
 
-	auto& wal = thread.wal(path);
-	wal.write_line(uuid, revision, DatabaseWAL::Type::REPLACE_DOCUMENT_TERM, line, false);
+	thread.write_line(path, uuid, revision, DatabaseWAL::Type::REPLACE_DOCUMENT_TERM, line, false);
 
 	L_DATABASE_NOW(end);
 	L_DATABASE("Database WAL writer of %s succeeded after %s", repr(path), string::from_delta(start, end));
@@ -1202,8 +1299,7 @@ DatabaseWALWriterTask::write_delete_document(DatabaseWALWriterThread& thread)
 	auto line = serialise_length(did);
 	L_DATABASE("write_delete_document {path:%s, rev:%llu}: %s", repr(path), revision, repr(line));
 
-	auto& wal = thread.wal(path);
-	wal.write_line(uuid, revision, DatabaseWAL::Type::DELETE_DOCUMENT, line, false);
+	thread.write_line(path, uuid, revision, DatabaseWAL::Type::DELETE_DOCUMENT, line, false);
 
 	L_DATABASE_NOW(end);
 	L_DATABASE("Database WAL writer of %s succeeded after %s", repr(path), string::from_delta(start, end));
@@ -1219,8 +1315,7 @@ DatabaseWALWriterTask::write_set_metadata(DatabaseWALWriterThread& thread)
 	line.append(term_word_val);  // val
 	L_DATABASE("write_set_metadata {path:%s, rev:%llu}: %s", repr(path), revision, repr(line));
 
-	auto& wal = thread.wal(path);
-	wal.write_line(uuid, revision, DatabaseWAL::Type::SET_METADATA, line, false);
+	thread.write_line(path, uuid, revision, DatabaseWAL::Type::SET_METADATA, line, false);
 
 	L_DATABASE_NOW(end);
 	L_DATABASE("Database WAL writer of %s succeeded after %s", repr(path), string::from_delta(start, end));
@@ -1236,8 +1331,7 @@ DatabaseWALWriterTask::write_add_spelling(DatabaseWALWriterThread& thread)
 	line.append(term_word_val);  // word
 	L_DATABASE("write_add_spelling {path:%s, rev:%llu}: %s", repr(path), revision, repr(line));
 
-	auto& wal = thread.wal(path);
-	wal.write_line(uuid, revision, DatabaseWAL::Type::ADD_SPELLING, line, false);
+	thread.write_line(path, uuid, revision, DatabaseWAL::Type::ADD_SPELLING, line, false);
 
 	L_DATABASE_NOW(end);
 	L_DATABASE("Database WAL writer of %s succeeded after %s", repr(path), string::from_delta(start, end));
@@ -33,6 +33,7 @@
 #include <sys/types.h>                      // for uint32_t, uint8_t, ssize_t
 #include <unordered_map>                    // for std::unordered_map
 #include <utility>                          // for pair, make_pair
+#include <vector>                           // for std::vector
 #include <xapian.h>                         // for Xapian::docid, Xapian::termcount, Xapian::Document
 
 #include "cassert.h"                        // for ASSERT
@@ -129,6 +130,7 @@ class DatabaseWAL : Storage<WalHeader, WalBinHeader, WalBinFooter> {
 	};
 
 	bool validate_uuid;
+	bool _pending_update;
 
 	MsgPack repr_document(std::string_view document, bool unserialised);
 	MsgPack repr_metadata(std::string_view document, bool unserialised);
@@ -174,7 +176,8 @@ public:
 	bool init_database();
 	bool execute(bool only_committed, bool unsafe = false);
 	bool execute_line(std::string_view line, bool wal_, bool send_update, bool unsafe);
-	void write_line(const UUID& uuid, Xapian::rev revision, Type type, std::string_view data, bool send_update);
+	size_t write_line(const UUID& uuid, Xapian::rev revision, Type type, std::string_view data, bool send_update);
+	void flush();
 
 	MsgPack repr(Xapian::rev start_revision, Xapian::rev end_revision, bool unserialised);
 
@@ -313,6 +316,12 @@ class DatabaseWALWriterThread : public Thread<DatabaseWALWriterThread, ThreadPol
 
 	lru::LRU<std::string, std::unique_ptr<DatabaseWAL>> lru;
 
+	// Group commit: WALs written since the last flush.
+	std::vector<std::string> _batch_paths;
+	std::chrono::steady_clock::time_point _batch_start;
+	size_t _batch_lines;
+	size_t _batch_bytes;
+
 	std::mutex producers_mtx;
 	std::unordered_map<std::string, std::pair<ProducerToken, size_t>> producers;
 
@@ -327,6 +336,8 @@ public:
 	void operator()();
 	void clear();
 	DatabaseWAL& wal(const std::string& path);
+	void write_line(const std::string& path, const UUID& uuid, Xapian::rev revision, DatabaseWAL::Type type, std::string_view data, bool send_update);
+	void flush();
 
 	const std::string& name() const noexcept;
 };
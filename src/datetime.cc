@@ -29,6 +29,7 @@
 #include "string_view.hh"        // for std::string_view
 
 #include "cassert.h"             // for ASSERT
+#include "datetime_match.hh"     // for Datetime::DateMatch, Datetime::date_math_match
 #include "hashes.hh"             // for fnv1ah32
 #include "log.h"                 // for L_ERR
 #include "msgpack.h"             // for MsgPack
@@ -44,10 +45,6 @@ constexpr const char RESERVED_DAY[]                 = "_day";
 constexpr const char RESERVED_TIME[]                = "_time";
 
 
-const std::regex Datetime::date_re(R"(([0-9]{4})([-/ ]?)(0[1-9]|1[0-2])\2(0[0-9]|[12][0-9]|3[01])([T ]?([01]?[0-9]|2[0-3]):([0-5][0-9])(:([0-5][0-9])([.,]([0-9]+))?)?([ ]*[+-]([01]?[0-9]|2[0-3]):([0-5][0-9])|Z)?)?([ ]*\|\|[ ]*([+-/\dyMwdhms]+))?)", std::regex::optimize);
-const std::regex Datetime::date_math_re("([+-]\\d+|\\/{1,2})([dyMwhms])", std::regex::optimize);
-
-
 static constexpr int days[2][12] = {
 	{ 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 },
 	{ 31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 }
@@ -233,7 +230,7 @@ error_out_of_range:
 Datetime::tm_t
 Datetime::DateParser(std::string_view date)
 {
-	std::cmatch m;
+	DateMatch m;
 	tm_t tm;
 	// Check if date is ISO 8601.
 	auto pos = date.find("||");
@@ -265,7 +262,7 @@ Datetime::DateParser(std::string_view date)
 	}
 
 	int errno_save;
-	if (std::regex_match(date.begin(), date.end(), m, date_re) && static_cast<std::size_t>(m.length(0)) == date.size()) {
+	if (m.match(date)) {
 		tm.year = strict_stoi(&errno_save, m.str(1));
 		if (errno_save != 0) { goto error; }
 		tm.mon = strict_stoi(&errno_save, m.str(3));
@@ -294,8 +291,8 @@ Datetime::DateParser(std::string_view date)
 				if (m.length(10) == 0) {
 					tm.fsec = 0.0;
 				} else {
-					auto fs = m.str(11);
-					fs.insert(0, 1, '.');
+					std::string fs(".");
+					fs.append(m.str(11).data(), m.length(11));
 					auto fsec = strict_stod(&errno_save, fs);
 					if (errno_save != 0) { goto error; }
 					tm.fsec = normalize_fsec(fsec);
@@ -739,15 +736,9 @@ Datetime::Iso8601Parser(std::string_view date)
 void
 Datetime::processDateMath(std::string_view date_math, tm_t& tm)
 {
-	size_t size_match = 0;
-
-	std::cregex_iterator next(date_math.begin(), date_math.end(), date_math_re, std::regex_constants::match_continuous);
-	std::cregex_iterator end;
-	while (next != end) {
-		size_match += next->length(0);
-		computeDateMath(tm, next->str(1), next->str(2)[0]);
-		++next;
-	}
+	auto size_match = date_math_match(date_math, [&](std::string_view op, char unit) {
+		computeDateMath(tm, op, unit);
+	});
 
 	if (date_math.size() != size_match) {
 		THROW(DatetimeError, "Date Math (%s) is used incorrectly", date_math);
@@ -1238,8 +1229,8 @@ Datetime::isDate(std::string_view date)
 		case Format::VALID:
 			return true;
 		case Format::INVALID: {
-			std::cmatch m;
-			return std::regex_match(date.begin(), date.end(), m, date_re) && static_cast<std::size_t>(m.length(0)) == date.size();
+			DateMatch m;
+			return m.match(date);
 		}
 		default:
 			return false;
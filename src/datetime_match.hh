@@ -0,0 +1,323 @@
+/*
+ * Copyright (C) 2019 Dubalu LLC. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#pragma once
+
+#include <array>              // for std::array
+#include <cstdint>            // for uint32_t
+#include <cstring>            // for std::memcpy
+#include "string_view.hh"     // for std::string_view
+
+
+namespace Datetime {
+
+/*
+ * Hand-written matcher with the same semantics as std::regex_match() using
+ * Datetime::date_re:
+ *
+ *   ([0-9]{4})([-/ ]?)(0[1-9]|1[0-2])\2(0[0-9]|[12][0-9]|3[01])
+ *   ([T ]?([01]?[0-9]|2[0-3]):([0-5][0-9])(:([0-5][0-9])([.,]([0-9]+))?)?
+ *   ([ ]*[+-]([01]?[0-9]|2[0-3]):([0-5][0-9])|Z)?)?
+ *   ([ ]*\|\|[ ]*([+-/\dyMwdhms]+))?
+ *
+ * Groups are numbered as in the regular expression. None of the optional
+ * groups can be followed by a character it could have consumed, so there's
+ * never a need to backtrack and the string is matched in a single pass.
+ */
+class DateMatch {
+	struct Group {
+		size_t pos;
+		size_t len;
+		bool matched;
+	};
+
+	std::array<Group, 17> _groups;
+	std::string_view _subject;
+
+	static bool is_digit(char c) noexcept {
+		return c >= '0' && c <= '9';
+	}
+
+	// Four ASCII digits, checked all at once in a 32 bit word.
+	static bool is_digit4(const char* p) noexcept {
+		uint32_t w;
+		std::memcpy(&w, p, sizeof(w));
+		return (w & 0xf0f0f0f0) == 0x30303030 && ((w + 0x06060606) & 0xf0f0f0f0) == 0x30303030;
+	}
+
+	// ([01]?[0-9]|2[0-3]) followed by ':'
+	static size_t match_hour(std::string_view s, size_t i) noexcept {
+		auto n = s.size();
+		if (i + 1 < n && is_digit(s[i]) && s[i + 1] == ':') {
+			return 1;
+		}
+		if (i + 2 < n && s[i + 2] == ':' && (
+			((s[i] == '0' || s[i] == '1') && is_digit(s[i + 1])) ||
+			(s[i] == '2' && s[i + 1] >= '0' && s[i + 1] <= '3'))) {
+			return 2;
+		}
+		return 0;
+	}
+
+	// ([0-5][0-9])
+	static bool match_sixty(std::string_view s, size_t i) noexcept {
+		return i + 1 < s.size() && s[i] >= '0' && s[i] <= '5' && is_digit(s[i + 1]);
+	}
+
+	// [+-/\dyMwdhms] (in a class, +-/ is the range from '+' to '/')
+	static bool is_date_math(char c) noexcept {
+		switch (c) {
+			case '+': case ',': case '-': case '.': case '/':
+			case '0': case '1': case '2': case '3': case '4':
+			case '5': case '6': case '7': case '8': case '9':
+			case 'y': case 'M': case 'w': case 'd': case 'h': case 'm': case 's':
+				return true;
+			default:
+				return false;
+		}
+	}
+
+	void set(size_t group, size_t pos, size_t len) noexcept {
+		_groups[group] = { pos, len, true };
+	}
+
+	void unset(size_t first, size_t last) noexcept {
+		for (auto group = first; group <= last; ++group) {
+			_groups[group] = { 0, 0, false };
+		}
+	}
+
+	// ([T ]?(hour):([0-5][0-9])(:([0-5][0-9])([.,]([0-9]+))?)?(timezone)?)
+	size_t match_time(size_t i) noexcept {
+		auto s = _subject;
+		auto n = s.size();
+		auto start = i;
+		if (i < n && (s[i] == 'T' || s[i] == ' ')) {
+			++i;
+		}
+		auto hour = match_hour(s, i);
+		if (!hour) {
+			return start;
+		}
+		set(6, i, hour);
+		i += hour + 1;
+		if (!match_sixty(s, i)) {
+			return start;
+		}
+		set(7, i, 2);
+		i += 2;
+
+		// Seconds and fraction of a second.
+		if (i < n && s[i] == ':' && match_sixty(s, i + 1)) {
+			set(8, i, 3);
+			set(9, i + 1, 2);
+			i += 3;
+			if (i + 1 < n && (s[i] == '.' || s[i] == ',') && is_digit(s[i + 1])) {
+				auto j = i + 1;
+				while (j < n && is_digit(s[j])) {
+					++j;
+				}
+				set(10, i, j - i);
+				set(11, i + 1, j - i - 1);
+				_groups[8].len += j - i;
+				i = j;
+			}
+		}
+
+		// Timezone.
+		auto j = i;
+		while (j < n && s[j] == ' ') {
+			++j;
+		}
+		if (j < n && (s[j] == '+' || s[j] == '-')) {
+			auto tz_hour = match_hour(s, j + 1);
+			if (tz_hour && match_sixty(s, j + 1 + tz_hour + 1)) {
+				set(13, j + 1, tz_hour);
+				set(14, j + 1 + tz_hour + 1, 2);
+				j += 1 + tz_hour + 1 + 2;
+				set(12, i, j - i);
+				i = j;
+			}
+		} else if (i < n && s[i] == 'Z') {
+			set(12, i, 1);
+			++i;
+		}
+
+		set(5, start, i - start);
+		return i;
+	}
+
+	// ([ ]*\|\|[ ]*([+-/\dyMwdhms]+))
+	size_t match_date_math(size_t i) noexcept {
+		auto s = _subject;
+		auto n = s.size();
+		auto j = i;
+		while (j < n && s[j] == ' ') {
+			++j;
+		}
+		if (j + 1 >= n || s[j] != '|' || s[j + 1] != '|') {
+			return i;
+		}
+		j += 2;
+		while (j < n && s[j] == ' ') {
+			++j;
+		}
+		auto math = j;
+		while (j < n && is_date_math(s[j])) {
+			++j;
+		}
+		if (j == math) {
+			return i;
+		}
+		set(16, math, j - math);
+		set(15, i, j - i);
+		return j;
+	}
+
+public:
+	DateMatch() noexcept {
+		unset(0, 16);
+	}
+
+	bool match(std::string_view subject) noexcept {
+		unset(0, 16);
+		_subject = subject;
+
+		auto s = subject;
+		auto n = s.size();
+		if (n < 8 || !is_digit4(s.data())) {
+			return false;
+		}
+		set(1, 0, 4);
+
+		size_t i = 4;
+		char sep = s[i];
+		if (sep == '-' || sep == '/' || sep == ' ') {
+			set(2, i, 1);
+			++i;
+		} else {
+			set(2, i, 0);
+		}
+
+		// Month, (0[1-9]|1[0-2])
+		if (i + 1 >= n || !(
+			(s[i] == '0' && s[i + 1] >= '1' && s[i + 1] <= '9') ||
+			(s[i] == '1' && s[i + 1] >= '0' && s[i + 1] <= '2'))) {
+			return false;
+		}
+		set(3, i, 2);
+		i += 2;
+
+		if (_groups[2].len != 0) {
+			if (i >= n || s[i] != sep) {
+				return false;
+			}
+			++i;
+		}
+
+		// Day, (0[0-9]|[12][0-9]|3[01])
+		if (i + 1 >= n || !(
+			((s[i] >= '0' && s[i] <= '2') && is_digit(s[i + 1])) ||
+			(s[i] == '3' && (s[i + 1] == '0' || s[i + 1] == '1')))) {
+			return false;
+		}
+		set(4, i, 2);
+		i += 2;
+
+		auto t = match_time(i);
+		if (t == i) {
+			unset(5, 14);
+		}
+		i = match_date_math(t);
+
+		if (i != n) {
+			return false;
+		}
+		set(0, 0, n);
+		return true;
+	}
+
+	bool matched(size_t group) const noexcept {
+		return _groups[group].matched;
+	}
+
+	size_t position(size_t group) const noexcept {
+		return _groups[group].pos;
+	}
+
+	size_t length(size_t group) const noexcept {
+		return _groups[group].len;
+	}
+
+	std::string_view str(size_t group) const noexcept {
+		const auto& g = _groups[group];
+		return g.matched ? _subject.substr(g.pos, g.len) : std::string_view();
+	}
+};
+
+
+/*
+ * Hand-written equivalent of iterating Datetime::date_math_re,
+ * ([+-]\d+|\/{1,2})([dyMwhms]), with std::regex_constants::match_continuous.
+ * Calls fn(op, unit) for every token and returns the number of characters
+ * consumed, which is less than date_math.size() if the rest didn't match.
+ */
+template <typename F>
+inline size_t
+date_math_match(std::string_view date_math, F&& fn)
+{
+	auto n = date_math.size();
+	size_t i = 0;
+	while (i < n) {
+		auto start = i;
+		auto c = date_math[i++];
+		if (c == '+' || c == '-') {
+			while (i < n && date_math[i] >= '0' && date_math[i] <= '9') {
+				++i;
+			}
+			if (i == start + 1) {
+				return start;
+			}
+		} else if (c == '/') {
+			if (i < n && date_math[i] == '/') {
+				++i;
+			}
+		} else {
+			return start;
+		}
+		if (i == n) {
+			return start;
+		}
+		switch (date_math[i]) {
+			case 'd': case 'y': case 'M': case 'w': case 'h': case 'm': case 's':
+				fn(date_math.substr(start, i - start), date_math[i]);
+				++i;
+				break;
+			default:
+				return start;
+		}
+	}
+	return i;
+}
+
+}  // namespace Datetime
@@ -22,7 +22,13 @@
 
 #include "io.hh"
 
+#include <algorithm>                // for std::min
 #include <errno.h>                  // for errno
+#if defined(HAVE_SENDFILE) && defined(HAVE_SYS_SENDFILE_H)
+#include <sys/sendfile.h>           // for sendfile
+#elif defined(HAVE_SENDFILE) && defined(__APPLE__)
+#include <sys/uio.h>                // for sendfile
+#endif
 
 #include "cassert.h"                // for ASSERT
 #include "error.hh"                 // for error:name, error::description
@@ -250,6 +256,53 @@ ssize_t pread(int fd, void* buf, size_t nbyte, off_t offset) {
 }
 
 
+ssize_t sendfile(int out_fd, int in_fd, off_t offset, size_t nbyte) {
+	L_CALL("io::sendfile(%d, %d, %lu, %lu)", out_fd, in_fd, offset, nbyte);
+	CHECK_OPENED_SOCKET("during sendfile()", out_fd);
+	CHECK_OPENED("during sendfile()", in_fd);
+
+	RANDOM_ERRORS_NET_ERRNO_RETURN(ECONNABORTED, out_fd);
+
+	// Unlike write(), sendfile() returns after a single (possibly partial)
+	// transfer, the same as send() does for non-blocking sockets.
+#if defined(HAVE_SENDFILE) && defined(HAVE_SYS_SENDFILE_H)
+	ssize_t c = RetryAfterSignal(::sendfile, out_fd, in_fd, &offset, nbyte);
+	if unlikely(c == -1) {
+		L_ERRNO("io::sendfile(): %s (%d): %s", error::name(errno), errno, error::description(errno));
+	}
+	return c;
+#elif defined(HAVE_SENDFILE) && defined(__APPLE__)
+	while (true) {
+		off_t len = nbyte;
+		if (::sendfile(in_fd, out_fd, offset, &len, nullptr, 0) == -1) {
+			// Partial transfers are reported as errors with len set
+			if (len != 0) {
+				return len;
+			}
+			L_ERRNO("io::sendfile(): %s (%d): %s", error::name(errno), errno, error::description(errno));
+			if unlikely(errno == EINTR && ignore_eintr().load()) {
+				continue;
+			}
+			return -1;
+		}
+		return len;
+	}
+#else
+	// Fallback: read a chunk into user space and send it
+	char buf[65536];
+	ssize_t r = io::pread(in_fd, buf, std::min(nbyte, sizeof(buf)), offset);
+	if (r <= 0) {
+		return r;
+	}
+#ifdef MSG_NOSIGNAL
+	return io::send(out_fd, buf, r, MSG_NOSIGNAL);
+#else
+	return RetryAfterSignal(::write, out_fd, buf, r);
+#endif
+#endif
+}
+
+
 #ifndef HAVE_FALLOCATE
 int fallocate(int fd, int /* mode */, off_t offset, off_t len) {
 	CHECK_OPENED("during fallocate()", fd);
@@ -30,7 +30,9 @@
 #include <stddef.h>              // for size_t
 #include <stdlib.h>              // for mkdtemp
 #include <sys/stat.h>            // for fstat
-#include <sys/socket.h>          // for send
+#include <sys/mman.h>            // for mmap, munmap
+#include <sys/socket.h>          // for send, sendmsg
+#include <sys/uio.h>             // for writev, struct iovec
 #include <unistd.h>              // for off_t, ssize_t, close, lseek, unlink
 #include <type_traits>           // for std::forward
 
@@ -163,6 +165,8 @@ ssize_t pwrite(int fd, const void* buf, size_t nbyte, off_t offset);
 ssize_t read(int fd, void* buf, size_t nbyte);
 ssize_t pread(int fd, void* buf, size_t nbyte, off_t offset);
 
+ssize_t sendfile(int out_fd, int in_fd, off_t offset, size_t nbyte);
+
 
 inline int mkstemp(char* template_) {
 	RANDOM_ERRORS_IO_ERRNO_RETURN(EIO);
@@ -218,6 +222,15 @@ inline int fstat(int fd, struct stat* buf) {
 }
 
 
+inline int ftruncate(int fd, off_t length) {
+	CHECK_OPENED("during ftruncate()", fd);
+
+	RANDOM_ERRORS_IO_ERRNO_RETURN(EIO);
+
+	return RetryAfterSignal(::ftruncate, fd, length);
+}
+
+
 inline int dup(int fd) {
 	CHECK_OPENED("during dup()", fd);
 
@@ -254,6 +267,24 @@ inline ssize_t send(int socket, const void* buffer, size_t length, int flags) {
 }
 
 
+inline ssize_t sendmsg(int socket, const struct msghdr* message, int flags) {
+	CHECK_OPENED_SOCKET("during sendmsg()", socket);
+
+	RANDOM_ERRORS_NET_ERRNO_RETURN(ECONNABORTED, socket);
+
+	return RetryAfterSignal(::sendmsg, socket, message, flags);
+}
+
+
+inline ssize_t writev(int fd, const struct iovec* iov, int iovcnt) {
+	CHECK_OPENED("during writev()", fd);
+
+	RANDOM_ERRORS_IO_ERRNO_RETURN(EIO);
+
+	return RetryAfterSignal(::writev, fd, iov, iovcnt);
+}
+
+
 inline ssize_t sendto(int socket, const void* buffer, size_t length, int flags, const struct sockaddr* dest_addr, socklen_t dest_len) {
 	CHECK_OPENED_SOCKET("during sendto()", socket);
 
@@ -421,6 +452,18 @@ inline int fadvise(int fd, off_t, off_t, int) {
 }
 #endif
 
+
+inline void* mmap(void* addr, size_t len, int prot, int flags, int fd, off_t offset) {
+	CHECK_OPENED("during mmap()", fd);
+
+	return ::mmap(addr, len, prot, flags, fd, offset);
+}
+
+
+inline int munmap(void* addr, size_t len) {
+	return ::munmap(addr, len);
+}
+
 } /* namespace io */
 
 #pragma GCC diagnostic pop
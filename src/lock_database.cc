@@ -29,6 +29,7 @@
 
 LockableDatabase::LockableDatabase() :
 	_database_locks(0),
+	_checkout_time(0),
 	flags(DB_OPEN)
 {
 }
@@ -36,6 +37,7 @@ LockableDatabase::LockableDatabase() :
 
 LockableDatabase::LockableDatabase(const Endpoints& endpoints_, int flags_) :
 	_database_locks(0),
+	_checkout_time(0),
 	flags(flags_),
 	endpoints(endpoints_)
 {
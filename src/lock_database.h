@@ -22,6 +22,7 @@
 
 #pragma once
 
+#include <chrono>               // for std::chrono
 #include <xapian.h>             // for Xapian::Database
 
 #include "cassert.h"            // for ASSERT
@@ -58,6 +59,8 @@ class LockableDatabase {
 	std::shared_ptr<Database> _locked_database;
 	int _database_locks;
 
+	std::chrono::nanoseconds _checkout_time;  // time spent waiting for checkouts
+
 protected:
 	int flags;
 	Endpoints endpoints;
@@ -68,6 +71,10 @@ protected:
 public:
 	LockableDatabase();
 	LockableDatabase(const Endpoints& endpoints_, int flags_);
+
+	std::chrono::nanoseconds checkout_time() const noexcept {
+		return _checkout_time;
+	}
 };
 
 
@@ -81,7 +88,9 @@ lock_database::lock(Args&&... args)
 		}
 		if (!lockable->_locked_database) {
 			ASSERT(locks == 0 && lockable->_database_locks == 0);
+			auto checkout_begins = std::chrono::system_clock::now();
 			lockable->_locked_database = XapiandManager::database_pool()->checkout(lockable->endpoints, lockable->flags, std::forward<Args>(args)...);
+			lockable->_checkout_time += std::chrono::system_clock::now() - checkout_begins;
 		}
 		if (locks++ == 0) {
 			++lockable->_database_locks;
@@ -23,6 +23,7 @@
 #include "manager.h"
 
 #include <algorithm>                             // for std::min, std::find_if
+#include <atomic>                                // for std::atomic_size_t
 #include <arpa/inet.h>                           // for inet_aton
 #include <cctype>                                // for isspace
 #include <chrono>                                // for std::chrono, std::chrono::system_clock
@@ -63,7 +64,7 @@
 #include "error.hh"                              // for error:name, error::description
 #include "ev/ev++.h"                             // for ev::async, ev::loop_ref
 #include "exception.h"                           // for SystemExit, Excep...
-#include "hashes.hh"                             // for jump_consistent_hash
+#include "hashes.hh"                             // for jump_consistent_hash, fnv1ah32
 #include "ignore_unused.h"                       // for ignore_unused
 #include "io.hh"                                 // for io::*
 #include "length.h"                              // for serialise_length
@@ -76,12 +77,15 @@
 #include "net.hh"                                // for inet_ntop
 #include "opts.h"                                // for opts::*
 #include "package.h"                             // for Package
+#include "query_cache.h"                         // for query_cache
+#include "random.hh"                             // for random_int
 #include "readable_revents.hh"                   // for readable_revents
 #include "schemas_lru.h"                         // for SchemasLRU
 #include "serialise.h"                           // for KEYWORD_STR
 #include "server/http.h"                         // for Http
 #include "server/http_client.h"                  // for HttpClient
 #include "server/http_server.h"                  // for HttpServer
+#include "sort_keys_cache.h"                     // for sort_keys_cache
 #include "storage.h"                             // for Storage
 #include "system.hh"                             // for get_open_files_per_proc, get_max_files_per_proc
 
@@ -840,6 +844,11 @@ XapiandManager::make_servers()
 #endif
 		std::to_string(opts.num_committers) + ((opts.num_committers == 1) ? " autocommitter" : " autocommitters"),
 		std::to_string(opts.num_fsynchers) + ((opts.num_fsynchers == 1) ? " fsyncher" : " fsynchers"),
+		opts.num_shard_searchers ? std::to_string(opts.num_shard_searchers) + ((opts.num_shard_searchers == 1) ? " shard searcher" : " shard searchers") : "",
+		opts.num_bulk_preparers ? std::to_string(opts.num_bulk_preparers) + ((opts.num_bulk_preparers == 1) ? " bulk preparer" : " bulk preparers") : "",
+#ifdef XAPIAND_DATA_STORAGE
+		opts.num_scrubbers ? std::to_string(opts.num_scrubbers) + ((opts.num_scrubbers == 1) ? " scrubber" : " scrubbers") : "",
+#endif
 	});
 	L_NOTICE("Started " + string::join(values, ", ", " and ", [](const auto& s) { return s.empty(); }));
 }
@@ -1043,6 +1052,38 @@ XapiandManager::join()
 
 #endif
 
+	////////////////////////////////////////////////////////////////////
+	auto& bulk_preparer_obj = bulk_preparer(false);
+	if (bulk_preparer_obj) {
+		L_MANAGER("Finishing bulk preparers pool!");
+		bulk_preparer_obj->finish();
+
+		L_MANAGER("Waiting for %zu bulk preparer%s...", bulk_preparer_obj->running_size(), (bulk_preparer_obj->running_size() == 1) ? "" : "s");
+		L_MANAGER_TIMED(1s, "Is taking too long to finish the bulk preparers...", "Bulk preparers finished!");
+		while (!bulk_preparer_obj->join(500ms)) {
+			int sig = atom_sig;
+			if (sig < 0) {
+				throw SystemExit(-sig);
+			}
+		}
+	}
+
+	////////////////////////////////////////////////////////////////////
+	auto& shard_searcher_obj = shard_searcher(false);
+	if (shard_searcher_obj) {
+		L_MANAGER("Finishing shard searchers pool!");
+		shard_searcher_obj->finish();
+
+		L_MANAGER("Waiting for %zu shard searcher%s...", shard_searcher_obj->running_size(), (shard_searcher_obj->running_size() == 1) ? "" : "s");
+		L_MANAGER_TIMED(1s, "Is taking too long to finish the shard searchers...", "Shard searchers finished!");
+		while (!shard_searcher_obj->join(500ms)) {
+			int sig = atom_sig;
+			if (sig < 0) {
+				throw SystemExit(-sig);
+			}
+		}
+	}
+
 	////////////////////////////////////////////////////////////////////
 	if (_database_pool) {
 		L_MANAGER("Finishing database pool!");
@@ -1109,6 +1150,27 @@ XapiandManager::join()
 		}
 	}
 
+#ifdef XAPIAND_DATA_STORAGE
+
+	////////////////////////////////////////////////////////////////////
+	auto& scrubber_obj = scrubber(false);
+	if (scrubber_obj) {
+		L_MANAGER("Finishing data storage scrubbers!");
+		storage_scrub_stop();
+		scrubber_obj->finish();
+
+		L_MANAGER("Waiting for %zu data storage scrubber%s...", scrubber_obj->running_size(), (scrubber_obj->running_size() == 1) ? "" : "s");
+		L_MANAGER_TIMED(1s, "Is taking too long to finish the data storage scrubbers...", "Data storage scrubbers finished!");
+		while (!scrubber_obj->join(500ms)) {
+			int sig = atom_sig;
+			if (sig < 0) {
+				throw SystemExit(-sig);
+			}
+		}
+	}
+
+#endif
+
 	////////////////////////////////////////////////////////////////////
 	auto& fsyncher_obj = fsyncher(false);
 	if (fsyncher_obj) {
@@ -1188,8 +1250,15 @@ XapiandManager::join()
 	committer_obj.reset();
 	db_updater_obj.reset();
 	fsyncher_obj.reset();
+	shard_searcher_obj.reset();
+	bulk_preparer_obj.reset();
+#ifdef XAPIAND_DATA_STORAGE
+	scrubber_obj.reset();
+#endif
 
 	_schemas.reset();
+	query_cache(false).reset();
+	sort_keys_cache(false).reset();
 
 	////////////////////////////////////////////////////////////////////
 	L_MANAGER("Server ended!");
@@ -1385,20 +1454,63 @@ XapiandManager::resolve_index_endpoint_impl(const Endpoint& endpoint, bool maste
 {
 	L_CALL("XapiandManager::resolve_index_endpoint_impl(%s, %s)", repr(endpoint.to_string()), master ? "true" : "false");
 
-	for (const auto& node : resolve_index_nodes_impl(endpoint.path)) {
+	std::vector<std::shared_ptr<const Node>> active_nodes;
+	for (auto& node : resolve_index_nodes_impl(endpoint.path)) {
 		if (Node::is_active(node)) {
-			L_MANAGER("Active node used (of %zu nodes) %s", Node::indexed_nodes, node ? node->__repr__() : "null");
-			return {endpoint, node.get()};
+			if (master || opts.read_routing == fnv1ah32::hash("first")) {
+				L_MANAGER("Active node used (of %zu nodes) %s", Node::indexed_nodes, node ? node->__repr__() : "null");
+				return {endpoint, node.get()};
+			}
+			active_nodes.push_back(std::move(node));
+			continue;
 		}
 		L_MANAGER("Inactive node ignored (of %zu nodes) %s", Node::indexed_nodes, node ? node->__repr__() : "null");
 		if (master) {
 			break;
 		}
 	}
+	if (!active_nodes.empty()) {
+		const auto& node = resolve_read_node(active_nodes);
+		L_MANAGER("Active node used for reading (of %zu active nodes) %s", active_nodes.size(), node->__repr__());
+		return {endpoint, node.get()};
+	}
 	THROW(CheckoutErrorEndpointNotAvailable, "Endpoint not available!");
 }
 
 
+const std::shared_ptr<const Node>&
+XapiandManager::resolve_read_node(const std::vector<std::shared_ptr<const Node>>& nodes)
+{
+	L_CALL("XapiandManager::resolve_read_node(<nodes>)");
+
+	ASSERT(!nodes.empty());
+	auto size = nodes.size();
+	if (size == 1) {
+		return nodes.front();
+	}
+
+	switch (opts.read_routing) {
+		case fnv1ah32::hash("round-robin"): {
+			static std::atomic_size_t next_read_node{0};
+			return nodes[next_read_node.fetch_add(1, std::memory_order_relaxed) % size];
+		}
+		case fnv1ah32::hash("least-busy"):
+		default: {
+			// Power of two choices: the least busy of two random
+			// replicas, by the reads still in flight to each of them.
+			auto a = random_int(0, size - 1);
+			auto b = random_int(0, size - 2);
+			if (b >= a) {
+				++b;
+			}
+			const auto& node_a = nodes[a];
+			const auto& node_b = nodes[b];
+			return node_a->reading.load(std::memory_order_relaxed) <= node_b->reading.load(std::memory_order_relaxed) ? node_a : node_b;
+		}
+	}
+}
+
+
 std::string
 XapiandManager::server_metrics_impl()
 {
@@ -1465,6 +1577,12 @@ XapiandManager::server_metrics_impl()
 	metrics.xapiand_total_disk_bytes.Set(get_total_disk_size());
 	metrics.xapiand_free_disk_bytes.Set(get_free_disk_size());
 
+	// sort keys cache:
+	if (auto& cache = sort_keys_cache()) {
+		metrics.xapiand_sort_keys_cache_bytes.Set(cache->bytes());
+		metrics.xapiand_sort_keys_cache_columns.Set(cache->columns());
+	}
+
 	// databases:
 	auto count = _database_pool->count();
 	metrics.xapiand_endpoints.Set(count.first);
@@ -193,6 +193,7 @@ private:
 
 	std::vector<std::shared_ptr<const Node>> resolve_index_nodes_impl(const std::string& normalized_slashed_path);
 	Endpoint resolve_index_endpoint_impl(const Endpoint& endpoint, bool master);
+	const std::shared_ptr<const Node>& resolve_read_node(const std::vector<std::shared_ptr<const Node>>& nodes);
 
 	std::string server_metrics_impl();
 
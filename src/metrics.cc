@@ -44,6 +44,12 @@ Metrics::Metrics(const std::map<std::string, std::string>& constant_labels_) :
 			"HTTP requests summary",
 			constant_labels)
 	},
+	xapiand_latency{
+		registry.AddHistogram(
+			"xapiand_latency",
+			"Latency in seconds by operation and phase",
+			constant_labels)
+	},
 	xapiand_wal_errors{
 		registry.AddCounter(
 			"xapiand_wal_errors",
@@ -51,6 +57,104 @@ Metrics::Metrics(const std::map<std::string, std::string>& constant_labels_) :
 			constant_labels)
 		.Add({})
 	},
+	xapiand_wal_batch_lines{
+		registry.AddHistogram(
+			"xapiand_wal_batch_lines",
+			"WAL lines per group commit",
+			constant_labels)
+		.Add({}, prometheus::Histogram::BucketBoundaries{1, 2, 4, 8, 16, 32, 64, 128, 256, 512, 1024})
+	},
+	xapiand_wal_batch_bytes{
+		registry.AddHistogram(
+			"xapiand_wal_batch_bytes",
+			"WAL bytes per group commit",
+			constant_labels)
+		.Add({}, prometheus::Histogram::BucketBoundaries{1024, 4096, 16384, 65536, 262144, 1048576, 4194304, 16777216})
+	},
+	xapiand_wal_batch_latency{
+		registry.AddHistogram(
+			"xapiand_wal_batch_latency",
+			"WAL group commit latency in seconds",
+			constant_labels)
+		.Add({}, prometheus::Histogram::BucketBoundaries{0.0001, 0.0005, 0.001, 0.005, 0.01, 0.05, 0.1, 0.5, 1})
+	},
+	xapiand_storage_scrubbed_bins{
+		registry.AddCounter(
+			"xapiand_storage_scrubbed_bins",
+			"Data storage bins verified by the scrubbers",
+			constant_labels)
+		.Add({})
+	},
+	xapiand_storage_scrubbed_bytes{
+		registry.AddCounter(
+			"xapiand_storage_scrubbed_bytes",
+			"Data storage bytes verified by the scrubbers",
+			constant_labels)
+		.Add({})
+	},
+	xapiand_storage_scrub_errors{
+		registry.AddCounter(
+			"xapiand_storage_scrub_errors",
+			"Data storage corruption errors found by the scrubbers",
+			constant_labels)
+		.Add({})
+	},
+	xapiand_query_cache_hits{
+		registry.AddCounter(
+			"xapiand_query_cache_hits",
+			"Searches answered from the query result cache",
+			constant_labels)
+		.Add({})
+	},
+	xapiand_query_cache_misses{
+		registry.AddCounter(
+			"xapiand_query_cache_misses",
+			"Searches not found (or stale) in the query result cache",
+			constant_labels)
+		.Add({})
+	},
+	xapiand_query_cache_evictions{
+		registry.AddCounter(
+			"xapiand_query_cache_evictions",
+			"Results evicted from the query result cache",
+			constant_labels)
+		.Add({})
+	},
+	xapiand_sort_keys_cache_hits{
+		registry.AddCounter(
+			"xapiand_sort_keys_cache_hits",
+			"Sorts using a column from the sort keys cache",
+			constant_labels)
+		.Add({})
+	},
+	xapiand_sort_keys_cache_misses{
+		registry.AddCounter(
+			"xapiand_sort_keys_cache_misses",
+			"Sorts not finding (or finding a stale) column in the sort keys cache",
+			constant_labels)
+		.Add({})
+	},
+	xapiand_sort_keys_cache_evictions{
+		registry.AddCounter(
+			"xapiand_sort_keys_cache_evictions",
+			"Columns evicted from the sort keys cache",
+			constant_labels)
+		.Add({})
+	},
+	xapiand_script_cache_contention{
+		registry.AddCounter(
+			"xapiand_script_cache_contention",
+			"Script cache lookups that had to wait for the lock",
+			constant_labels)
+		.Add({})
+	},
+	xapiand_document_changes_contention{
+		registry.AddCounter(
+			"xapiand_document_changes_contention",
+			"Scripted document changes that had to wait for the lock",
+			constant_labels)
+		.Add({})
+	},
 	xapiand_uptime{
 		registry.AddGauge(
 			"xapiand_uptime",
@@ -390,6 +494,20 @@ Metrics::Metrics(const std::map<std::string, std::string>& constant_labels_) :
 			constant_labels)
 		.Add({})
 	},
+	xapiand_sort_keys_cache_bytes{
+		registry.AddGauge(
+			"xapiand_sort_keys_cache_bytes",
+			"Bytes held by the columns in the sort keys cache",
+			constant_labels)
+		.Add({})
+	},
+	xapiand_sort_keys_cache_columns{
+		registry.AddGauge(
+			"xapiand_sort_keys_cache_columns",
+			"Columns in the sort keys cache",
+			constant_labels)
+		.Add({})
+	},
 	xapiand_endpoints{
 		registry.AddGauge(
 			"xapiand_endpoints",
@@ -423,6 +541,19 @@ Metrics::metrics(const std::map<std::string, std::string>& constant_labels_)
 }
 
 
+prometheus::Histogram&
+Metrics::latency(const std::string& operation, const std::string& phase)
+{
+	static const prometheus::Histogram::BucketBoundaries latency_buckets{
+		0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10,
+	};
+	return xapiand_latency.Add({
+		{"operation", operation},
+		{"phase", phase},
+	}, latency_buckets);
+}
+
+
 std::string
 Metrics::serialise()
 {
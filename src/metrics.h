@@ -44,9 +44,28 @@ public:
 
 	prometheus::Family<prometheus::Summary>& xapiand_operations_summary;
 	prometheus::Family<prometheus::Summary>& xapiand_http_requests_summary;
+	prometheus::Family<prometheus::Histogram>& xapiand_latency;
+
+	// Latency histogram of a phase of an operation, all of them share
+	// the same fixed buckets so they can be merged across nodes.
+	prometheus::Histogram& latency(const std::string& operation, const std::string& phase);
 
 	// server info
 	prometheus::Counter& xapiand_wal_errors;
+	prometheus::Histogram& xapiand_wal_batch_lines;
+	prometheus::Histogram& xapiand_wal_batch_bytes;
+	prometheus::Histogram& xapiand_wal_batch_latency;
+	prometheus::Counter& xapiand_storage_scrubbed_bins;
+	prometheus::Counter& xapiand_storage_scrubbed_bytes;
+	prometheus::Counter& xapiand_storage_scrub_errors;
+	prometheus::Counter& xapiand_query_cache_hits;
+	prometheus::Counter& xapiand_query_cache_misses;
+	prometheus::Counter& xapiand_query_cache_evictions;
+	prometheus::Counter& xapiand_sort_keys_cache_hits;
+	prometheus::Counter& xapiand_sort_keys_cache_misses;
+	prometheus::Counter& xapiand_sort_keys_cache_evictions;
+	prometheus::Counter& xapiand_script_cache_contention;
+	prometheus::Counter& xapiand_document_changes_contention;
 	prometheus::Gauge& xapiand_uptime;
 	prometheus::Gauge& xapiand_running;
 	prometheus::Gauge& xapiand_info;
@@ -120,6 +139,10 @@ public:
 	prometheus::Gauge& xapiand_total_disk_bytes;
 	prometheus::Gauge& xapiand_free_disk_bytes;
 
+	// sort keys cache:
+	prometheus::Gauge& xapiand_sort_keys_cache_bytes;
+	prometheus::Gauge& xapiand_sort_keys_cache_columns;
+
 	// databases:
 	prometheus::Gauge& xapiand_endpoints;
 	prometheus::Gauge& xapiand_databases;
@@ -0,0 +1,170 @@
+/*
+ * Copyright (C) 2019 Dubalu LLC. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#pragma once
+
+#include <array>                 // for std::array
+#include <cstdint>               // for uint64_t
+#include <memory>                // for std::unique_ptr, std::make_unique
+#include "string_view.hh"        // for std::string_view
+
+#include "chars.hh"              // for chars::toupper
+
+
+/*
+ * Bit vectors with the positions of every character in a pattern,
+ * precomputed once so bit-parallel string metrics can compare the pattern
+ * against any number of strings without allocating.
+ *
+ * Patterns longer than a machine word are not supported (empty() is true),
+ * metrics must fall back to their dynamic programming versions for those.
+ *
+ * With icase the (already upper-cased) pattern also matches every byte that
+ * chars::toupper maps to one of its characters, so texts can be compared
+ * as they are instead of being upper-cased into a new string first.
+ */
+class PatternMatchVector {
+	std::unique_ptr<std::array<uint64_t, 256>> _peq;
+	size_t _size;
+
+public:
+	static constexpr size_t max_size = 64;
+
+	PatternMatchVector()
+		: _size(0) { }
+
+	explicit PatternMatchVector(std::string_view pattern, bool icase = false)
+		: _size(pattern.size())
+	{
+		if (_size != 0 && _size <= max_size) {
+			_peq = std::make_unique<std::array<uint64_t, 256>>();
+			_peq->fill(0);
+			uint64_t bit = 1;
+			for (auto c : pattern) {
+				(*_peq)[static_cast<unsigned char>(c)] |= bit;
+				bit <<= 1;
+			}
+			if (icase) {
+				const auto peq = *_peq;
+				for (size_t c = 0; c < peq.size(); ++c) {
+					(*_peq)[c] = peq[static_cast<unsigned char>(chars::toupper(static_cast<char>(c)))];
+				}
+			}
+		}
+	}
+
+	PatternMatchVector(const PatternMatchVector& other)
+		: _peq(other._peq ? std::make_unique<std::array<uint64_t, 256>>(*other._peq) : nullptr),
+		  _size(other._size) { }
+
+	PatternMatchVector(PatternMatchVector&&) = default;
+
+	PatternMatchVector& operator=(const PatternMatchVector& other) {
+		_peq = other._peq ? std::make_unique<std::array<uint64_t, 256>>(*other._peq) : nullptr;
+		_size = other._size;
+		return *this;
+	}
+
+	PatternMatchVector& operator=(PatternMatchVector&&) = default;
+
+	bool empty() const noexcept {
+		return !_peq;
+	}
+
+	size_t size() const noexcept {
+		return _size;
+	}
+
+	uint64_t get(char c) const noexcept {
+		return (*_peq)[static_cast<unsigned char>(c)];
+	}
+
+	uint64_t mask() const noexcept {
+		return _size == max_size ? ~static_cast<uint64_t>(0) : (static_cast<uint64_t>(1) << _size) - 1;
+	}
+};
+
+
+/*
+ * Only the metrics whose recurrence is a unit-cost dynamic programming
+ * matrix (Levenshtein and LCSubsequence, and so the soundex metrics built on
+ * them) have bit-parallel kernels; Jaro, Jaro-Winkler, LCSubstr, Jaccard and
+ * Sorensen-Dice keep their own implementations.
+ */
+namespace bit_parallel {
+
+/*
+ * Levenshtein distance (unit costs) between the pattern and text.
+ *
+ * Myers' algorithm, as formulated by Hyyrö for the edit distance of the
+ * whole strings: each character of text updates the column of vertical
+ * deltas of the dynamic programming matrix at once, and the score is
+ * tracked at the last row.
+ */
+inline size_t
+levenshtein(const PatternMatchVector& peq, std::string_view text) noexcept
+{
+	uint64_t vp = ~static_cast<uint64_t>(0);
+	uint64_t vn = 0;
+	const uint64_t last = static_cast<uint64_t>(1) << (peq.size() - 1);
+
+	auto score = peq.size();
+	for (auto c : text) {
+		const auto x = peq.get(c) | vn;
+		const auto d0 = (((x & vp) + vp) ^ vp) | x;
+		auto hp = vn | ~(d0 | vp);
+		auto hn = vp & d0;
+		if (hp & last) {
+			++score;
+		} else if (hn & last) {
+			--score;
+		}
+		hp = (hp << 1) | 1;
+		hn = hn << 1;
+		vp = hn | ~(d0 | hp);
+		vn = hp & d0;
+	}
+
+	return score;
+}
+
+
+/*
+ * Length of the longest common subsequence between the pattern and text.
+ *
+ * Allison-Dix / Hyyrö: zero bits in s mark the positions of the pattern
+ * where the length of the common subsequence increases.
+ */
+inline size_t
+lcs(const PatternMatchVector& peq, std::string_view text) noexcept
+{
+	uint64_t s = ~static_cast<uint64_t>(0);
+	for (auto c : text) {
+		const auto u = s & peq.get(c);
+		s = (s + u) | (s - u);
+	}
+
+	return __builtin_popcountll(~s & peq.mask());
+}
+
+}  // namespace bit_parallel
@@ -23,6 +23,7 @@
 #pragma once
 
 #include "basic_string_metric.h"
+#include "bit_parallel.h"
 
 
 /*
@@ -31,6 +32,7 @@
  * Character-based metric.
  */
 class LCSubsequence : public StringMetric<LCSubsequence> {
+	PatternMatchVector _peq;
 
 	friend class StringMetric<LCSubsequence>;
 
@@ -59,7 +61,7 @@ class LCSubsequence : public StringMetric<LCSubsequence> {
 	}
 
 	double _distance(const std::string& str2) const {
-		return _distance(_str, str2);
+		return 1.0 - _similarity(str2);
 	}
 
 	double _similarity(const std::string& str1, const std::string& str2) const {
@@ -80,5 +82,40 @@ public:
 
 	template <typename T>
 	LCSubsequence(T&& str, bool icase=true)
-		: StringMetric<LCSubsequence>(std::forward<T>(str), icase) { }
+		: StringMetric<LCSubsequence>(std::forward<T>(str), icase),
+		  _peq(_str, _icase) { }
+
+	using StringMetric<LCSubsequence>::distance;
+	using StringMetric<LCSubsequence>::similarity;
+
+	/*
+	 * Comparisons against the string given in the constructor use the
+	 * bit-parallel kernel, it folds case by itself so str2 is neither
+	 * upper-cased nor copied.
+	 */
+	template <typename T>
+	double similarity(T&& str2) const {
+		if (_peq.empty()) {
+			return StringMetric<LCSubsequence>::similarity(std::forward<T>(str2));
+		}
+
+		if (str2.empty()) {
+			return 0.0;
+		}
+
+		return (double)bit_parallel::lcs(_peq, str2) / std::max(_str.length(), str2.length());
+	}
+
+	template <typename T>
+	double distance(T&& str2) const {
+		if (_peq.empty()) {
+			return StringMetric<LCSubsequence>::distance(std::forward<T>(str2));
+		}
+
+		if (str2.empty()) {
+			return 1.0;
+		}
+
+		return 1.0 - similarity(std::forward<T>(str2));
+	}
 };
@@ -23,6 +23,7 @@
 #pragma once
 
 #include "basic_string_metric.h"
+#include "bit_parallel.h"
 
 
 /*
@@ -34,6 +35,7 @@ class Levenshtein : public StringMetric<Levenshtein> {
 	size_t _subst_cost;
 	size_t _ins_del_cost;
 	size_t _maxCost;
+	PatternMatchVector _peq;
 
 	friend class StringMetric<Levenshtein>;
 
@@ -65,7 +67,7 @@ class Levenshtein : public StringMetric<Levenshtein> {
 	}
 
 	double _similarity(const std::string& str2) const {
-		return 1.0 - _distance(_str, str2);
+		return 1.0 - _distance(str2);
 	}
 
 	std::string _description() const noexcept {
@@ -84,5 +86,40 @@ public:
 		: StringMetric<Levenshtein>(std::forward<T>(str), icase),
 		  _subst_cost(subst_cost),
 		  _ins_del_cost(ins_del_cost),
-		  _maxCost(std::max(_subst_cost, _ins_del_cost)) { }
+		  _maxCost(std::max(_subst_cost, _ins_del_cost)),
+		  _peq(_str, _icase) { }
+
+	using StringMetric<Levenshtein>::distance;
+	using StringMetric<Levenshtein>::similarity;
+
+	/*
+	 * Comparisons against the string given in the constructor use the
+	 * bit-parallel kernel for unit costs, it folds case by itself so str2
+	 * is neither upper-cased nor copied.
+	 */
+	template <typename T>
+	double distance(T&& str2) const {
+		if (_peq.empty() || _subst_cost != 1 || _ins_del_cost != 1) {
+			return StringMetric<Levenshtein>::distance(std::forward<T>(str2));
+		}
+
+		if (str2.empty()) {
+			return 1.0;
+		}
+
+		return (double)bit_parallel::levenshtein(_peq, str2) / std::max(_str.length(), str2.length());
+	}
+
+	template <typename T>
+	double similarity(T&& str2) const {
+		if (_peq.empty() || _subst_cost != 1 || _ins_del_cost != 1) {
+			return StringMetric<Levenshtein>::similarity(std::forward<T>(str2));
+		}
+
+		if (str2.empty()) {
+			return 0.0;
+		}
+
+		return 1.0 - distance(std::forward<T>(str2));
+	}
 };
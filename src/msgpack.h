@@ -132,11 +132,13 @@ public:
 	MsgPack(MsgPack&& other);
 	MsgPack(std::initializer_list<MsgPack> list);
 	MsgPack(Type type);
+	MsgPack(const std::shared_ptr<msgpack::zone>& zone, const msgpack::object& obj);
 
 	template <typename T, typename = std::enable_if_t<not std::is_same<std::shared_ptr<Body>, std::decay_t<T>>::value>>
 	MsgPack(T&& v);
 
 	MsgPack clone() const;
+	void swap(MsgPack& other) noexcept;
 
 	MsgPack& operator=(const MsgPack& other);
 	MsgPack& operator=(MsgPack&& other);
@@ -793,6 +795,16 @@ inline MsgPack::MsgPack(msgpack::object&& _object, bool _const)
 	  _const_body(_body.get()) { }
 
 
+// Takes over an object already allocated in zone (e.g. by a parser), instead
+// of copying it into a zone of its own.
+inline MsgPack::MsgPack(const std::shared_ptr<msgpack::zone>& zone, const msgpack::object& obj)
+{
+	auto base = std::make_shared<msgpack::object>(obj);
+	_body = std::make_shared<Body>(zone, base, std::shared_ptr<Body>(), base.get());
+	_const_body = _body.get();
+}
+
+
 template <typename T, typename>
 inline MsgPack::MsgPack(T&& v)
 	: _body(std::make_shared<Body>(std::forward<T>(v))),
@@ -865,6 +877,15 @@ inline MsgPack MsgPack::clone() const {
 }
 
 
+// Assignments copy the other object into this object's zone, swapping
+// (root objects only) exchanges both objects without copying anything.
+inline void MsgPack::swap(MsgPack& other) noexcept {
+	ASSERT(_body->_parent.expired() && other._body->_parent.expired());
+	std::swap(_body, other._body);
+	std::swap(_const_body, other._const_body);
+}
+
+
 inline MsgPack& MsgPack::operator=(const MsgPack& other) {
 	ASSERT(!other._body->_lock);
 	_assignment(msgpack::object(other, *_body->_zone));
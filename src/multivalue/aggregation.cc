@@ -59,11 +59,12 @@ Aggregation::Aggregation(const MsgPack& context, const std::shared_ptr<Schema>&
 		hh(AGGREGATION_STD),
 		hh(AGGREGATION_MEDIAN),
 		hh(AGGREGATION_MODE),
+		hh(AGGREGATION_APPROX_MODE),
 		hh(AGGREGATION_STATS),
 		hh(AGGREGATION_EXT_STATS),
 		// hh(AGGREGATION_GEO_BOUNDS),
 		// hh(AGGREGATION_GEO_CENTROID),
-		// hh(AGGREGATION_PERCENTILES),
+		hh(AGGREGATION_PERCENTILES),
 		// hh(AGGREGATION_PERCENTILES_RANK),
 		// hh(AGGREGATION_SCRIPTED_METRIC),
 		hh(AGGREGATION_FILTER),
@@ -132,6 +133,9 @@ Aggregation::Aggregation(const MsgPack& context, const std::shared_ptr<Schema>&
 					case _.fhh(AGGREGATION_MODE):
 						add_metric<MetricMode>(sub_agg_name, sub_agg, sub_agg_type, schema);
 						break;
+					case _.fhh(AGGREGATION_APPROX_MODE):
+						add_metric<MetricApproxMode>(sub_agg_name, sub_agg, sub_agg_type, schema);
+						break;
 					case _.fhh(AGGREGATION_STATS):
 						add_metric<MetricStats>(sub_agg_name, sub_agg, sub_agg_type, schema);
 						break;
@@ -144,9 +148,9 @@ Aggregation::Aggregation(const MsgPack& context, const std::shared_ptr<Schema>&
 					// case _.fhh(AGGREGATION_GEO_CENTROID):
 					// 	add_metric<MetricGeoCentroid>(sub_agg_name, sub_agg, sub_agg_type, schema);
 					// 	break;
-					// case _.fhh(AGGREGATION_PERCENTILES):
-					// 	add_metric<MetricPercentiles>(sub_agg_name, sub_agg, sub_agg_type, schema);
-					// 	break;
+					case _.fhh(AGGREGATION_PERCENTILES):
+						add_metric<MetricPercentiles>(sub_agg_name, sub_agg, sub_agg_type, schema);
+						break;
 					// case _.fhh(AGGREGATION_PERCENTILES_RANK):
 					// 	add_metric<MetricPercentilesRank>(sub_agg_name, sub_agg, sub_agg_type, schema);
 					// 	break;
@@ -237,6 +241,39 @@ Aggregation::get_result()
 }
 
 
+MsgPack
+Aggregation::serialise_results() const
+{
+	MsgPack sub_aggs(MsgPack::Type::MAP);
+	for (const auto& sub_agg : _sub_aggs) {
+		sub_aggs[sub_agg.first] = sub_agg.second->serialise_results();
+	}
+	return {
+		_doc_count,
+		sub_aggs,
+	};
+}
+
+
+void
+Aggregation::merge_results(const MsgPack& results)
+{
+	if (!results.is_array() || results.size() != 2) {
+		THROW(AggregationError, "Bad serialised aggregation results");
+	}
+	_doc_count += results.at(0).as_u64();
+	const auto& sub_aggs = results.at(1);
+	const auto it_end = sub_aggs.end();
+	for (auto it = sub_aggs.begin(); it != it_end; ++it) {
+		auto sub_agg = _sub_aggs.find(it->str_view());
+		if (sub_agg == _sub_aggs.end()) {
+			THROW(AggregationError, "Aggregation %s not found while merging results", repr(it->str_view()));
+		}
+		sub_agg->second->merge_results(it.value());
+	}
+}
+
+
 BaseAggregation*
 Aggregation::get_agg(std::string_view field)
 {
@@ -303,3 +340,30 @@ AggregationMatchSpy::get_description() const
 	desc.append(_aggs.to_string()).push_back(')');
 	return desc;
 }
+
+
+std::string
+AggregationMatchSpy::serialise_results() const
+{
+	MsgPack results = {
+		_total,
+		_aggregation.serialise_results(),
+	};
+	return results.serialise();
+}
+
+
+void
+AggregationMatchSpy::merge_results(const std::string& serialised)
+{
+	try {
+		auto results = MsgPack::unserialise(serialised);
+		if (!results.is_array() || results.size() != 2) {
+			throw Xapian::NetworkError("Bad serialised AggregationMatchSpy results");
+		}
+		_total += results.at(0).as_u64();
+		_aggregation.merge_results(results.at(1));
+	} catch (const SerialisationError&) {
+		throw Xapian::NetworkError("Bad serialised AggregationMatchSpy results");
+	}
+}
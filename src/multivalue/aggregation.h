@@ -46,6 +46,7 @@ constexpr const char AGGREGATION_RANGES[]           = "_ranges";
 constexpr const char AGGREGATION_SUM_OF_SQ[]        = "_sum_of_squares";
 constexpr const char AGGREGATION_TO[]               = "_to";
 
+constexpr const char AGGREGATION_APPROX_MODE[]      = "_approx_mode";
 constexpr const char AGGREGATION_AVG[]              = "_avg";
 constexpr const char AGGREGATION_CARDINALITY[]      = "_cardinality";
 constexpr const char AGGREGATION_COUNT[]            = "_count";
@@ -81,6 +82,9 @@ constexpr const char AGGREGATION_TERMS[]            = "_terms";
 constexpr const char AGGREGATION_UPPER[]            = "_upper";
 constexpr const char AGGREGATION_LOWER[]            = "_lower";
 constexpr const char AGGREGATION_SIGMA[]            = "_sigma";
+constexpr const char AGGREGATION_PERCENTS[]         = "_percents";
+constexpr const char AGGREGATION_COMPRESSION[]      = "_compression";
+constexpr const char AGGREGATION_COUNTERS[]         = "_counters";
 
 constexpr const char AGGREGATION_VALUE[]            = "_value";
 constexpr const char AGGREGATION_TERM[]             = "_term";
@@ -104,6 +108,13 @@ public:
 
 	virtual MsgPack get_result() = 0;
 
+	// Partial (not yet updated) state of the aggregation, so aggregations
+	// computed elsewhere (other shards, threads or remote nodes) can be
+	// combined later on using merge_results().
+	virtual MsgPack serialise_results() const = 0;
+
+	virtual void merge_results(const MsgPack& results) = 0;
+
 	virtual BaseAggregation* get_agg(std::string_view) {
 		return nullptr;
 	}
@@ -134,6 +145,10 @@ public:
 
 	MsgPack get_result() override;
 
+	MsgPack serialise_results() const override;
+
+	void merge_results(const MsgPack& results) override;
+
 	BaseAggregation* get_agg(std::string_view field) override;
 
 	size_t doc_count() const {
@@ -197,6 +212,8 @@ public:
 	std::string serialise() const override;
 	Xapian::MatchSpy* unserialise(const std::string& serialised, const Xapian::Registry& context) const override;
 	std::string get_description() const override;
+	std::string serialise_results() const override;
+	void merge_results(const std::string& serialised) override;
 
 	const auto& get_aggregation() noexcept {
 		_aggregation.update();
@@ -91,6 +91,20 @@ FilterAggregation::get_result()
 }
 
 
+MsgPack
+FilterAggregation::serialise_results() const
+{
+	return _agg.serialise_results();
+}
+
+
+void
+FilterAggregation::merge_results(const MsgPack& results)
+{
+	_agg.merge_results(results);
+}
+
+
 void
 FilterAggregation::check_single(const Xapian::Document& doc)
 {
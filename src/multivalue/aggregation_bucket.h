@@ -453,19 +453,48 @@ public:
 		return nullptr;
 	}
 
+	MsgPack serialise_results() const override {
+		MsgPack results(MsgPack::Type::MAP);
+		for (const auto& agg : _aggs) {
+			results[agg.first] = {
+				serialise_long_double(agg.second.slot),
+				agg.second.idx,
+				agg.second.serialise_results(),
+			};
+		}
+		return results;
+	}
+
+	void merge_results(const MsgPack& results) override {
+		const auto it_end = results.end();
+		for (auto it = results.begin(); it != it_end; ++it) {
+			const auto& bucket_results = it.value();
+			if (!bucket_results.is_array() || bucket_results.size() != 3) {
+				THROW(AggregationError, "Bad serialised bucket results");
+			}
+			auto bucket = it->str_view();
+			auto agg_it = _aggs.find(std::string(bucket));  // FIXME: This copies bucket as std::map cannot find std::string_view directly!
+			if (agg_it == _aggs.end()) {
+				agg_it = _emplace(unserialise_long_double(bucket_results.at(0)), bucket, bucket_results.at(1).as_u64());
+			}
+			agg_it->second.merge_results(bucket_results.at(2));
+		}
+	}
+
 	void aggregate(long double slot, std::string_view bucket, const Xapian::Document& doc, size_t idx = 0) {
 		auto it = _aggs.find(std::string(bucket));  // FIXME: This copies bucket as std::map cannot find std::string_view directly!
-		if (it != _aggs.end()) {
-			it->second(doc);
-			return;
+		if (it == _aggs.end()) {
+			it = _emplace(slot, bucket, idx);
 		}
+		it->second(doc);
+	}
 
+private:
+	std::map<std::string, Aggregation>::iterator _emplace(long double slot, std::string_view bucket, size_t idx) {
 		auto emplaced = _aggs.emplace(std::piecewise_construct,
 			std::forward_as_tuple(bucket),
 			std::forward_as_tuple(_context, _schema));
 
-		emplaced.first->second(doc);
-
 		emplaced.first->second.slot = slot;
 		emplaced.first->second.idx = idx;
 
@@ -490,6 +519,8 @@ public:
 				THROW(AggregationError, "Field not found! (2)");
 			}
 		}
+
+		return emplaced.first;
 	}
 };
 
@@ -1080,6 +1111,10 @@ public:
 
 	MsgPack get_result() override;
 
+	MsgPack serialise_results() const override;
+
+	void merge_results(const MsgPack& results) override;
+
 	void check_single(const Xapian::Document& doc);
 	void check_multiple(const Xapian::Document& doc);
 };
@@ -24,7 +24,6 @@
 
 #include <algorithm>                // for std::nth_element, std::max_element
 #include <cmath>                    // for sqrt
-#include <cstdio>
 #include <cstring>                  // for size_t
 #include <limits>                   // for std::numeric_limits
 #include <map>                      // for std::map
@@ -39,6 +38,8 @@
 #include "exception.h"              // for AggregationError, MSG_AggregationError
 #include "msgpack.h"                // for MsgPack, object::object
 #include "serialise_list.h"         // for StringList, RangeList
+#include "sketch.h"                 // for TDigest, FrequentItems
+#include "string.hh"                // for string::Number
 
 
 class Schema;
@@ -238,6 +239,14 @@ public:
 		return nullptr;
 	}
 
+	MsgPack serialise_results() const override {
+		return static_cast<uint64_t>(_count);
+	}
+
+	void merge_results(const MsgPack& results) override {
+		_count += results.as_u64();
+	}
+
 	void _aggregate() {
 		++_count;
 	}
@@ -306,6 +315,14 @@ public:
 		return nullptr;
 	}
 
+	MsgPack serialise_results() const override {
+		return serialise_long_double(_sum);
+	}
+
+	void merge_results(const MsgPack& results) override {
+		_sum += unserialise_long_double(results);
+	}
+
 	void _aggregate(long double value) {
 		_sum += value;
 	}
@@ -361,6 +378,18 @@ public:
 		return nullptr;
 	}
 
+	MsgPack serialise_results() const override {
+		return {
+			static_cast<uint64_t>(_count),
+			serialise_long_double(_sum),
+		};
+	}
+
+	void merge_results(const MsgPack& results) override {
+		_count += results.at(0).as_u64();
+		_sum += unserialise_long_double(results.at(1));
+	}
+
 	void _aggregate(long double value) {
 		++_count;
 		_sum += value;
@@ -429,6 +458,14 @@ public:
 		return nullptr;
 	}
 
+	MsgPack serialise_results() const override {
+		return serialise_long_double(_min);
+	}
+
+	void merge_results(const MsgPack& results) override {
+		_aggregate(unserialise_long_double(results));
+	}
+
 	void _aggregate(long double value) {
 		if (value < _min) {
 			_min = value;
@@ -490,6 +527,14 @@ public:
 		return nullptr;
 	}
 
+	MsgPack serialise_results() const override {
+		return serialise_long_double(_max);
+	}
+
+	void merge_results(const MsgPack& results) override {
+		_aggregate(unserialise_long_double(results));
+	}
+
 	void _aggregate(long double value) {
 		if (value > _max) {
 			_max = value;
@@ -546,6 +591,20 @@ public:
 		return nullptr;
 	}
 
+	MsgPack serialise_results() const override {
+		return {
+			static_cast<uint64_t>(_count),
+			serialise_long_double(_sum),
+			serialise_long_double(_sq_sum),
+		};
+	}
+
+	void merge_results(const MsgPack& results) override {
+		_count += results.at(0).as_u64();
+		_sum += unserialise_long_double(results.at(1));
+		_sq_sum += unserialise_long_double(results.at(2));
+	}
+
 	void _aggregate(long double value) {
 		++_count;
 		_sum += value;
@@ -654,6 +713,9 @@ public:
 };
 
 
+// Exact median: every value is kept and partial results ship all of them,
+// so memory and merge payloads grow with the number of matched values.
+// Use percentiles (TDigest) with "_percents": [50] for a bounded estimate.
 class MetricMedian : public HandledSubAggregation<ValuesHandler> {
 	std::vector<long double> values;
 
@@ -694,6 +756,22 @@ public:
 		}
 	}
 
+	MsgPack serialise_results() const override {
+		MsgPack results(MsgPack::Type::ARRAY);
+		results.reserve(values.size());
+		for (const auto& value : values) {
+			results.append(serialise_long_double(value));
+		}
+		return results;
+	}
+
+	void merge_results(const MsgPack& results) override {
+		values.reserve(values.size() + results.size());
+		for (const auto& value : results) {
+			_aggregate(unserialise_long_double(value));
+		}
+	}
+
 	void _aggregate(long double value) {
 		values.push_back(value);
 	}
@@ -749,8 +827,25 @@ public:
 
 	void update() override {
 		if (!_histogram.empty()) {
-			auto it = std::max_element(_histogram.begin(), _histogram.end(), [](const std::pair<double, size_t>& a, const std::pair<double, size_t>& b) { return a.second < b.second; });
-			_mode = static_cast<double>(it->first);
+			auto it = std::max_element(_histogram.begin(), _histogram.end(), [](const std::pair<const long double, size_t>& a, const std::pair<const long double, size_t>& b) { return a.second < b.second; });
+			_mode = it->first;
+		}
+	}
+
+	MsgPack serialise_results() const override {
+		MsgPack results(MsgPack::Type::ARRAY);
+		for (const auto& bin : _histogram) {
+			results.append(MsgPack({
+				serialise_long_double(bin.first),
+				bin.second,
+			}));
+		}
+		return results;
+	}
+
+	void merge_results(const MsgPack& results) override {
+		for (const auto& bin : results) {
+			_histogram[unserialise_long_double(bin.at(0))] += bin.at(1).as_u64();
 		}
 	}
 
@@ -784,6 +879,214 @@ public:
 };
 
 
+// Approximate percentiles (t-digest), memory is bounded by _compression.
+class MetricPercentiles : public HandledSubAggregation<ValuesHandler> {
+	TDigest _digest;
+
+	std::vector<long double> _percents;
+	std::vector<std::string> _keys;
+	std::vector<long double> _percentiles;
+
+	static long double get_compression(const MsgPack& conf) {
+		const auto it = conf.find(AGGREGATION_COMPRESSION);
+		if (it != conf.end()) {
+			const auto& compression_value = it.value();
+			switch (compression_value.getType()) {
+				case MsgPack::Type::POSITIVE_INTEGER:
+				case MsgPack::Type::NEGATIVE_INTEGER:
+				case MsgPack::Type::FLOAT: {
+					auto compression = compression_value.as_f64();
+					if (compression >= 10.0 && compression <= 10000.0) {
+						return compression;
+					}
+				}
+				default:
+					THROW(AggregationError, "'%s' must be a number between 10 and 10000", AGGREGATION_COMPRESSION);
+			}
+		}
+		return 100.0;
+	}
+
+public:
+	MetricPercentiles(const MsgPack& context, std::string_view name, const std::shared_ptr<Schema>& schema)
+		: HandledSubAggregation<ValuesHandler>(context, name, schema),
+		  _digest(get_compression(_conf)) {
+		const auto it = _conf.find(AGGREGATION_PERCENTS);
+		if (it != _conf.end()) {
+			const auto& percents_value = it.value();
+			if (!percents_value.is_array()) {
+				THROW(AggregationError, "'%s' must be an array of numbers between 0 and 100", AGGREGATION_PERCENTS);
+			}
+			for (const auto& percent_value : percents_value) {
+				switch (percent_value.getType()) {
+					case MsgPack::Type::POSITIVE_INTEGER:
+					case MsgPack::Type::NEGATIVE_INTEGER:
+					case MsgPack::Type::FLOAT: {
+						auto percent = percent_value.as_f64();
+						if (percent >= 0.0 && percent <= 100.0) {
+							_percents.push_back(percent);
+							break;
+						}
+					}
+					default:
+						THROW(AggregationError, "'%s' must be an array of numbers between 0 and 100", AGGREGATION_PERCENTS);
+				}
+			}
+		} else {
+			_percents = { 1, 5, 25, 50, 75, 95, 99 };
+		}
+		for (const auto& percent : _percents) {
+			_keys.push_back(string::Number(percent).str());
+		}
+		_percentiles.resize(_percents.size());
+	}
+
+	MsgPack get_result() override {
+		MsgPack percentiles(MsgPack::Type::MAP);
+		for (size_t i = 0; i < _keys.size(); ++i) {
+			percentiles[_keys[i]] = static_cast<double>(_percentiles[i]);
+		}
+		return {
+			{ AGGREGATION_PERCENTILES, percentiles },
+		};
+	}
+
+	const long double* get_value_ptr(std::string_view field) const override {
+		for (size_t i = 0; i < _keys.size(); ++i) {
+			if (field == _keys[i]) {
+				return &_percentiles[i];
+			}
+		}
+		return nullptr;
+	}
+
+	void update() override {
+		if (_digest.size() != 0) {
+			for (size_t i = 0; i < _percents.size(); ++i) {
+				_percentiles[i] = _digest.quantile(_percents[i] / 100);
+			}
+		}
+	}
+
+	MsgPack serialise_results() const override {
+		return _digest.serialise();
+	}
+
+	void merge_results(const MsgPack& results) override {
+		_digest.merge(results);
+	}
+
+	void _aggregate(long double value) {
+		_digest.add(value);
+	}
+
+	void aggregate_float(long double value, const Xapian::Document&) override {
+		_aggregate(value);
+	}
+
+	void aggregate_integer(int64_t value, const Xapian::Document&) override {
+		_aggregate(value);
+	}
+
+	void aggregate_positive(uint64_t value, const Xapian::Document&) override {
+		_aggregate(value);
+	}
+
+	void aggregate_date(double value, const Xapian::Document&) override {
+		_aggregate(value);
+	}
+
+	void aggregate_time(double value, const Xapian::Document&) override {
+		_aggregate(value);
+	}
+
+	void aggregate_timedelta(double value, const Xapian::Document&) override {
+		_aggregate(value);
+	}
+};
+
+
+// Approximate mode (Misra-Gries heavy hitters), keeps at most _counters values.
+class MetricApproxMode : public HandledSubAggregation<ValuesHandler> {
+	FrequentItems _items;
+
+	long double _mode;
+
+	static size_t get_counters(const MsgPack& conf) {
+		const auto it = conf.find(AGGREGATION_COUNTERS);
+		if (it != conf.end()) {
+			const auto& counters_value = it.value();
+			if (counters_value.is_integer() && counters_value.as_i64() > 0) {
+				return counters_value.as_u64();
+			}
+			THROW(AggregationError, "'%s' must be a positive integer", AGGREGATION_COUNTERS);
+		}
+		return 100;
+	}
+
+public:
+	MetricApproxMode(const MsgPack& context, std::string_view name, const std::shared_ptr<Schema>& schema)
+		: HandledSubAggregation<ValuesHandler>(context, name, schema),
+		  _items(get_counters(_conf)),
+		  _mode{0.0} { }
+
+	MsgPack get_result() override {
+		return {
+			{ AGGREGATION_MODE, static_cast<double>(_mode) },
+		};
+	}
+
+	const long double* get_value_ptr(std::string_view field) const override {
+		if (field == AGGREGATION_MODE) {
+			return &_mode;
+		}
+		return nullptr;
+	}
+
+	void update() override {
+		if (!_items.empty()) {
+			_mode = _items.most_frequent().first;
+		}
+	}
+
+	MsgPack serialise_results() const override {
+		return _items.serialise();
+	}
+
+	void merge_results(const MsgPack& results) override {
+		_items.merge(results);
+	}
+
+	void _aggregate(long double value) {
+		_items.add(value);
+	}
+
+	void aggregate_float(long double value, const Xapian::Document&) override {
+		_aggregate(value);
+	}
+
+	void aggregate_integer(int64_t value, const Xapian::Document&) override {
+		_aggregate(value);
+	}
+
+	void aggregate_positive(uint64_t value, const Xapian::Document&) override {
+		_aggregate(value);
+	}
+
+	void aggregate_date(double value, const Xapian::Document&) override {
+		_aggregate(value);
+	}
+
+	void aggregate_time(double value, const Xapian::Document&) override {
+		_aggregate(value);
+	}
+
+	void aggregate_timedelta(double value, const Xapian::Document&) override {
+		_aggregate(value);
+	}
+};
+
+
 class MetricStats : public MetricAvg {
 protected:
 	MetricMin _min_metric;
@@ -824,6 +1127,20 @@ public:
 		return nullptr;
 	}
 
+	MsgPack serialise_results() const override {
+		return {
+			MetricAvg::serialise_results(),
+			_min_metric.serialise_results(),
+			_max_metric.serialise_results(),
+		};
+	}
+
+	void merge_results(const MsgPack& results) override {
+		MetricAvg::merge_results(results.at(0));
+		_min_metric.merge_results(results.at(1));
+		_max_metric.merge_results(results.at(2));
+	}
+
 	void _aggregate(long double value) {
 		_min_metric._aggregate(value);
 		_max_metric._aggregate(value);
@@ -924,6 +1241,20 @@ public:
 		return nullptr;
 	}
 
+	MsgPack serialise_results() const override {
+		return {
+			MetricStdDeviation::serialise_results(),
+			_min_metric.serialise_results(),
+			_max_metric.serialise_results(),
+		};
+	}
+
+	void merge_results(const MsgPack& results) override {
+		MetricStdDeviation::merge_results(results.at(0));
+		_min_metric.merge_results(results.at(1));
+		_max_metric.merge_results(results.at(2));
+	}
+
 	void _aggregate(long double value) {
 		_min_metric._aggregate(value);
 		_max_metric._aggregate(value);
@@ -22,6 +22,7 @@
 
 #include "generate_terms.h"
 
+#include <algorithm>          // for std::min
 #include <map>                // for __map_iterator, map, operator!=
 #include <unordered_set>      // for unordered_set
 
@@ -34,6 +35,7 @@
 const char ctype_date    = required_spc_t::get_ctype(FieldType::DATE);
 const char ctype_geo     = required_spc_t::get_ctype(FieldType::GEO);
 const char ctype_integer = required_spc_t::get_ctype(FieldType::INTEGER);
+const char ctype_keyword = required_spc_t::get_ctype(FieldType::KEYWORD);
 
 
 void
@@ -152,6 +154,21 @@ GenerateTerms::geo(Xapian::Document& doc, const std::vector<uint64_t>& accuracy,
 }
 
 
+void
+GenerateTerms::keyword(Xapian::Document& doc, const std::vector<uint64_t>& accuracy, const std::vector<std::string>& acc_prefix, std::string_view value)
+{
+	// Accuracies are the lengths of the prefixes, in ascending order.
+	auto it = acc_prefix.begin();
+	for (const auto& acc : accuracy) {
+		if (acc > value.size()) {
+			break;
+		}
+		doc.add_term(prefixed(value.substr(0, acc), *it, ctype_keyword));
+		++it;
+	}
+}
+
+
 void
 GenerateTerms::integer(Xapian::Document& doc, const std::vector<uint64_t>& accuracy, const std::vector<std::string>& acc_prefix,
 	const std::vector<std::string>& acc_global_prefix, int64_t value)
@@ -301,6 +318,55 @@ GenerateTerms::geo(Xapian::Document& doc, const std::vector<uint64_t>& accuracy,
 }
 
 
+Xapian::Query
+GenerateTerms::keyword(std::string_view start, std::string_view end, const std::vector<uint64_t>& accuracy, const std::vector<std::string>& acc_prefix, Xapian::termcount wqf)
+{
+	Xapian::Query query;
+
+	if (accuracy.empty() || end < start) {
+		return query;
+	}
+
+	// Every value between start and end begins with their common prefix.
+	size_t common = 0;
+	auto size = std::min(start.size(), end.size());
+	while (common < size && start[common] == end[common]) {
+		++common;
+	}
+
+	// Find the first accuracy longer than the common prefix.
+	size_t pos = 0, len = accuracy.size();
+	while (pos < len && accuracy[pos] <= common) {
+		++pos;
+	}
+
+	// If it's just one character longer, the values also begin with the
+	// common prefix followed by a character between start's and end's.
+	if (pos < len && accuracy[pos] == common + 1 && common < start.size()) {
+		auto chr_s = static_cast<unsigned char>(start[common]);
+		auto chr_e = static_cast<unsigned char>(end[common]);
+		if (static_cast<size_t>(chr_e - chr_s) < MAX_TERMS) {
+			const auto& prefix = acc_prefix[pos];
+			std::string term(start.substr(0, common + 1));
+			query = Xapian::Query(prefixed(term, prefix, ctype_keyword), wqf);
+			while (chr_s != chr_e) {
+				term.back() = static_cast<char>(++chr_s);
+				query = Xapian::Query(Xapian::Query::OP_OR, query, Xapian::Query(prefixed(term, prefix, ctype_keyword), wqf));
+			}
+			return query;
+		}
+	}
+
+	// Otherwise, use the longest accuracy within the common prefix.
+	if (pos > 0) {
+		--pos;
+		query = Xapian::Query(prefixed(start.substr(0, accuracy[pos]), acc_prefix[pos], ctype_keyword), wqf);
+	}
+
+	return query;
+}
+
+
 Xapian::Query
 GenerateTerms::date(double start_, double end_, const std::vector<uint64_t>& accuracy, const std::vector<std::string>& acc_prefix, Xapian::termcount wqf)
 {
@@ -25,6 +25,7 @@
 #include <cstdint>           // for uint64_t
 #include <stddef.h>          // for size_t
 #include <string>            // for string
+#include "string_view.hh"    // for std::string_view
 #include <sys/types.h>       // for uint64_t, int64_t
 #include <type_traits>       // for decay_t, enable_if_t, is_integral
 #include <vector>            // for vector, allocator
@@ -43,6 +44,7 @@ constexpr size_t MAX_SERIALISE_LENGTH = 18;
 extern const char ctype_date;
 extern const char ctype_geo;
 extern const char ctype_integer;
+extern const char ctype_keyword;
 
 
 // Returns the upper bound's length given the prefix's length, number of unions and union's length.
@@ -61,6 +63,7 @@ namespace GenerateTerms {
 	void positive(Xapian::Document& doc, const std::vector<uint64_t>& accuracy, const std::vector<std::string>& acc_prefix, uint64_t value);
 	void date(Xapian::Document& doc, const std::vector<uint64_t>& accuracy, const std::vector<std::string>& acc_prefix, const Datetime::tm_t& tm);
 	void geo(Xapian::Document& doc, const std::vector<uint64_t>& accuracy, const std::vector<std::string>& acc_prefix, const std::vector<range_t>& ranges);
+	void keyword(Xapian::Document& doc, const std::vector<uint64_t>& accuracy, const std::vector<std::string>& acc_prefix, std::string_view value);
 
 
 	/*
@@ -188,6 +191,11 @@ namespace GenerateTerms {
 		return query;
 	}
 
+	/*
+	 * Generate terms for keyword ranges.
+	 */
+	Xapian::Query keyword(std::string_view start, std::string_view end, const std::vector<uint64_t>& accuracy, const std::vector<std::string>& acc_prefix, Xapian::termcount wqf=1);
+
 	/*
 	 * Generate Terms for date ranges.
 	 */
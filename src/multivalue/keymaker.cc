@@ -26,6 +26,8 @@
 
 #include "exception.h"          // for InvalidArgumentError, MSG_I...
 #include "geospatial/ewkt.h"    // for EWKT
+#include "length.h"             // for serialise_length
+#include "sort_keys_cache.h"    // for sort_keys_cache, SortKeysColumn
 
 
 std::string
@@ -522,21 +524,24 @@ Multi_MultiValueKeyMaker::operator()(const Xapian::Document& doc) const
 		return result;
 	}
 
-	auto i = slots.begin();
-	while (true) {
+	auto did = doc.get_docid();
+	auto size = slots.size();
+	for (size_t idx = 0; idx < size; ++idx) {
+		// Use the ready-made key for the slot, if there is one.
+		auto column = idx < columns.size() ? columns[idx].get() : nullptr;
+		if (column != nullptr && column->get(did, result)) {
+			continue;
+		}
+		auto start = result.size();
+
+		const auto& slot = slots[idx];
 		// All values (except for the last if it's sorted forwards) need to
 		// be adjusted.
-		auto reverse_sort = (*i)->get_reverse();
+		auto reverse_sort = slot->get_reverse();
 		// Select The most representative value to create the key.
-		auto v = reverse_sort ? (*i)->findBiggest(doc) : (*i)->findSmallest(doc);
+		auto v = reverse_sort ? slot->findBiggest(doc) : slot->findSmallest(doc);
 		// RULE: v is never empty, because if there is not value in the slot v is MAX_CMPVALUE or STR_FOR_EMPTY.
 
-		if (++i == slots.end() && !reverse_sort) {
-			// No need to adjust the last value if it's sorted forwards.
-			result += v;
-			break;
-		}
-
 		if (reverse_sort) {
 			// For a reverse ordered value, we subtract each byte from '\xff',
 			// except for '\0' which we convert to "\xff\0".  We insert
@@ -547,7 +552,9 @@ Multi_MultiValueKeyMaker::operator()(const Xapian::Document& doc) const
 				if (ch == 0) result += '\0';
 			}
 			result.append("\xff\xff", 2);
-			if (i == slots.end()) break;
+		} else if (idx + 1 == size) {
+			// No need to adjust the last value if it's sorted forwards.
+			result += v;
 		} else {
 			// For a forward ordered value (unless it's the last value), we
 			// convert any '\0' to "\0\xff".  We insert "\0\0" after the
@@ -562,7 +569,38 @@ Multi_MultiValueKeyMaker::operator()(const Xapian::Document& doc) const
 			result.append(v, j, std::string::npos);
 			result.append("\0", 2);
 		}
+
+		if (column != nullptr) {
+			column->set(did, std::string_view(result).substr(start));
+		}
 	}
 
 	return result;
 }
+
+
+void
+Multi_MultiValueKeyMaker::use_columns(std::string_view database, std::string_view revision)
+{
+	auto& cache = sort_keys_cache();
+	if (!cache) {
+		return;
+	}
+
+	columns.clear();
+	auto size = slots.size();
+	for (size_t idx = 0; idx < size; ++idx) {
+		const auto& slot = slots[idx];
+		if (!slot->cacheable()) {
+			columns.emplace_back();
+			continue;
+		}
+		// Keys are encoded differently depending on the direction of the
+		// sort and on whether it's the last slot, so that's in the column key.
+		char kind = slot->get_reverse() ? 'r' : idx + 1 == size ? 'l' : 'f';
+		std::string key(database);
+		key.append(serialise_length(slot->get_slot()));
+		key.push_back(kind);
+		columns.push_back(cache->get(key, std::string(revision)));
+	}
+}
@@ -53,6 +53,7 @@ const std::string MIN_STR_CMPVALUE("\x00");
 
 
 class Multi_MultiValueKeyMaker;
+class SortKeysColumn;
 
 
 using dispatch_str_metric = void (Multi_MultiValueKeyMaker::*)(const required_spc_t&, bool, std::string_view, const query_field_t&);
@@ -75,6 +76,15 @@ public:
 		return _reverse;
 	}
 
+	Xapian::valueno get_slot() const noexcept {
+		return _slot;
+	}
+
+	// Whether keys depend only on the document (so they can be reused).
+	virtual bool cacheable() const noexcept {
+		return false;
+	}
+
 	virtual std::string findSmallest(const Xapian::Document& doc) const = 0;
 	virtual std::string findBiggest(const Xapian::Document& doc) const = 0;
 };
@@ -86,6 +96,10 @@ public:
 	SerialiseKey(Xapian::valueno slot, bool reverse)
 		: BaseKey(slot, reverse) { }
 
+	bool cacheable() const noexcept override {
+		return true;
+	}
+
 	std::string findSmallest(const Xapian::Document& doc) const override;
 	std::string findBiggest(const Xapian::Document& doc) const override;
 };
@@ -249,6 +263,9 @@ class Multi_MultiValueKeyMaker : public Xapian::KeyMaker {
 	// Vector of slots
 	std::vector<std::unique_ptr<BaseKey>> slots;
 
+	// Columns of ready-made keys for each slot (null for slots which can't be reused).
+	std::vector<std::shared_ptr<SortKeysColumn>> columns;
+
 public:
 	Multi_MultiValueKeyMaker() = default;
 
@@ -259,6 +276,9 @@ public:
 	virtual std::string operator()(const Xapian::Document& doc) const override;
 	void add_value(const required_spc_t& field_spc, bool reverse, std::string_view value, const query_field_t& qf);
 
+	// Reuse keys from the sort keys cache, valid only while database is at revision.
+	void use_columns(std::string_view database, std::string_view revision);
+
 	void levenshtein(const required_spc_t& field_spc, bool reverse, std::string_view value, const query_field_t& qf) {
 		slots.push_back(std::make_unique<StringKey<Levenshtein>>(field_spc.slot, reverse, value, qf.icase));
 	}
@@ -30,7 +30,7 @@
 #include "cast.h"                   // for Cast
 #include "datetime.h"               // for timestamp
 #include "exception.h"              // for MSG_QueryParserError, Quer...
-#include "generate_terms.h"         // for date, geo, numeric
+#include "generate_terms.h"         // for date, geo, keyword, numeric
 #include "geospatialrange.h"        // for GeoSpatialRange
 #include "length.h"                 // for serialise_length
 #include "query_dsl.h"              // for QUERYDSL_FROM, QUERYDSL_TO
@@ -100,8 +100,12 @@ Xapian::Query getStringQuery(const required_spc_t& field_spc, std::string&& star
 		return Xapian::Query();
 	}
 
+	auto query = GenerateTerms::keyword(start_s, end_s, field_spc.accuracy, field_spc.acc_prefix);
 	auto mvr = new MultipleValueRange(field_spc.slot, std::move(start_s), std::move(end_s));
-	return Xapian::Query(mvr->release());
+	if (query.empty()) {
+		return Xapian::Query(mvr->release());
+	}
+	return Xapian::Query(Xapian::Query::OP_AND, query, Xapian::Query(mvr->release()));
 }
 
 
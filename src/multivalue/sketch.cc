@@ -0,0 +1,270 @@
+/*
+ * Copyright (C) 2019 Dubalu LLC. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "sketch.h"
+
+#include <algorithm>                // for std::sort, std::nth_element, std::min, std::max
+#include <cmath>                    // for std::asin, std::sin
+#include <functional>               // for std::greater
+#include <limits>                   // for std::numeric_limits
+
+#include "multivalue/exception.h"   // for AggregationError, MSG_AggregationError
+
+
+constexpr long double PI = 3.141592653589793238462643383279502884L;
+
+
+TDigest::TDigest(long double compression)
+	: _compression{compression},
+	  _buffer_size{static_cast<size_t>(compression) * 5},
+	  _total{0},
+	  _min{std::numeric_limits<long double>::infinity()},
+	  _max{-std::numeric_limits<long double>::infinity()}
+{
+	_buffer.reserve(_buffer_size);
+}
+
+
+void
+TDigest::add(long double mean, long double weight)
+{
+	_buffer.push_back({ mean, weight });
+	_total += weight;
+	_min = std::min(_min, mean);
+	_max = std::max(_max, mean);
+	if (_buffer.size() >= _buffer_size) {
+		compress();
+	}
+}
+
+
+void
+TDigest::compress()
+{
+	if (_buffer.empty()) {
+		return;
+	}
+
+	_buffer.insert(_buffer.end(), _centroids.begin(), _centroids.end());
+	std::sort(_buffer.begin(), _buffer.end(), [](const Centroid& a, const Centroid& b) {
+		return a.mean < b.mean;
+	});
+
+	// k1 scale function: centroids near the tails are kept small.
+	auto k = [&](long double q) {
+		return _compression / (2 * PI) * std::asin(2 * q - 1);
+	};
+	auto q = [&](long double k) {
+		return (std::sin(std::min(k * 2 * PI / _compression, PI / 2)) + 1) / 2;
+	};
+
+	_centroids.clear();
+	long double so_far = 0;
+	auto current = _buffer.front();
+	auto limit = _total * q(k(0) + 1);
+	for (auto it = _buffer.begin() + 1; it != _buffer.end(); ++it) {
+		if (so_far + current.weight + it->weight <= limit) {
+			current.weight += it->weight;
+			current.mean += (it->mean - current.mean) * it->weight / current.weight;
+		} else {
+			so_far += current.weight;
+			_centroids.push_back(current);
+			current = *it;
+			limit = _total * q(k(so_far / _total) + 1);
+		}
+	}
+	_centroids.push_back(current);
+
+	_buffer.clear();
+}
+
+
+long double
+TDigest::quantile(long double p)
+{
+	compress();
+
+	if (_centroids.empty()) {
+		return 0;
+	}
+	if (_centroids.size() == 1) {
+		return _centroids.front().mean;
+	}
+
+	auto target = std::min(std::max(p, 0.0L), 1.0L) * _total;
+
+	// Interpolate between the centers of the adjacent centroids,
+	// using the exact minimum and maximum at the ends.
+	const auto& first = _centroids.front();
+	if (target < first.weight / 2) {
+		return _min + (first.mean - _min) * target / (first.weight / 2);
+	}
+	long double cumulative = first.weight / 2;
+	for (size_t i = 1; i < _centroids.size(); ++i) {
+		const auto& left = _centroids[i - 1];
+		const auto& right = _centroids[i];
+		auto gap = (left.weight + right.weight) / 2;
+		if (target < cumulative + gap) {
+			return left.mean + (right.mean - left.mean) * (target - cumulative) / gap;
+		}
+		cumulative += gap;
+	}
+	const auto& last = _centroids.back();
+	auto tail = last.weight / 2;
+	return last.mean + (_max - last.mean) * std::min((target - cumulative) / tail, 1.0L);
+}
+
+
+MsgPack
+TDigest::serialise() const
+{
+	// The exact minimum and maximum travel along with the centroids,
+	// so merged digests still interpolate the tails against them.
+	MsgPack centroids(MsgPack::Type::ARRAY);
+	for (const auto& centroid : _centroids) {
+		centroids.append(MsgPack({
+			static_cast<double>(centroid.mean),
+			static_cast<double>(centroid.weight),
+		}));
+	}
+	for (const auto& centroid : _buffer) {
+		centroids.append(MsgPack({
+			static_cast<double>(centroid.mean),
+			static_cast<double>(centroid.weight),
+		}));
+	}
+	return {
+		serialise_long_double(_min),
+		serialise_long_double(_max),
+		centroids,
+	};
+}
+
+
+void
+TDigest::merge(const MsgPack& serialised)
+{
+	if (!serialised.is_array() || serialised.size() != 3 || !serialised.at(2).is_array()) {
+		THROW(AggregationError, "Bad serialised t-digest");
+	}
+	const auto& centroids = serialised.at(2);
+	for (const auto& centroid : centroids) {
+		if (!centroid.is_array() || centroid.size() != 2) {
+			THROW(AggregationError, "Bad serialised t-digest centroid");
+		}
+		add(centroid.at(0).as_f64(), centroid.at(1).as_f64());
+	}
+	if (!centroids.empty()) {
+		_min = std::min(_min, unserialise_long_double(serialised.at(0)));
+		_max = std::max(_max, unserialise_long_double(serialised.at(1)));
+	}
+}
+
+
+FrequentItems::FrequentItems(size_t counters)
+	: _counters{std::max(counters, static_cast<size_t>(1))}
+{
+	_counts.reserve(_counters * 2);
+}
+
+
+void
+FrequentItems::add(long double value, size_t count)
+{
+	_counts[value] += count;
+	// Pruning is deferred until there are twice as many counters
+	// as needed, so it's amortised over many added values.
+	if (_counts.size() >= _counters * 2) {
+		prune();
+	}
+}
+
+
+void
+FrequentItems::prune()
+{
+	if (_counts.size() <= _counters) {
+		return;
+	}
+
+	// Subtract the (counters + 1)-th largest count from every counter
+	// and drop the ones left at zero, this keeps at most `counters`.
+	std::vector<size_t> counts;
+	counts.reserve(_counts.size());
+	for (const auto& item : _counts) {
+		counts.push_back(item.second);
+	}
+	std::nth_element(counts.begin(), counts.begin() + _counters, counts.end(), std::greater<size_t>());
+	auto decrement = counts[_counters];
+
+	for (auto it = _counts.begin(); it != _counts.end();) {
+		if (it->second <= decrement) {
+			it = _counts.erase(it);
+		} else {
+			it->second -= decrement;
+			++it;
+		}
+	}
+}
+
+
+std::pair<long double, size_t>
+FrequentItems::most_frequent() const
+{
+	std::pair<long double, size_t> most{ 0, 0 };
+	for (const auto& item : _counts) {
+		if (item.second > most.second || (item.second == most.second && item.first < most.first)) {
+			most = item;
+		}
+	}
+	return most;
+}
+
+
+MsgPack
+FrequentItems::serialise() const
+{
+	MsgPack items(MsgPack::Type::ARRAY);
+	for (const auto& item : _counts) {
+		items.append(MsgPack({
+			serialise_long_double(item.first),
+			item.second,
+		}));
+	}
+	return items;
+}
+
+
+void
+FrequentItems::merge(const MsgPack& serialised)
+{
+	if (!serialised.is_array()) {
+		THROW(AggregationError, "Bad serialised frequent items");
+	}
+	for (const auto& item : serialised) {
+		if (!item.is_array() || item.size() != 2) {
+			THROW(AggregationError, "Bad serialised frequent item");
+		}
+		_counts[unserialise_long_double(item.at(0))] += item.at(1).as_u64();
+	}
+	prune();
+}
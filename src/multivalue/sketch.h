@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2019 Dubalu LLC. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstddef>                  // for size_t
+#include <cstdio>                   // for std::snprintf
+#include <cstdlib>                  // for std::strtold
+#include <string>                   // for std::string
+#include <unordered_map>            // for std::unordered_map
+#include <utility>                  // for std::pair
+#include <vector>                   // for std::vector
+
+#include "msgpack.h"                // for MsgPack
+
+
+// Partial results travel between shards as hex-float strings so merging
+// long double accumulators doesn't round them through double.
+inline MsgPack serialise_long_double(long double value) {
+	char buf[64];
+	auto len = std::snprintf(buf, sizeof(buf), "%La", value);
+	return std::string(buf, len);
+}
+
+
+inline long double unserialise_long_double(const MsgPack& obj) {
+	if (obj.is_string()) {
+		return std::strtold(obj.str().c_str(), nullptr);
+	}
+	return obj.as_f64();
+}
+
+
+/*
+ * Merging t-digest (Dunning & Ertl) for approximate quantiles.
+ *
+ * Values are summarised in centroids (mean and weight) whose size is
+ * bounded by the k1 scale function, so memory is O(compression) no matter
+ * how many values are added, while quantiles near the tails stay accurate.
+ * Digests can be serialised and merged with each other.
+ */
+class TDigest {
+	struct Centroid {
+		long double mean;
+		long double weight;
+	};
+
+	long double _compression;
+	size_t _buffer_size;
+
+	std::vector<Centroid> _centroids;
+	std::vector<Centroid> _buffer;
+
+	long double _total;
+	long double _min;
+	long double _max;
+
+	void add(long double mean, long double weight);
+	void compress();
+
+public:
+	explicit TDigest(long double compression = 100);
+
+	void add(long double value) {
+		add(value, 1);
+	}
+
+	long double quantile(long double q);
+
+	long double size() const noexcept {
+		return _total;
+	}
+
+	MsgPack serialise() const;
+	void merge(const MsgPack& serialised);
+};
+
+
+/*
+ * Misra-Gries summary for approximate heavy hitters (frequent values).
+ *
+ * Keeps at most `counters` values, any value seen more than n / counters
+ * times is guaranteed to be in the summary (with its count underestimated
+ * by at most n / counters). Summaries can be serialised and merged.
+ */
+class FrequentItems {
+	size_t _counters;
+
+	std::unordered_map<long double, size_t> _counts;
+
+	void prune();
+
+public:
+	explicit FrequentItems(size_t counters = 100);
+
+	void add(long double value, size_t count = 1);
+
+	bool empty() const noexcept {
+		return _counts.empty();
+	}
+
+	size_t size() const noexcept {
+		return _counts.size();
+	}
+
+	size_t count(long double value) const {
+		auto it = _counts.find(value);
+		return it == _counts.end() ? 0 : it->second;
+	}
+
+	std::pair<long double, size_t> most_frequent() const;
+
+	MsgPack serialise() const;
+	void merge(const MsgPack& serialised);
+};
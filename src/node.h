@@ -63,7 +63,10 @@ public:
 
 	mutable std::atomic_llong touched;
 
-	Node() : _addr{}, idx{0}, http_port{0}, binary_port{0}, replication_port{0}, touched{0} { }
+	// Reads routed to this node (by the local node) still in flight.
+	mutable std::atomic_size_t reading;
+
+	Node() : _addr{}, idx{0}, http_port{0}, binary_port{0}, replication_port{0}, touched{0}, reading{0} { }
 
 	// Move constructor
 	Node(Node&& other)
@@ -75,7 +78,8 @@ public:
 		  http_port{std::move(other.http_port)},
 		  binary_port{std::move(other.binary_port)},
 		  replication_port{std::move(other.replication_port)},
-		  touched{other.touched.load(std::memory_order_relaxed)} { }
+		  touched{other.touched.load(std::memory_order_relaxed)},
+		  reading{other.reading.load(std::memory_order_relaxed)} { }
 
 	// Copy Constructor
 	Node(const Node& other)
@@ -87,7 +91,8 @@ public:
 		  http_port{other.http_port},
 		  binary_port{other.binary_port},
 		  replication_port{other.replication_port},
-		  touched{other.touched.load(std::memory_order_relaxed)} { }
+		  touched{other.touched.load(std::memory_order_relaxed)},
+		  reading{other.reading.load(std::memory_order_relaxed)} { }
 
 	// Move assignment
 	Node& operator=(Node&& other) {
@@ -100,6 +105,7 @@ public:
 		binary_port = std::move(other.binary_port);
 		replication_port = std::move(other.replication_port);
 		touched = other.touched.load(std::memory_order_relaxed);
+		reading = other.reading.load(std::memory_order_relaxed);
 		return *this;
 	}
 
@@ -114,6 +120,7 @@ public:
 		binary_port = other.binary_port;
 		replication_port = other.replication_port;
 		touched = other.touched.load(std::memory_order_relaxed);
+		reading = other.reading.load(std::memory_order_relaxed);
 		return *this;
 	}
 
@@ -127,6 +134,7 @@ public:
 		binary_port = 0;
 		replication_port = 0;
 		touched.store(0, std::memory_order_relaxed);
+		reading.store(0, std::memory_order_relaxed);
 	}
 
 	bool empty() const noexcept {
@@ -38,13 +38,22 @@
 #define NUM_ASYNC_WAL_WRITERS    1       // Number of database async WAL writers per CPU
 #define NUM_COMMITTERS           1       // Number of threads handling the commits per CPU
 #define NUM_FSYNCHERS            1       // Number of threads handling the fsyncs per CPU
+#define NUM_SCRUBBERS            0       // Number of threads scrubbing data storage volumes per CPU (0 disables)
+#define SCRUB_RATE               16777216 // Maximum bytes per second each scrubber thread reads
+#define NUM_SHARD_SEARCHERS      0       // Number of threads searching shards in parallel per CPU (0 disables)
+#define NUM_BULK_PREPARERS       4       // Number of threads preparing bulk operations per CPU (0 disables)
+#define WAL_GROUP_COMMIT_DELAY   1       // Maximum milliseconds a WAL group commit waits for more lines
+#define WAL_GROUP_COMMIT_BYTES   4194304 // Maximum WAL bytes written per group commit
 
 #define DBPOOL_SIZE              300     // Maximum number of database endpoints in database pool
+#define QUERY_CACHE_SIZE         1000    // Maximum number of search results in the query cache (0 disables)
+#define SORT_KEYS_CACHE_SIZE     268435456 // Maximum bytes of ready-made sort keys (0 disables)
 #define MAX_CLIENTS              1000    // Maximum number of open client connections
 #define MAX_DATABASES            400     // Maximum number of open databases
 #define FLUSH_THRESHOLD          100000  // Database flush threshold (default for xapian is 10000)
 #define ENDPOINT_LIST_SIZE       10      // Endpoints List's size
 #define NUM_REPLICAS             3       // Default number of database replicas per index
+#define READ_ROUTING             "first" // Policy for choosing the replica that serves reads
 
 
 extern struct opts_t {
@@ -79,7 +88,15 @@ extern struct opts_t {
 	ssize_t num_async_wal_writers = std::ceil(NUM_ASYNC_WAL_WRITERS);
 	ssize_t num_committers = std::ceil(NUM_COMMITTERS);
 	ssize_t num_fsynchers = std::ceil(NUM_FSYNCHERS);
+	ssize_t num_scrubbers = std::ceil(NUM_SCRUBBERS);
+	std::size_t scrub_rate = SCRUB_RATE;
+	ssize_t num_shard_searchers = std::ceil(NUM_SHARD_SEARCHERS);
+	ssize_t num_bulk_preparers = std::ceil(NUM_BULK_PREPARERS);
+	std::size_t wal_group_commit_delay = WAL_GROUP_COMMIT_DELAY;
+	std::size_t wal_group_commit_bytes = WAL_GROUP_COMMIT_BYTES;
 	ssize_t dbpool_size = DBPOOL_SIZE;
+	ssize_t query_cache_size = QUERY_CACHE_SIZE;
+	ssize_t sort_keys_cache_size = SORT_KEYS_CACHE_SIZE;
 	ssize_t endpoints_list_size = ENDPOINT_LIST_SIZE;
 	ssize_t max_clients = MAX_CLIENTS;
 	ssize_t max_databases = MAX_DATABASES;
@@ -95,6 +112,8 @@ extern struct opts_t {
 	std::string restore = "";
 	std::string filename = "";
 	std::size_t num_replicas = NUM_REPLICAS;
+	bool replica_compression = false;
+	std::uint32_t read_routing = 0;
 	bool iterm2 = false;
 	bool log_epoch = false;
 	bool log_iso8601 = false;
@@ -173,17 +173,50 @@ Summary::Summary(const Quantiles& quantiles,
       sum_(0),
       quantile_values_(quantiles_, max_age_seconds, age_buckets) {}
 
-void Summary::Observe(double value) {
+std::size_t Summary::StripeIndex() {
+  static std::atomic<std::size_t> next_index{0};
+  thread_local std::size_t index =
+      next_index.fetch_add(1, std::memory_order_relaxed) % kStripes;
+  return index;
+}
+
+void Summary::Flush(const std::vector<double>& values) {
   std::lock_guard<std::mutex> lock(mutex_);
 
-  count_ += 1;
-  sum_ += value;
-  quantile_values_.insert(value);
+  for (auto value : values) {
+    count_ += 1;
+    sum_ += value;
+    quantile_values_.insert(value);
+  }
+}
+
+void Summary::Observe(double value) {
+  auto& stripe = stripes_[StripeIndex()];
+
+  std::unique_lock<std::mutex> stripe_lock(stripe.mutex);
+  stripe.values.push_back(value);
+  if (stripe.values.size() < kStripeCapacity) return;
+
+  std::vector<double> values;
+  values.reserve(kStripeCapacity);
+  values.swap(stripe.values);
+  stripe_lock.unlock();
+
+  Flush(values);
 }
 
 ClientMetric Summary::Collect() {
   auto metric = ClientMetric{};
 
+  for (auto& stripe : stripes_) {
+    std::vector<double> values;
+    {
+      std::lock_guard<std::mutex> stripe_lock(stripe.mutex);
+      values.swap(stripe.values);
+    }
+    Flush(values);
+  }
+
   std::lock_guard<std::mutex> lock(mutex_);
 
   for (const auto& quantile : quantiles_) {
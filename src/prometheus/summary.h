@@ -92,8 +92,25 @@ class Summary {
   ClientMetric Collect();
 
  private:
+  // Observations are buffered in per-thread stripes (each thread always
+  // lands in the same one) and only fed to the quantiles when a stripe
+  // fills up or the summary is collected, so threads observing at the
+  // same time don't contend on mutex_.
+  static constexpr std::size_t kStripes = 16;
+  static constexpr std::size_t kStripeCapacity = 256;
+
+  struct alignas(64) Stripe {
+    std::mutex mutex;
+    std::vector<double> values;
+  };
+
+  static std::size_t StripeIndex();
+  void Flush(const std::vector<double>& values);
+
   const Quantiles quantiles_;
 
+  std::array<Stripe, kStripes> stripes_;
+
   std::mutex mutex_;
 
   double count_;
@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2019 Dubalu LLC. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "query_cache.h"
+
+#include <algorithm>              // for std::sort
+#include <string_view>            // for std::string_view
+#include <utility>                // for std::pair
+#include <vector>                 // for std::vector
+
+#include "length.h"               // for serialise_string
+#include "log.h"                  // for L_CALL
+#include "metrics.h"              // for Metrics::metrics
+#include "repr.hh"                // for repr
+
+
+void
+QueryCache::canonicalise(std::string& key, const MsgPack& obj)
+{
+	switch (obj.getType()) {
+		case MsgPack::Type::MAP: {
+			std::vector<std::pair<std::string_view, const MsgPack*>> items;
+			items.reserve(obj.size());
+			const auto it_end = obj.end();
+			for (auto it = obj.begin(); it != it_end; ++it) {
+				items.emplace_back(it->str_view(), &it.value());
+			}
+			std::sort(items.begin(), items.end(), [](const auto& a, const auto& b) {
+				return a.first < b.first;
+			});
+			key.push_back('{');
+			for (const auto& item : items) {
+				key.append(serialise_string(item.first));
+				canonicalise(key, *item.second);
+			}
+			key.push_back('}');
+			break;
+		}
+		case MsgPack::Type::ARRAY: {
+			key.push_back('[');
+			for (size_t i = 0; i < obj.size(); ++i) {
+				canonicalise(key, obj.at(i));
+			}
+			key.push_back(']');
+			break;
+		}
+		default:
+			key.append(serialise_string(obj.serialise()));
+			break;
+	}
+}
+
+
+std::shared_ptr<const cached_query_t>
+QueryCache::get(const std::string& key, const std::string& revision)
+{
+	L_CALL("QueryCache::get(%s, %s)", repr(key), repr(revision));
+
+	std::shared_ptr<const cached_query_t> cached;
+	{
+		std::lock_guard<std::mutex> lk(mtx);
+		auto it = find(key);
+		if (it != end()) {
+			cached = it->second;
+		}
+	}
+
+	// Entries computed at any other revision are just stale,
+	// they get replaced once the query is computed again.
+	if (cached && cached->revision == revision) {
+		Metrics::metrics()
+			.xapiand_query_cache_hits
+			.Increment();
+		return cached;
+	}
+
+	Metrics::metrics()
+		.xapiand_query_cache_misses
+		.Increment();
+	return nullptr;
+}
+
+
+void
+QueryCache::set(const std::string& key, std::shared_ptr<const cached_query_t> cached)
+{
+	L_CALL("QueryCache::set(%s, <cached>)", repr(key));
+
+	size_t evicted = 0;
+	{
+		std::lock_guard<std::mutex> lk(mtx);
+		insert_and([&](const std::shared_ptr<const cached_query_t>&, ssize_t size, ssize_t max_size) {
+			if (size > max_size) {
+				++evicted;
+				return lru::DropAction::evict;
+			}
+			return lru::DropAction::stop;
+		}, std::make_pair(key, std::move(cached)));
+	}
+
+	if (evicted != 0) {
+		Metrics::metrics()
+			.xapiand_query_cache_evictions
+			.Increment(evicted);
+	}
+}
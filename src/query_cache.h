@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2019 Dubalu LLC. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <memory>                 // for std::shared_ptr, std::unique_ptr
+#include <mutex>                  // for std::mutex
+#include <string>                 // for std::string
+
+#include "database_handler.h"     // for MSet
+#include "lru.h"                  // for lru::LRU
+#include "msgpack.h"              // for MsgPack
+#include "opts.h"                 // for opts::*
+
+
+// A cached search result: the revision tag (the revision of every shard)
+// it was computed at, its matches and its serialised aggregation results.
+struct cached_query_t {
+	std::string revision;
+	MSet mset;
+	std::string aggregations;
+
+	cached_query_t(std::string revision_, MSet mset_, std::string aggregations_) :
+		revision{std::move(revision_)},
+		mset{std::move(mset_)},
+		aggregations{std::move(aggregations_)} { }
+};
+
+
+class QueryCache : lru::LRU<std::string, std::shared_ptr<const cached_query_t>> {
+	std::mutex mtx;
+
+public:
+	QueryCache(ssize_t max_size)
+		: LRU(max_size) { }
+
+	// Appends obj to key so that equivalent objects (those only differing
+	// in the order of their map keys) end up with the very same key.
+	static void canonicalise(std::string& key, const MsgPack& obj);
+
+	std::shared_ptr<const cached_query_t> get(const std::string& key, const std::string& revision);
+	void set(const std::string& key, std::shared_ptr<const cached_query_t> cached);
+};
+
+
+inline auto& query_cache(bool create = true) {
+	static auto query_cache = create && opts.query_cache_size ? std::make_unique<QueryCache>(opts.query_cache_size) : nullptr;
+	return query_cache;
+}
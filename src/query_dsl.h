@@ -43,6 +43,7 @@ constexpr const char QUERYDSL_TO[]              = "_to";
 constexpr const char QUERYDSL_LIMIT[]           = "_limit";
 constexpr const char QUERYDSL_CHECK_AT_LEAST[]  = "_check_at_least";
 constexpr const char QUERYDSL_OFFSET[]          = "_offset";
+constexpr const char QUERYDSL_AFTER[]           = "_after";
 constexpr const char QUERYDSL_SORT[]            = "_sort";
 constexpr const char QUERYDSL_SELECTOR[]        = "_selector";
 constexpr const char QUERYDSL_ORDER[]           = "_order";
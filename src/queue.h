@@ -343,6 +343,16 @@ namespace queue {
 			element = _items_queue.front();
 			return true;
 		}
+
+		template <typename OutputIt>
+		size_t front(OutputIt first, size_t count) {
+			std::lock_guard<std::mutex> lk(_state->_mutex);
+			size_t copied = 0;
+			for (auto it = _items_queue.begin(); it != _items_queue.end() && copied < count; ++it, ++copied) {
+				*first++ = *it;
+			}
+			return copied;
+		}
 	};
 
 
@@ -33,8 +33,10 @@
 #include <set>                             // for __tree_const_iterator, set
 #include <stdexcept>                       // for out_of_range
 #include <type_traits>                     // for remove_reference<>::type
+#include <unordered_map>                   // for unordered_map
 #include <utility>
 
+#include "atomic_shared_ptr.h"             // for atomic_shared_ptr
 #include "cassert.h"                       // for ASSERT
 #include "cast.h"                          // for Cast
 #include "cuuid/uuid.h"                    // for UUIDGenerator
@@ -2461,6 +2463,73 @@ struct FedSpecification : MsgPack::Data {
 };
 
 
+/*
+ * Index plan: the resolved specification (prefix, slot, accuracy, types...)
+ * of every field of the schema, by field path, as left by feeding the field
+ * and updating its prefixes. It's kept in the root properties of the schema,
+ * so each schema version in the SchemasLRU has its own plan, built as its
+ * fields are first indexed.
+ */
+struct IndexPlanEntry {
+	const MsgPack* properties;
+	specification_t::prefix_t parent_prefix;  // the specification depends on the prefix of the parent
+	specification_t specification;
+
+	IndexPlanEntry(const MsgPack* properties, specification_t::prefix_t parent_prefix, const specification_t& specification)
+		: properties(properties),
+		  parent_prefix(std::move(parent_prefix)),
+		  specification(specification) { }
+};
+
+
+struct IndexPlan : FedSpecification {
+	using Entries = std::unordered_map<std::string, std::shared_ptr<const IndexPlanEntry>>;
+
+	mutable atomic_shared_ptr<const Entries> entries;
+
+	IndexPlan(specification_t  specification)
+		: FedSpecification(std::move(specification)),
+		  entries(std::make_shared<const Entries>()) { }
+
+	// Entries are never removed, they outlive any copy of the map.
+	const IndexPlanEntry* find(const std::string& path) const {
+		const auto current = entries.load();
+		auto it = current->find(path);
+		return it == current->end() ? nullptr : it->second.get();
+	}
+
+	// Entries are copied on write, readers never lock.
+	void add(const std::string& path, std::shared_ptr<const IndexPlanEntry> entry) const {
+		auto current = entries.load();
+		std::shared_ptr<const Entries> updated;
+		do {
+			if (current->count(path) != 0u) {
+				return;
+			}
+			auto copy = std::make_shared<Entries>(*current);
+			copy->emplace(path, entry);
+			updated = std::move(copy);
+		} while (!entries.compare_exchange_weak(current, updated));
+	}
+};
+
+
+// Reserved words all start with an underscore (see is_valid()),
+// any other key of an object is a field.
+static inline bool
+has_reserved_words(const MsgPack& object)
+{
+	const auto it_e = object.end();
+	for (auto it = object.begin(); it != it_e; ++it) {
+		auto str_key = it->str_view();
+		if (!str_key.empty() && str_key[0] == '_') {
+			return true;
+		}
+	}
+	return false;
+}
+
+
 template <typename T>
 inline bool
 Schema::feed_subproperties(T& properties, std::string_view meta_name)
@@ -2506,6 +2575,97 @@ Schema::feed_subproperties(T& properties, std::string_view meta_name)
 }
 
 
+inline void
+Schema::feed_root_properties(const MsgPack& properties)
+{
+	L_CALL("Schema::feed_root_properties(%s)", repr(properties.to_string()));
+
+	// The root properties are fed for every single document, so the fed
+	// specification is cached in them just like feed_subproperties() does
+	// for every field, along with the index plan of the schema. Only
+	// unmodified (shared) schemas are cached, the properties of mut_schema
+	// can still change under the cache.
+	index_plan.reset();
+	if (mut_schema) {
+		dispatch_feed_properties(properties);
+		return;
+	}
+
+	auto data = std::static_pointer_cast<const IndexPlan>(properties.get_data());
+	if (data) {
+		specification = data->specification;
+		index_plan = std::move(data);
+		return;
+	}
+
+	dispatch_feed_properties(properties);
+
+	index_plan = std::make_shared<const IndexPlan>(specification);
+	properties.set_data(index_plan);
+}
+
+
+inline bool
+Schema::feed_planned_subproperties(const MsgPack*& properties, std::string_view field_name, const MsgPack* object, FieldVector* fields)
+{
+	L_CALL("Schema::feed_planned_subproperties(%s, %s, %s, <fields>)", repr(properties->to_string()), repr(field_name), object != nullptr ? repr(object->to_string()) : "nullptr");
+
+	// Reserved words in the object change the specification of the field
+	// for this document only, so those objects are always dispatched.
+	bool planned = index_plan && !mut_schema && (object == nullptr || !has_reserved_words(*object));
+
+	specification_t::prefix_t parent_prefix;
+	if (planned) {
+		index_plan_path.assign(specification.full_meta_name);
+		if (!index_plan_path.empty()) {
+			index_plan_path.push_back(DB_OFFSPRING_UNION);
+		}
+		index_plan_path.append(field_name);
+		const auto entry = index_plan->find(index_plan_path);
+		if (entry != nullptr) {
+			if (entry->parent_prefix.field == specification.prefix.field && entry->parent_prefix.uuid == specification.prefix.uuid) {
+				properties = entry->properties;
+				specification = entry->specification;
+				if (object != nullptr) {
+					const auto it_e = object->end();
+					for (auto it = object->begin(); it != it_e; ++it) {
+						fields->emplace_back(it->str_view(), &it.value());
+					}
+#if defined(XAPIAND_CHAISCRIPT) || defined(XAPIAND_V8)
+					normalize_script();
+#endif
+				}
+				return true;
+			}
+			// Planned under a different prefix (i.e. below a uuid field).
+			planned = false;
+		} else {
+			parent_prefix = specification.prefix;
+		}
+	}
+
+	restart_specification();
+	if (!feed_subproperties(properties, field_name)) {
+		return false;
+	}
+	if (planned) {
+		// Without reserved words the object only brings fields, it doesn't
+		// matter if it's processed after updating the prefixes.
+		update_prefixes();
+		index_plan->add(index_plan_path, std::make_shared<const IndexPlanEntry>(properties, std::move(parent_prefix), specification));
+		if (object != nullptr) {
+			dispatch_process_properties(*object, *fields);
+		}
+	} else {
+		if (object != nullptr) {
+			dispatch_process_properties(*object, *fields);
+		}
+		update_prefixes();
+	}
+	return true;
+}
+
+
 /*  _____ _____ _____ _____ _____ _____ _____ _____
  * |_____|_____|_____|_____|_____|_____|_____|_____|
  *      ___           _
@@ -2536,14 +2696,14 @@ Schema::index(const MsgPack& object,
 		auto properties = &get_newest_properties();
 
 		if (object.empty()) {
-			dispatch_feed_properties(*properties);
+			feed_root_properties(*properties);
 		} else if (properties->empty()) {  // new schemas have empty properties
 			specification.flags.field_found = false;
 			auto mut_properties = &get_mutable_properties();
 			dispatch_write_properties(*mut_properties, object, fields, &id_field);
 			properties = &*mut_properties;
 		} else {
-			dispatch_feed_properties(*properties);
+			feed_root_properties(*properties);
 			dispatch_process_properties(object, fields, &id_field);
 		}
 
@@ -2678,9 +2838,7 @@ Schema::index_subproperties(const MsgPack*& properties, MsgPack*& data, std::str
 			if (!is_valid(field_name) && !(specification.full_meta_name.empty() && has_dispatch_set_default_spc(field_name))) {
 				THROW(ClientError, "Field name: %s (%s) in %s is not valid", repr(name), repr(field_name), repr(specification.full_meta_name));
 			}
-			restart_specification();
-			if (feed_subproperties(properties, field_name)) {
-				update_prefixes();
+			if (feed_planned_subproperties(properties, field_name)) {
 				if (specification.flags.store) {
 					auto inserted = data->insert(field_name);
 					data = &inserted.first.value();
@@ -2740,10 +2898,7 @@ Schema::index_subproperties(const MsgPack*& properties, MsgPack*& data, std::str
 		if (!is_valid(field_name) && !(specification.full_meta_name.empty() && has_dispatch_set_default_spc(field_name))) {
 			THROW(ClientError, "Field name: %s (%s) in %s is not valid", repr(name), repr(field_name), repr(specification.full_meta_name));
 		}
-		restart_specification();
-		if (feed_subproperties(properties, field_name)) {
-			dispatch_process_properties(object, fields);
-			update_prefixes();
+		if (feed_planned_subproperties(properties, field_name, &object, &fields)) {
 			if (specification.flags.store) {
 				auto inserted = data->insert(field_name);
 				if (!inserted.second && pos == 0) {
@@ -2823,9 +2978,7 @@ Schema::index_subproperties(const MsgPack*& properties, MsgPack*& data, std::str
 			if (!is_valid(field_name) && !(specification.full_meta_name.empty() && has_dispatch_set_default_spc(field_name))) {
 				THROW(ClientError, "Field name: %s (%s) in %s is not valid", repr(name), repr(field_name), repr(specification.full_meta_name));
 			}
-			restart_specification();
-			if (feed_subproperties(properties, field_name)) {
-				update_prefixes();
+			if (feed_planned_subproperties(properties, field_name)) {
 				if (specification.flags.store) {
 					auto inserted = data->insert(field_name);
 					data = &inserted.first.value();
@@ -2885,9 +3038,7 @@ Schema::index_subproperties(const MsgPack*& properties, MsgPack*& data, std::str
 		if (!is_valid(field_name) && !(specification.full_meta_name.empty() && has_dispatch_set_default_spc(field_name))) {
 			THROW(ClientError, "Field name: %s (%s) in %s is not valid", repr(name), repr(field_name), repr(specification.full_meta_name));
 		}
-		restart_specification();
-		if (feed_subproperties(properties, field_name)) {
-			update_prefixes();
+		if (feed_planned_subproperties(properties, field_name)) {
 			if (specification.flags.store) {
 				auto inserted = data->insert(field_name);
 				if (!inserted.second && pos == 0) {
@@ -4650,6 +4801,22 @@ Schema::validate_required_data(MsgPack& mut_properties)
 			break;
 		}
 		case FieldType::KEYWORD: {
+			// Accuracy for keywords are the lengths of the prefixes used for ranges.
+			if (specification.doc_acc) {
+				try {
+					for (const auto& _accuracy : *specification.doc_acc) {
+						const auto val_acc = _accuracy.u64();
+						if (val_acc != 0) {
+							set_acc.insert(val_acc);
+						} else {
+							THROW(ClientError, "Data inconsistency, '%s' in '%s' must be an array of positive numbers greater than zero", RESERVED_ACCURACY, KEYWORD_STR);
+						}
+					}
+				} catch (const msgpack::type_error&) {
+					THROW(ClientError, "Data inconsistency, '%s' in '%s' must be an array of positive numbers greater than zero", RESERVED_ACCURACY, KEYWORD_STR);
+				}
+			}
+
 			// Process RESERVED_BOOL_TERM
 			if (!specification.flags.has_bool_term) {
 				// By default, if normalized name has upper characters then it is consider bool term.
@@ -5371,6 +5538,7 @@ Schema::index_value(Xapian::Document& doc, const MsgPack& value, std::set<std::s
 				if (global_spc != nullptr) {
 					index_term(doc, ser_value, *global_spc, pos);
 				}
+				GenerateTerms::keyword(doc, spc.accuracy, spc.acc_prefix, ser_value);
 				s.insert(std::move(ser_value));
 				return;
 			} catch (const msgpack::type_error&) {
@@ -5612,6 +5780,7 @@ Schema::index_all_value(Xapian::Document& doc, const MsgPack& value, std::set<st
 				if (toUType(field_spc.index & TypeIndex::GLOBAL_TERMS) != 0u) {
 					index_term(doc, ser_value, global_spc, pos);
 				}
+				GenerateTerms::keyword(doc, field_spc.accuracy, field_spc.acc_prefix, ser_value);
 				s_f.insert(ser_value);
 				s_g.insert(std::move(ser_value));
 				return;
@@ -5784,6 +5953,11 @@ Schema::dispatch_process_concrete_properties(const MsgPack& object, FieldVector&
 	const auto it_e = object.end();
 	for (auto it = object.begin(); it != it_e; ++it) {
 		auto str_key = it->str_view();
+		if (str_key.empty() || str_key[0] != '_') {
+			// Not a reserved word (see has_reserved_words()).
+			fields.emplace_back(str_key, &it.value());
+			continue;
+		}
 		auto key = hh(str_key);
 		auto &value = it.value();
 		if (!_dispatch_process_concrete_properties(key, str_key, value)) {
@@ -5808,6 +5982,11 @@ Schema::dispatch_process_all_properties(const MsgPack& object, FieldVector& fiel
 	const auto it_e = object.end();
 	for (auto it = object.begin(); it != it_e; ++it) {
 		auto str_key = it->str_view();
+		if (str_key.empty() || str_key[0] != '_') {
+			// Not a reserved word (see has_reserved_words()).
+			fields.emplace_back(str_key, &it.value());
+			continue;
+		}
 		auto key = hh(str_key);
 		auto& value = it.value();
 		if (!_dispatch_process_properties(key, str_key, value)) {
@@ -5826,6 +6005,9 @@ Schema::dispatch_process_all_properties(const MsgPack& object, FieldVector& fiel
 }
 
 
+// Keys of the document object are told apart (reserved words vs. fields)
+// here; objects of fields in the index plan without reserved words don't
+// get here at all (see feed_planned_subproperties()).
 inline void
 Schema::dispatch_process_properties(const MsgPack& object, FieldVector& fields, const MsgPack** id_field)
 {
@@ -8235,7 +8417,8 @@ Schema::consistency_accuracy(std::string_view prop_name, const MsgPack& doc_accu
 			}
 			case FieldType::INTEGER:
 			case FieldType::POSITIVE:
-			case FieldType::FLOAT: {
+			case FieldType::FLOAT:
+			case FieldType::KEYWORD: {
 				try {
 					for (const auto& _accuracy : doc_accuracy) {
 						set_acc.insert(_accuracy.u64());
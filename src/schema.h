@@ -553,6 +553,7 @@ using dispatch_index = void (*)(Xapian::Document&, std::string&&, const specific
 
 
 class DatabaseHandler;
+struct IndexPlan;
 
 
 class Schema {
@@ -577,6 +578,10 @@ class Schema {
 	std::unordered_map<Xapian::valueno, std::set<std::string>> map_values;
 	specification_t specification;
 
+	// Index plan of the (shared) schema and path of the field looked up in it.
+	std::shared_ptr<const IndexPlan> index_plan;
+	std::string index_plan_path;
+
 	/*
 	 * Returns root properties of schema.
 	 */
@@ -643,6 +648,20 @@ class Schema {
 	template <typename T>
 	bool feed_subproperties(T& properties, std::string_view meta_name);
 
+	/*
+	 * Feed the specification with the root properties of schema.
+	 */
+
+	void feed_root_properties(const MsgPack& properties);
+
+	/*
+	 * Restart and feed the specification with the properties of field_name
+	 * (and object, if any) and update its prefixes, from the index plan
+	 * whenever the field was already resolved.
+	 */
+
+	bool feed_planned_subproperties(const MsgPack*& properties, std::string_view field_name, const MsgPack* object = nullptr, FieldVector* fields = nullptr);
+
 	/*
 	 * Main functions to index objects and arrays
 	 */
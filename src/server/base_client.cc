@@ -22,9 +22,12 @@
 
 #include "base_client.h"
 
+#include <algorithm>                // for std::min
+#include <array>                    // for std::array
 #include <errno.h>                  // for errno
 #include <memory>                   // for std::shared_ptr
-#include <sys/socket.h>             // for SHUT_RDWR
+#include <sys/socket.h>             // for SHUT_RDWR, struct msghdr
+#include <sys/uio.h>                // for struct iovec
 #include <sysexits.h>               // for EX_SOFTWARE
 #include <type_traits>              // for remove_reference<>::type
 #include <utility>                  // for std::move
@@ -65,6 +68,13 @@
 constexpr int WRITE_QUEUE_LIMIT = 10;
 constexpr int WRITE_QUEUE_THRESHOLD = WRITE_QUEUE_LIMIT * 2 / 3;
 
+// Maximum number of queued buffers gathered into a single writev().
+constexpr size_t WRITEV_MAX_BUFFERS = WRITE_QUEUE_LIMIT;
+
+// Maximum bytes handed to the kernel in a single sendfile() call, so
+// a huge zero-copy file doesn't hog the event loop for a single client.
+constexpr size_t SENDFILE_CHUNK_SIZE = 1024 * 1024;
+
 
 BaseClient::BaseClient(const std::shared_ptr<Worker>& parent_, ev::loop_ref* ev_loop_, unsigned int ev_flags_, int sock_)
 	: Worker(std::move(parent_), ev_loop_, ev_flags_),
@@ -198,15 +208,37 @@ BaseClient::write_from_queue()
 
 	std::lock_guard<std::mutex> lk(_mutex);
 
-	std::shared_ptr<Buffer> buffer;
-	if (write_queue.front(buffer)) {
-		size_t buf_size = buffer->size();
-		const char *buf_data = buffer->data();
+	std::array<std::shared_ptr<Buffer>, WRITEV_MAX_BUFFERS> buffers;
+	size_t queued = write_queue.front(buffers.begin(), buffers.size());
+	if (queued) {
+		if (buffers[0]->zero_copy()) {
+			return write_from_file(buffers[0]);
+		}
+
+		// Gather as many queued buffers as possible into a single writev(),
+		// file backed buffers are fed by chunks so they end the gathering.
+		std::array<struct iovec, WRITEV_MAX_BUFFERS> iov;
+		size_t iovcnt = 0;
+		for (; iovcnt < queued; ++iovcnt) {
+			auto& buffer = buffers[iovcnt];
+			if (buffer->zero_copy()) {
+				break;
+			}
+			iov[iovcnt].iov_base = const_cast<char*>(buffer->data());
+			iov[iovcnt].iov_len = buffer->size();
+			if (buffer->fd() != -1) {
+				++iovcnt;
+				break;
+			}
+		}
 
 #ifdef MSG_NOSIGNAL
-		ssize_t sent = io::send(sock, buf_data, buf_size, MSG_NOSIGNAL);
+		struct msghdr msg = {};
+		msg.msg_iov = iov.data();
+		msg.msg_iovlen = iovcnt;
+		ssize_t sent = io::sendmsg(sock, &msg, MSG_NOSIGNAL);
 #else
-		ssize_t sent = io::write(sock, buf_data, buf_size);
+		ssize_t sent = io::writev(sock, iov.data(), iovcnt);
 #endif
 
 		if (sent < 0) {
@@ -222,16 +254,30 @@ BaseClient::write_from_queue()
 		}
 
 		total_sent_bytes += sent;
-		L_TCP_WIRE("{sock:%d} <<-- %s (%zu bytes)", sock, repr(buf_data, sent, true, true, 500), sent);
 
-		buffer->remove_prefix(sent);
-		if (buffer->size() == 0) {
-			if (write_queue.pop(buffer)) {
+		// Partial writes: consume the sent bytes buffer by buffer, popping
+		// the ones which got completely sent.
+		size_t remaining = sent;
+		for (size_t i = 0; i < iovcnt; ++i) {
+			auto& buffer = buffers[i];
+			auto consumed = std::min(remaining, iov[i].iov_len);
+			L_TCP_WIRE("{sock:%d} <<-- %s (%zu bytes)", sock, repr(static_cast<const char*>(iov[i].iov_base), consumed, true, true, 500), consumed);
+			buffer->remove_prefix(consumed);
+			remaining -= consumed;
+			if (buffer->size() != 0) {
+				break;
+			}
+			std::shared_ptr<Buffer> popped;
+			if (write_queue.pop(popped)) {
+				ASSERT(popped == buffer);
 				if (write_queue.empty()) {
 					L_CONN("WR:OK: {sock:%d}", sock);
 					return WR::OK;
 				}
 			}
+			if (!remaining) {
+				break;
+			}
 		}
 
 		L_CONN("WR:PENDING: {sock:%d}", sock);
@@ -243,6 +289,58 @@ BaseClient::write_from_queue()
 }
 
 
+WR
+BaseClient::write_from_file(std::shared_ptr<Buffer>& buffer)
+{
+	L_CALL("BaseClient::write_from_file(<buffer>)");
+
+	size_t buf_size = std::min(buffer->size(), SENDFILE_CHUNK_SIZE);
+
+	ssize_t sent = 0;
+	if (buf_size != 0) {
+		sent = io::sendfile(sock, buffer->fd(), buffer->pos, buf_size);
+
+		if (sent < 0) {
+			if (io::ignored_errno(errno, true, true, false)) {
+				L_CONN("WR:RETRY: {sock:%d} - %s (%d): %s", sock, error::name(errno), errno, error::description(errno));
+				return WR::RETRY;
+			}
+
+			L_ERR("ERROR: sendfile error {sock:%d} - %s (%d): %s", sock, error::name(errno), errno, error::description(errno));
+			L_CONN("WR:ERR.2: {sock:%d}", sock);
+			close();
+			return WR::ERROR;
+		}
+
+		if (sent == 0) {
+			// The file was truncated while it was being sent, the peer is
+			// still expecting the announced number of bytes.
+			L_ERR("ERROR: sendfile error {sock:%d}: Unexpected end of file", sock);
+			L_CONN("WR:ERR.3: {sock:%d}", sock);
+			close();
+			return WR::ERROR;
+		}
+
+		total_sent_bytes += sent;
+		L_TCP_WIRE("{sock:%d} <<-- <file:%d> (%zu bytes)", sock, buffer->fd(), sent);
+
+		buffer->remove_prefix(sent);
+	}
+
+	if (buffer->size() == 0) {
+		if (write_queue.pop(buffer)) {
+			if (write_queue.empty()) {
+				L_CONN("WR:OK: {sock:%d}", sock);
+				return WR::OK;
+			}
+		}
+	}
+
+	L_CONN("WR:PENDING: {sock:%d}", sock);
+	return WR::PENDING;
+}
+
+
 WR
 BaseClient::write_from_queue(int max)
 {
@@ -402,3 +500,15 @@ BaseClient::read_file()
 	file_size = -1;
 	receive_checksum = false;
 }
+
+
+void
+BaseClient::read_raw_file()
+{
+	L_CALL("BaseClient::read_raw_file()");
+
+	mode = MODE::READ_RAW_FILE;
+	file_size = -1;
+	file_size_buffer.clear();
+	receive_checksum = false;
+}
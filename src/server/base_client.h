@@ -56,7 +56,8 @@ enum class WR {
 enum class MODE {
 	READ_BUF,
 	READ_FILE_TYPE,
-	READ_FILE
+	READ_FILE,
+	READ_RAW_FILE
 };
 
 
@@ -124,10 +125,12 @@ protected:
 		}
 	}
 
+	WR write_from_file(std::shared_ptr<Buffer>& buffer);
 	WR write_from_queue();
 	WR write_from_queue(int max);
 
 	void read_file();
+	void read_raw_file();
 
 	void close();
 
@@ -252,6 +255,41 @@ protected:
 				received = buf_end - buf_data;
 			}
 
+			if ((received > 0) && mode == MODE::READ_RAW_FILE) {
+				if (file_size == -1) {
+					try {
+						auto processed = -file_size_buffer.size();
+						file_size_buffer.append(buf_data, std::min(buf_data + 10, buf_end));  // serialized size is at most 10 bytes
+						const char* o = file_size_buffer.data();
+						const char* p = o;
+						const char* p_end = p + file_size_buffer.size();
+						file_size = unserialise_length(&p, p_end);
+						processed += p - o;
+						file_size_buffer.clear();
+						buf_data += processed;
+						received -= processed;
+					} catch (const Xapian::SerialisationError) {
+						break;
+					}
+					L_CONN("Receiving raw file {sock:%d}: %zd bytes", watcher.fd, file_size);
+				}
+
+				// Raw files are neither compressed nor framed in blocks
+				auto file_buf_size = std::min(static_cast<size_t>(file_size), static_cast<size_t>(buf_end - buf_data));
+				if (file_buf_size) {
+					on_read_file(buf_data, file_buf_size);
+					buf_data += file_buf_size;
+					received -= file_buf_size;
+					file_size -= file_buf_size;
+				}
+
+				if (file_size == 0) {
+					on_read_file_done();
+					mode = MODE::READ_BUF;
+					file_size = -1;
+				}
+			}
+
 			if ((received > 0) && mode == MODE::READ_FILE_TYPE) {
 				L_CONN("Receiving file {sock:%d}...", watcher.fd);
 				decompressor = std::make_unique<ClientLZ4Decompressor<MetaBaseClient<ClientImpl>>>(static_cast<MetaBaseClient<ClientImpl>&>(*this));
@@ -41,10 +41,11 @@ class Buffer {
 	std::string _path;
 	int _fd;
 	bool _unlink;
+	bool _zero_copy;
 	std::size_t _max_pos;
 
 	void feed() {
-		if (_fd != -1 && _data_view.empty() && pos < _max_pos) {
+		if (_fd != -1 && !_zero_copy && _data_view.empty() && pos < _max_pos) {
 			_data.resize(4096);
 			io::lseek(_fd, pos, SEEK_SET);
 			auto _read = io::read(_fd, &_data[0], 4096UL);
@@ -63,14 +64,18 @@ public:
 		: _data_view(_data),
 		  _fd(-1),
 		  _unlink(false),
+		  _zero_copy(false),
 		  _max_pos(0),
 		  pos(0),
 		  type('\xff')
 	{ }
 
-	Buffer(int fd)
+	// Zero-copy buffers are never fed into user space, they must be sent
+	// straight from the file descriptor to the socket (using io::sendfile)
+	Buffer(int fd, bool zero_copy = false)
 		: _fd(fd),
 		  _unlink(false),
+		  _zero_copy(zero_copy),
 		  _max_pos(io::lseek(_fd, 0, SEEK_END)),
 		  pos(0),
 		  type('\0')
@@ -80,6 +85,7 @@ public:
 		: _path(path),
 		  _fd(io::open(_path.c_str())),
 		  _unlink(unlink),
+		  _zero_copy(false),
 		  _max_pos(io::lseek(_fd, 0, SEEK_END)),
 		  pos(0),
 		  type('\0')
@@ -90,6 +96,7 @@ public:
 		  _data_view(_data),
 		  _fd(-1),
 		  _unlink(false),
+		  _zero_copy(false),
 		  _max_pos(nbytes),
 		  pos(0),
 		  type(type)
@@ -115,21 +122,40 @@ public:
 	}
 
 	std::size_t size() {
+		if (_zero_copy) {
+			return _max_pos - pos;
+		}
 		feed();
 		return std::min(_max_pos, _data_view.size());
 	}
 
 	std::size_t full_size() {
+		if (_zero_copy) {
+			return _max_pos;
+		}
 		feed();
 		return std::max(_max_pos, _data_view.size());
 	}
 
 	void remove_prefix(std::size_t n) {
+		if (_zero_copy) {
+			ASSERT(n <= _max_pos - pos);
+			pos += n;
+			return;
+		}
 		ASSERT(n <= _data_view.size());
 		_data_view.remove_prefix(n);
 		pos += n;
 	}
 
+	bool zero_copy() const {
+		return _zero_copy;
+	}
+
+	int fd() const {
+		return _fd;
+	}
+
 	// Legacy:
 
 	const char *dpos() {
@@ -24,6 +24,7 @@
 
 #include "config.h"                         // for XAPIAND_CLUSTERING, XAPIAND_V8, XAPIAND_CHAISCRIPT, XAPIAND_DATABASE_WAL
 
+#include <cstring>                          // for std::memcpy
 #include <errno.h>                          // for errno
 #include <exception>                        // for std::exception
 #include <functional>                       // for std::function
@@ -64,10 +65,9 @@
 #include "node.h"                           // for Node::local_node, Node::leader_node
 #include "opts.h"                           // for opts::*
 #include "package.h"                        // for Package::*
-#include "query_dsl.h"                      // for QUERYDSL_SELECTOR
-#include "rapidjson/document.h"             // for Document
+#include "query_dsl.h"                      // for QUERYDSL_SELECTOR, QUERYDSL_AFTER
 #include "schema.h"                         // for Schema
-#include "serialise.h"                      // for Serialise::boolean
+#include "serialise.h"                      // for Serialise::boolean, Unserialise::MsgPack
 #include "string.hh"                        // for string::from_delta
 
 
@@ -94,6 +94,8 @@
 
 #define DEFAULT_INDENTATION 2
 
+#define SEARCH_FETCH_BATCH_SIZE 64
+
 // Reserved words only used in the responses to the user.
 constexpr const char RESPONSE_ENDPOINT[]            = "#endpoint";
 constexpr const char RESPONSE_RANK[]                = "#rank";
@@ -102,12 +104,15 @@ constexpr const char RESPONSE_PERCENT[]             = "#percent";
 constexpr const char RESPONSE_TOTAL_COUNT[]         = "#total_count";
 constexpr const char RESPONSE_MATCHES_ESTIMATED[]   = "#matches_estimated";
 constexpr const char RESPONSE_HITS[]                = "#hits";
+constexpr const char RESPONSE_NEXT[]                = "#next";
 constexpr const char RESPONSE_AGGREGATIONS[]        = "#aggregations";
 constexpr const char RESPONSE_QUERY[]               = "#query";
 constexpr const char RESPONSE_MESSAGE[]             = "#message";
 constexpr const char RESPONSE_STATUS[]              = "#status";
 constexpr const char RESPONSE_TOOK[]                = "#took";
 constexpr const char RESPONSE_NODES[]               = "#nodes";
+constexpr const char RESPONSE_OPERATION[]           = "#operation";
+constexpr const char RESPONSE_ITEMS[]               = "#items";
 constexpr const char RESPONSE_COMMIT[]              = "#commit";
 constexpr const char RESPONSE_DELETE[]              = "#delete";
 constexpr const char RESPONSE_DOCID[]               = "#docid";
@@ -334,7 +339,9 @@ HttpClient::http_response(Request& request, Response& response, enum http_status
 			headers += "Content-Encoding: " + ct_encoding + eol;
 		}
 
-		if ((mode & HTTP_CONTENT_LENGTH_RESPONSE) != 0) {
+		if ((mode & HTTP_CHUNKED_RESPONSE) != 0) {
+			headers += "Transfer-Encoding: chunked" + eol;
+		} else if ((mode & HTTP_CONTENT_LENGTH_RESPONSE) != 0) {
 			headers += string::format("Content-Length: %lu", content_length) + eol;
 		} else {
 			headers += string::format("Content-Length: %lu", body.size()) + eol;
@@ -386,6 +393,8 @@ HttpClient::~HttpClient() noexcept
 		if (is_shutting_down() && !is_idle()) {
 			L_INFO("HTTP client killed!");
 		}
+
+		end_reading();
 	} catch (...) {
 		L_EXC("Unhandled exception in destructor");
 	}
@@ -411,6 +420,12 @@ HttpClient::on_read(const char* buf, ssize_t received)
 	unsigned init_state = new_request.parser.state;
 
 	if (received <= 0) {
+		if (body_decoder) {
+			// Request is already being handled, let it know its body
+			// won't be complete.
+			body_decoder->abort();
+			body_decoder.reset();
+		}
 		if (received < 0) {
 			L_NOTICE("Client connection closed unexpectedly after %s: %s (%d): %s", string::from_delta(new_request.begins, std::chrono::system_clock::now()), error::name(errno), errno, error::description(errno));
 		} else if (init_state != 18) {
@@ -448,6 +463,10 @@ HttpClient::on_read(const char* buf, ssize_t received)
 			write_http_response(new_request, response, error_code, err_response);
 			L_NOTICE(HTTP_PARSER_ERRNO(&new_request.parser) != HPE_OK ? message : "incomplete request");
 		}
+		if (body_decoder) {
+			body_decoder->abort();
+			body_decoder.reset();
+		}
 		detach();
 	}
 
@@ -785,7 +804,44 @@ HttpClient::on_body(http_parser* parser, const char* at, size_t length)
 	L_HTTP_PROTO("on_body {state:%s, header_state:%s}: %s", HttpParserStateNames(parser->state), HttpParserHeaderStateNames(parser->header_state), repr(at, length));
 	ignore_unused(parser);
 
-	new_request.raw.append(at, length);
+	if (!body_decoder && !new_request.decoder && new_request.raw.empty()) {
+		// Bodies made of a sequence of documents are decoded as they
+		// arrive, instead of being buffered and decoded at the end.
+		if (new_request.ct_type == ndjson_type || new_request.ct_type == x_ndjson_type) {
+			new_request.decoder = std::make_shared<BodyDecoder>(true);
+		} else if (new_request.ct_type == msgpack_type || new_request.ct_type == x_msgpack_type) {
+			new_request.decoder = std::make_shared<BodyDecoder>(false);
+		}
+	}
+
+	if (body_decoder) {
+		if (body_decoder->feed(at, length)) {
+			// Too many documents waiting to be consumed, stop reading
+			// until the decoder resumes (through read_start_async).
+			io_read.stop();
+			L_EV("Disable read event");
+		}
+	} else if (new_request.decoder) {
+		new_request.decoder->feed(at, length);
+		if (new_request.decoder->size() > HTTP_BODY_DISPATCH_SIZE && !closed) {
+			// Large body, start handling the request while the rest of the
+			// body is still arriving. Moving the request copies its parser
+			// (a plain struct), so new_request.parser, which is the one
+			// running this callback, keeps its state and parsing continues
+			// normally; the rest of the body is fed through body_decoder.
+			body_decoder = new_request.decoder;
+			std::weak_ptr<HttpClient> weak_client = share_this<HttpClient>();
+			body_decoder->on_resume([weak_client]{
+				auto client = weak_client.lock();
+				if (client) {
+					client->read_start_async.send();
+				}
+			});
+			enqueue_request(std::move(new_request));
+		}
+	} else {
+		new_request.raw.append(at, length);
+	}
 
 	return 0;
 }
@@ -798,27 +854,17 @@ HttpClient::on_message_complete(http_parser* parser)
 	L_HTTP_PROTO("on_message_complete {state:%s, header_state:%s}", HttpParserStateNames(parser->state), HttpParserHeaderStateNames(parser->header_state));
 	ignore_unused(parser);
 
-	if (!closed) {
-		if (new_request.accept_set.empty()) {
-			if (!new_request.ct_type.empty()) {
-				new_request.accept_set.emplace(0, 1.0, new_request.ct_type, 0);
-			}
-			new_request.accept_set.emplace(1, 1.0, any_type, 0);
-		}
-		L_HTTP_PROTO("New request added:\n%s", string::indent(new_request.to_text(false), ' ', 8));
-		{
-			std::lock_guard<std::mutex> lk(runner_mutex);
-			if (!running) {
-				// Enqueue request...
-				requests.push_back(std::move(new_request));
-				// And start a runner.
-				running = true;
-				XapiandManager::http_client_pool()->enqueue(share_this<HttpClient>());
-			} else {
-				// There should be a runner, just enqueue request.
-				requests.push_back(std::move(new_request));
-			}
+	if (body_decoder) {
+		// Request was already enqueued while its body was still arriving,
+		// just let it know the body is now complete.
+		body_decoder->finish();
+		body_decoder.reset();
+		new_request = Request(this);
+	} else if (!closed) {
+		if (new_request.decoder) {
+			new_request.decoder->finish();
 		}
+		enqueue_request(std::move(new_request));
 		new_request = Request(this);
 	}
 	waiting = false;
@@ -826,6 +872,33 @@ HttpClient::on_message_complete(http_parser* parser)
 	return 0;
 }
 
+
+void
+HttpClient::enqueue_request(Request&& request)
+{
+	L_CALL("HttpClient::enqueue_request(<request>)");
+
+	if (request.accept_set.empty()) {
+		if (!request.ct_type.empty()) {
+			request.accept_set.emplace(0, 1.0, request.ct_type, 0);
+		}
+		request.accept_set.emplace(1, 1.0, any_type, 0);
+	}
+	L_HTTP_PROTO("New request added:\n%s", string::indent(request.to_text(false), ' ', 8));
+
+	std::lock_guard<std::mutex> lk(runner_mutex);
+	if (!running) {
+		// Enqueue request...
+		requests.push_back(std::move(request));
+		// And start a runner.
+		running = true;
+		XapiandManager::http_client_pool()->enqueue(share_this<HttpClient>());
+	} else {
+		// There should be a runner, just enqueue request.
+		requests.push_back(std::move(request));
+	}
+}
+
 int
 HttpClient::on_chunk_header(http_parser* parser)
 {
@@ -1267,6 +1340,10 @@ HttpClient::_post(Request& request, Response& response, enum http_method method)
 			request.path_parser.skip_id();  // Command has no ID
 			restore_view(request, response, method, cmd);
 			break;
+		case Command::CMD_BULK:
+			request.path_parser.skip_id();  // Command has no ID
+			bulk_view(request, response, method, cmd);
+			break;
 		case Command::CMD_QUIT:
 			if (opts.admin_commands) {
 				XapiandManager::try_shutdown(true);
@@ -1452,12 +1529,12 @@ HttpClient::delete_document_view(Request& request, Response& response, enum http
 	auto took = std::chrono::duration_cast<std::chrono::nanoseconds>(request.ready - request.processing).count();
 	L_TIME("Deletion took %s", string::from_delta(took));
 
-	Metrics::metrics()
+	static auto& delete_summary = Metrics::metrics()
 		.xapiand_operations_summary
 		.Add({
 			{"operation", "delete"},
-		})
-		.Observe(took / 1e9);
+		});
+	delete_summary.Observe(took / 1e9);
 }
 
 
@@ -1480,12 +1557,12 @@ HttpClient::delete_schema_view(Request& request, Response& response, enum http_m
 	auto took = std::chrono::duration_cast<std::chrono::nanoseconds>(request.ready - request.processing).count();
 	L_TIME("Schema deletion took %s", string::from_delta(took));
 
-	Metrics::metrics()
+	static auto& delete_schema_summary = Metrics::metrics()
 		.xapiand_operations_summary
 		.Add({
 			{"operation", "delete_schema"},
-		})
-		.Observe(took / 1e9);
+		});
+	delete_schema_summary.Observe(took / 1e9);
 }
 
 
@@ -1521,12 +1598,12 @@ HttpClient::index_document_view(Request& request, Response& response, enum http_
 	auto took = std::chrono::duration_cast<std::chrono::nanoseconds>(request.ready - request.processing).count();
 	L_TIME("Indexing took %s", string::from_delta(took));
 
-	Metrics::metrics()
+	static auto& index_summary = Metrics::metrics()
 		.xapiand_operations_summary
 		.Add({
 			{"operation", "index"},
-		})
-		.Observe(took / 1e9);
+		});
+	index_summary.Observe(took / 1e9);
 }
 
 
@@ -1555,12 +1632,12 @@ HttpClient::write_schema_view(Request& request, Response& response, enum http_me
 	auto took = std::chrono::duration_cast<std::chrono::nanoseconds>(request.ready - request.processing).count();
 	L_TIME("Schema write took %s", string::from_delta(took));
 
-	Metrics::metrics()
+	static auto& write_schema_summary = Metrics::metrics()
 		.xapiand_operations_summary
 		.Add({
 			{"operation", "write_schema"},
-		})
-		.Observe(took / 1e9);
+		});
+	write_schema_summary.Observe(took / 1e9);
 }
 
 
@@ -1602,26 +1679,26 @@ HttpClient::update_document_view(Request& request, Response& response, enum http
 	L_TIME("Updating took %s", string::from_delta(took));
 
 	if (method == HTTP_PATCH) {
-		Metrics::metrics()
+		static auto& patch_summary = Metrics::metrics()
 			.xapiand_operations_summary
 			.Add({
 				{"operation", "patch"},
-			})
-			.Observe(took / 1e9);
+			});
+		patch_summary.Observe(took / 1e9);
 	} else if (method == HTTP_STORE) {
-		Metrics::metrics()
+		static auto& store_summary = Metrics::metrics()
 			.xapiand_operations_summary
 			.Add({
 				{"operation", "store"},
-			})
-			.Observe(took / 1e9);
+			});
+		store_summary.Observe(took / 1e9);
 	} else {
-		Metrics::metrics()
+		static auto& merge_summary = Metrics::metrics()
 			.xapiand_operations_summary
 			.Add({
 				{"operation", "merge"},
-			})
-			.Observe(took / 1e9);
+			});
+		merge_summary.Observe(took / 1e9);
 	}
 }
 
@@ -1685,12 +1762,12 @@ HttpClient::metadata_view(Request& request, Response& response, enum http_method
 	auto took = std::chrono::duration_cast<std::chrono::nanoseconds>(request.ready - request.processing).count();
 	L_TIME("Get metadata took %s", string::from_delta(took));
 
-	Metrics::metrics()
+	static auto& get_metadata_summary = Metrics::metrics()
 		.xapiand_operations_summary
 		.Add({
 			{"operation", "get_metadata"},
-		})
-		.Observe(took / 1e9);
+		});
+	get_metadata_summary.Observe(took / 1e9);
 }
 
 
@@ -1767,12 +1844,12 @@ HttpClient::info_view(Request& request, Response& response, enum http_method met
 	auto took = std::chrono::duration_cast<std::chrono::nanoseconds>(request.ready - request.processing).count();
 	L_TIME("Info took %s", string::from_delta(took));
 
-	Metrics::metrics()
+	static auto& info_summary = Metrics::metrics()
 		.xapiand_operations_summary
 		.Add({
-			{"operation", "info"}
-		})
-		.Observe(took / 1e9);
+			{"operation", "info"},
+		});
+	info_summary.Observe(took / 1e9);
 }
 
 
@@ -1844,12 +1921,12 @@ HttpClient::touch_view(Request& request, Response& response, enum http_method me
 	auto took = std::chrono::duration_cast<std::chrono::nanoseconds>(request.ready - request.processing).count();
 	L_TIME("Touch took %s", string::from_delta(took));
 
-	Metrics::metrics()
+	static auto& touch_summary = Metrics::metrics()
 		.xapiand_operations_summary
 		.Add({
 			{"operation", "touch"},
-		})
-		.Observe(took / 1e9);
+		});
+	touch_summary.Observe(took / 1e9);
 }
 
 
@@ -1876,12 +1953,12 @@ HttpClient::commit_view(Request& request, Response& response, enum http_method m
 	auto took = std::chrono::duration_cast<std::chrono::nanoseconds>(request.ready - request.processing).count();
 	L_TIME("Commit took %s", string::from_delta(took));
 
-	Metrics::metrics()
+	static auto& commit_summary = Metrics::metrics()
 		.xapiand_operations_summary
 		.Add({
 			{"operation", "commit"},
-		})
-		.Observe(took / 1e9);
+		});
+	commit_summary.Observe(took / 1e9);
 }
 
 
@@ -1940,12 +2017,12 @@ HttpClient::dump_view(Request& request, Response& response, enum http_method /*u
 	auto took = std::chrono::duration_cast<std::chrono::nanoseconds>(request.ready - request.processing).count();
 	L_TIME("Dump took %s", string::from_delta(took));
 
-	Metrics::metrics()
+	static auto& dump_summary = Metrics::metrics()
 		.xapiand_operations_summary
 		.Add({
 			{"operation", "dump"},
-		})
-		.Observe(took / 1e9);
+		});
+	dump_summary.Observe(took / 1e9);
 }
 
 
@@ -1996,12 +2073,164 @@ HttpClient::restore_view(Request& request, Response& response, enum http_method
 
 	L_TIME("Restore took %s", string::from_delta(took));
 
-	Metrics::metrics()
+	static auto& restore_summary = Metrics::metrics()
 		.xapiand_operations_summary
 		.Add({
 			{"operation", "restore"},
-		})
-		.Observe(took / 1e9);
+		});
+	restore_summary.Observe(took / 1e9);
+}
+
+
+void
+HttpClient::bulk_view(Request& request, Response& response, enum http_method method, Command /*unused*/)
+{
+	L_CALL("HttpClient::bulk_view()");
+
+	endpoints_maker(request, true);
+
+	request.processing = std::chrono::system_clock::now();
+
+	// Operations are taken from the body as they are decoded, a body
+	// (or a document in the stream) which is a list has its elements
+	// taken as operations instead.
+	// Operations are never copied, the returned pointer stays valid
+	// until the next operation is requested.
+	const MsgPack* operations = nullptr;
+	size_t operations_pos = 0;
+	std::unique_ptr<MsgPack> decoded;
+	if (!request.decoder) {
+		operations = &request.decoded_body();
+		if (!operations->is_array()) {
+			THROW(ClientError, "Expected a list of operations");
+		}
+	}
+	auto next_operation = [&]() -> const MsgPack* {
+		while (true) {
+			if (operations != nullptr && operations_pos < operations->size()) {
+				return &operations->at(operations_pos++);
+			}
+			operations = nullptr;
+			if (!request.decoder || !(decoded = request.decoder->next())) {
+				return nullptr;
+			}
+			if (decoded->is_array()) {
+				operations = decoded.get();
+				operations_pos = 0;
+			} else {
+				return decoded.get();
+			}
+		}
+	};
+
+	auto& ct_type = request.decoder ? (request.decoder->is_ndjson() ? json_type : msgpack_type) : request.ct_type;
+
+	DatabaseHandler db_handler(endpoints, DB_WRITABLE | DB_CREATE_OR_OPEN, method);
+
+	auto get_item = [&](std::string_view op, const MsgPack& document_id, Xapian::docid did, const std::exception_ptr& eptr) {
+		enum http_status status_code = HTTP_STATUS_OK;
+		std::string error;
+		if (eptr) {
+			try {
+				std::rethrow_exception(eptr);
+			} catch (const NotFoundError& exc) {
+				status_code = HTTP_STATUS_NOT_FOUND;
+				error.assign(http_status_str(status_code));
+			} catch (const MissingTypeError& exc) {
+				status_code = HTTP_STATUS_PRECONDITION_FAILED;
+				error.assign(exc.what());
+			} catch (const ClientError& exc) {
+				status_code = HTTP_STATUS_BAD_REQUEST;
+				error.assign(exc.what());
+			} catch (const TimeOutError& exc) {
+				status_code = HTTP_STATUS_SERVICE_UNAVAILABLE;
+				error.assign(std::string(http_status_str(status_code)) + ": " + exc.what());
+			} catch (const BaseException& exc) {
+				status_code = HTTP_STATUS_INTERNAL_SERVER_ERROR;
+				error.assign(*exc.get_message() != 0 ? exc.get_message() : "Unkown BaseException!");
+			} catch (const Xapian::Error& exc) {
+				status_code = HTTP_STATUS_INTERNAL_SERVER_ERROR;
+				error.assign(exc.get_description());
+			} catch (const std::exception& exc) {
+				status_code = HTTP_STATUS_INTERNAL_SERVER_ERROR;
+				error.assign(*exc.what() != 0 ? exc.what() : "Unkown std::exception!");
+			} catch (...) {
+				status_code = HTTP_STATUS_INTERNAL_SERVER_ERROR;
+				error.assign("Unknown exception!");
+			}
+		}
+		MsgPack item_obj = {
+			{ RESPONSE_OPERATION, op },
+			{ ID_FIELD_NAME, document_id },
+			{ RESPONSE_STATUS, (int)status_code },
+		};
+		if (did) {
+			item_obj[RESPONSE_DOCID] = did;
+		}
+		if (!error.empty()) {
+			item_obj[RESPONSE_MESSAGE] = string::split(error, '\n');
+		}
+		return item_obj;
+	};
+
+	const auto& stream_type = resolve_stream_type(request);
+	if (stream_type != no_type) {
+		// Streaming response: the status of every operation is sent as a
+		// chunk (one JSON line or one MsgPack object) as soon as it has
+		// been written, in the same order operations were received.
+		bool ndjson = stream_type == ndjson_type || stream_type == x_ndjson_type;
+		auto serialise = [&](const MsgPack& frame) {
+			return ndjson ? frame.to_string() + "\n" : frame.serialise();
+		};
+
+		int mode = HTTP_STATUS_RESPONSE | HTTP_HEADER_RESPONSE | HTTP_CONTENT_TYPE_RESPONSE | HTTP_CHUNKED_RESPONSE;
+		std::string ct_encoding;
+		if (request.type_encoding != Encoding::none) {
+			mode |= HTTP_CONTENT_ENCODING_RESPONSE;
+			ct_encoding = readable_encoding(request.type_encoding);
+		}
+		write(http_response(request, response, HTTP_STATUS_OK, mode, 0, 0, "", stream_type.to_string() + "; charset=utf-8", ct_encoding));
+
+		bool start = true;
+		db_handler.bulk(next_operation, ct_type, [&](std::string_view op, const MsgPack& document_id, Xapian::docid did, const std::exception_ptr& eptr) {
+			write_http_chunk(request, response, serialise(get_item(op, document_id, did, eptr)), start, false);
+			start = false;
+		});
+
+		request.ready = std::chrono::system_clock::now();
+		auto took = std::chrono::duration_cast<std::chrono::nanoseconds>(request.ready - request.processing).count();
+
+		write_http_chunk(request, response, serialise({
+			{ RESPONSE_ENDPOINT, endpoints.to_string() },
+			{ RESPONSE_TOOK, took / 1e6 },
+		}), start, true);
+	} else {
+		MsgPack response_obj;
+		response_obj[RESPONSE_ITEMS] = MsgPack(MsgPack::Type::ARRAY);
+		auto& items = response_obj[RESPONSE_ITEMS];
+
+		db_handler.bulk(next_operation, ct_type, [&](std::string_view op, const MsgPack& document_id, Xapian::docid did, const std::exception_ptr& eptr) {
+			items.append(get_item(op, document_id, did, eptr));
+		});
+
+		request.ready = std::chrono::system_clock::now();
+		auto took = std::chrono::duration_cast<std::chrono::nanoseconds>(request.ready - request.processing).count();
+
+		response_obj[RESPONSE_ENDPOINT] = endpoints.to_string();
+		response_obj[RESPONSE_TOOK] = took / 1e6;
+
+		write_http_response(request, response, HTTP_STATUS_OK, response_obj);
+	}
+
+	auto took = std::chrono::duration_cast<std::chrono::nanoseconds>(request.ready - request.processing).count();
+	L_TIME("Bulk took %s", string::from_delta(took));
+
+	static auto& bulk_summary = Metrics::metrics()
+		.xapiand_operations_summary
+		.Add({
+			{"operation", "bulk"},
+		});
+	bulk_summary.Observe(took / 1e9);
 }
 
 
@@ -2043,12 +2272,12 @@ HttpClient::schema_view(Request& request, Response& response, enum http_method m
 	auto took = std::chrono::duration_cast<std::chrono::nanoseconds>(request.ready - request.processing).count();
 	L_TIME("Schema took %s", string::from_delta(took));
 
-	Metrics::metrics()
+	static auto& schema_summary = Metrics::metrics()
 		.xapiand_operations_summary
 		.Add({
 			{"operation", "schema"},
-		})
-		.Observe(took / 1e9);
+		});
+	schema_summary.Observe(took / 1e9);
 }
 
 
@@ -2075,12 +2304,12 @@ HttpClient::wal_view(Request& request, Response& response, enum http_method /*un
 	auto took = std::chrono::duration_cast<std::chrono::nanoseconds>(request.ready - request.processing).count();
 	L_TIME("WAL took %s", string::from_delta(took));
 
-	Metrics::metrics()
+	static auto& wal_summary = Metrics::metrics()
 		.xapiand_operations_summary
 		.Add({
 			{"operation", "wal"},
-		})
-		.Observe(took / 1e9);
+		});
+	wal_summary.Observe(took / 1e9);
 }
 #endif
 
@@ -2105,12 +2334,12 @@ HttpClient::check_view(Request& request, Response& response, enum http_method /*
 	auto took = std::chrono::duration_cast<std::chrono::nanoseconds>(request.ready - request.processing).count();
 	L_TIME("Database check took %s", string::from_delta(took));
 
-	Metrics::metrics()
+	static auto& db_check_summary = Metrics::metrics()
 		.xapiand_operations_summary
 		.Add({
 			{"operation", "db_check"},
-		})
-		.Observe(took / 1e9);
+		});
+	db_check_summary.Observe(took / 1e9);
 }
 
 
@@ -2211,12 +2440,12 @@ HttpClient::retrieve_view(Request& request, Response& response, enum http_method
 	auto took = std::chrono::duration_cast<std::chrono::nanoseconds>(request.ready - request.processing).count();
 	L_TIME("Retrieving took %s", string::from_delta(took));
 
-	Metrics::metrics()
+	static auto& retrieve_summary = Metrics::metrics()
 		.xapiand_operations_summary
 		.Add({
 			{"operation", "retrieve"},
-		})
-		.Observe(took / 1e9);
+		});
+	retrieve_summary.Observe(took / 1e9);
 
 	L_SEARCH("FINISH RETRIEVE");
 }
@@ -2240,9 +2469,16 @@ HttpClient::search_view(Request& request, Response& response, enum http_method m
 
 	MSet mset{};
 	MsgPack aggregations;
+	bool is_after = query_field.is_after;
 
 	request.processing = std::chrono::system_clock::now();
 
+	// The body is decoded upfront, so it's accounted for as parsing.
+	if (request.has_body()) {
+		request.decoded_body();
+	}
+	auto parsed = std::chrono::system_clock::now();
+
 	// Open database
 	DatabaseHandler db_handler;
 	try {
@@ -2255,11 +2491,15 @@ HttpClient::search_view(Request& request, Response& response, enum http_method m
 			db_handler.reset(endpoints, DB_OPEN, method);
 		}
 
-		if (request.raw.empty()) {
+		if (!request.has_body()) {
 			mset = db_handler.get_mset(query_field, nullptr, nullptr);
 		} else {
 			auto& decoded_body = request.decoded_body();
 
+			if (decoded_body.find(QUERYDSL_AFTER) != decoded_body.end()) {
+				is_after = true;
+			}
+
 			AggregationMatchSpy aggs(decoded_body, db_handler.get_schema());
 
 			if (decoded_body.find(QUERYDSL_SELECTOR) != decoded_body.end()) {
@@ -2280,37 +2520,66 @@ HttpClient::search_view(Request& request, Response& response, enum http_method m
 		 * with zero matches this behavior may change in the future for instance ( return 404 ) */
 	}
 
+	// Time spent in each phase, fetching and writing are interleaved
+	// with serialising the hits so they are accumulated separately;
+	// waiting for database checkouts is taken out of every phase.
+	auto matched = std::chrono::system_clock::now();
+	auto matched_checkout = db_handler.checkout_time();
+	std::chrono::nanoseconds fetching{0};
+	std::chrono::nanoseconds writing{0};
+
 	auto total_count = mset.size();
 
-	MsgPack obj;
-	if (aggregations) {
-		obj[RESPONSE_AGGREGATIONS] = aggregations;
+	const auto m_e = mset.end();
+
+	// When paging with cursors, the next page starts after the last hit.
+	MsgPack next;
+	if (is_after && total_count != 0) {
+		auto m_last = mset.back();
+		next = cursor_t(m_last.get_sort_key(), *m_last).serialise();
 	}
-	obj[RESPONSE_QUERY] = {
-		{ RESPONSE_MATCHES_ESTIMATED, mset.get_matches_estimated()},
-		{ RESPONSE_TOTAL_COUNT, total_count},
-		{ RESPONSE_HITS, MsgPack(MsgPack::Type::ARRAY) },
-	};
-	auto& hits = obj[RESPONSE_QUERY][RESPONSE_HITS];
 
-	const auto m_e = mset.end();
-	for (auto m = mset.begin(); m != m_e; ++m) {
+	// Document data (and the ID value) is prefetched in batches (a single
+	// pass per batch, shards read in parallel) instead of one lookup per hit.
+	std::vector<DocumentData> batch;
+	size_t batch_pos = 0;
+	required_spc_t id_field;
+	if (total_count != 0) {
+		id_field = db_handler.get_schema()->get_slot_field(ID_FIELD_NAME);
+	}
+
+	auto get_hit = [&](const auto& m) {
+		if (batch_pos == batch.size()) {
+			std::vector<Xapian::docid> dids;
+			for (auto it = m; it != m_e && dids.size() < SEARCH_FETCH_BATCH_SIZE; ++it) {
+				dids.push_back(*it);
+			}
+			auto fetch_begins = std::chrono::system_clock::now();
+			auto fetch_checkout = db_handler.checkout_time();
+			batch = db_handler.get_documents_data(dids, true, id_field.slot);
+			fetching += std::chrono::system_clock::now() - fetch_begins - (db_handler.checkout_time() - fetch_checkout);
+			batch_pos = 0;
+		}
+		auto& fetched = batch[batch_pos++];
 
 		// Retrive document data
-		auto document = db_handler.get_document(*m);
-		const auto data = Data(document.get_data());
+		const auto data = Data(std::move(fetched.data));
 
 		MsgPack hit_obj;
 		auto main_locator = data.get("");
 		if (main_locator != nullptr) {
-			hit_obj = MsgPack::unserialise(main_locator->data());
+			if (!fetched.blob.empty()) {
+				hit_obj = MsgPack::unserialise(unserialise_string_at(STORED_BLOB, fetched.blob));
+			} else {
+				hit_obj = MsgPack::unserialise(main_locator->data());
+			}
 		}
 
 		// Detailed info about the document:
 		if (hit_obj.find(ID_FIELD_NAME) == hit_obj.end()) {
-			hit_obj[ID_FIELD_NAME] = document.get_value(ID_FIELD_NAME);
+			hit_obj[ID_FIELD_NAME] = Unserialise::MsgPack(id_field.get_type(), fetched.value);
 		}
-		hit_obj[RESPONSE_DOCID] = document.get_docid();
+		hit_obj[RESPONSE_DOCID] = *m;
 		hit_obj[RESPONSE_RANK] = m.get_rank();
 		hit_obj[RESPONSE_WEIGHT] = m.get_weight();
 		hit_obj[RESPONSE_PERCENT] = m.get_percent();
@@ -2322,33 +2591,144 @@ HttpClient::search_view(Request& request, Response& response, enum http_method m
 			hit_obj = hit_obj.select(selector);
 		}
 
-		hits.append(hit_obj);
+		return hit_obj;
+	};
+
+	const auto& stream_type = resolve_stream_type(request);
+	if (stream_type != no_type) {
+		// Streaming response: hits are sent as chunks (one JSON line or one
+		// MsgPack object per hit) while the MSet is being iterated, so
+		// memory stays constant no matter how many documents are requested.
+		bool ndjson = stream_type == ndjson_type || stream_type == x_ndjson_type;
+		auto serialise = [&](const MsgPack& frame) {
+			return ndjson ? frame.to_string() + "\n" : frame.serialise();
+		};
+
+		int mode = HTTP_STATUS_RESPONSE | HTTP_HEADER_RESPONSE | HTTP_CONTENT_TYPE_RESPONSE | HTTP_CHUNKED_RESPONSE | HTTP_TOTAL_COUNT_RESPONSE | HTTP_MATCHES_ESTIMATED_RESPONSE;
+		std::string ct_encoding;
+		if (request.type_encoding != Encoding::none) {
+			mode |= HTTP_CONTENT_ENCODING_RESPONSE;
+			ct_encoding = readable_encoding(request.type_encoding);
+		}
+		auto write_chunk = [&](const std::string& chunk, bool start, bool end) {
+			auto write_begins = std::chrono::system_clock::now();
+			write_http_chunk(request, response, chunk, start, end);
+			writing += std::chrono::system_clock::now() - write_begins;
+		};
+
+		auto write_begins = std::chrono::system_clock::now();
+		write(http_response(request, response, HTTP_STATUS_OK, mode, total_count, mset.get_matches_estimated(), "", stream_type.to_string() + "; charset=utf-8", ct_encoding));
+		writing += std::chrono::system_clock::now() - write_begins;
+
+		bool start = true;
+		if (aggregations) {
+			write_chunk(serialise({
+				{ RESPONSE_AGGREGATIONS, aggregations },
+			}), start, false);
+			start = false;
+		}
+
+		for (auto m = mset.begin(); m != m_e; ++m) {
+			try {
+				write_chunk(serialise(get_hit(m)), start, false);
+				start = false;
+			} catch (...) {
+				// Status and headers are already out, the only way left
+				// to signal the error is by aborting the chunked stream.
+				L_EXC("ERROR: Streaming search aborted");
+				close();
+				return;
+			}
+		}
+		if (next) {
+			write_chunk(serialise({
+				{ RESPONSE_NEXT, next },
+			}), start, false);
+			start = false;
+		}
+		write_chunk("", start, true);
+
+		request.ready = std::chrono::system_clock::now();
+	} else {
+		MsgPack obj;
+		if (aggregations) {
+			obj[RESPONSE_AGGREGATIONS] = aggregations;
+		}
+		obj[RESPONSE_QUERY] = {
+			{ RESPONSE_MATCHES_ESTIMATED, mset.get_matches_estimated()},
+			{ RESPONSE_TOTAL_COUNT, total_count},
+			{ RESPONSE_HITS, MsgPack(MsgPack::Type::ARRAY) },
+		};
+		auto& hits = obj[RESPONSE_QUERY][RESPONSE_HITS];
+
+		for (auto m = mset.begin(); m != m_e; ++m) {
+			hits.append(get_hit(m));
+		}
+
+		if (next) {
+			obj[RESPONSE_QUERY][RESPONSE_NEXT] = next;
+		}
+
+		request.ready = std::chrono::system_clock::now();
+
+		if (Logging::log_level > LOG_DEBUG && response.size <= 1024 * 10) {
+			response.body += obj.to_string(DEFAULT_INDENTATION);
+		}
+
+		auto write_begins = std::chrono::system_clock::now();
+		write_http_response(request, response, HTTP_STATUS_OK, obj);
+		writing += std::chrono::system_clock::now() - write_begins;
 	}
 
-	request.ready = std::chrono::system_clock::now();
 	auto took = std::chrono::duration_cast<std::chrono::nanoseconds>(request.ready - request.processing).count();
 	L_TIME("Searching took %s", string::from_delta(took));
 
-	if (Logging::log_level > LOG_DEBUG && response.size <= 1024 * 10) {
-		response.body += obj.to_string(DEFAULT_INDENTATION);
+	auto checkout = db_handler.checkout_time().count();
+	auto parsing = std::chrono::duration_cast<std::chrono::nanoseconds>(parsed - request.received).count();
+	auto matching = std::chrono::duration_cast<std::chrono::nanoseconds>(matched - parsed).count() - matched_checkout.count();
+	auto serialising = std::chrono::duration_cast<std::chrono::nanoseconds>(request.ready - matched).count() - fetching.count() - (checkout - matched_checkout.count());
+	if (stream_type != no_type) {
+		serialising -= writing.count();
 	}
 
-	write_http_response(request, response, HTTP_STATUS_OK, obj);
-
 	if (aggregations) {
-		Metrics::metrics()
+		static auto& aggregation_summary = Metrics::metrics()
 			.xapiand_operations_summary
 			.Add({
 				{"operation", "aggregation"},
-			})
-			.Observe(took / 1e9);
+			});
+		aggregation_summary.Observe(took / 1e9);
+		static auto& parse_latency = Metrics::metrics().latency("aggregation", "parse");
+		static auto& checkout_latency = Metrics::metrics().latency("aggregation", "checkout");
+		static auto& match_latency = Metrics::metrics().latency("aggregation", "match");
+		static auto& fetch_latency = Metrics::metrics().latency("aggregation", "fetch");
+		static auto& serialise_latency = Metrics::metrics().latency("aggregation", "serialise");
+		static auto& write_latency = Metrics::metrics().latency("aggregation", "write");
+		parse_latency.Observe(parsing / 1e9);
+		checkout_latency.Observe(checkout / 1e9);
+		match_latency.Observe(matching / 1e9);
+		fetch_latency.Observe(fetching.count() / 1e9);
+		serialise_latency.Observe(serialising / 1e9);
+		write_latency.Observe(writing.count() / 1e9);
 	} else {
-		Metrics::metrics()
+		static auto& search_summary = Metrics::metrics()
 			.xapiand_operations_summary
 			.Add({
 				{"operation", "search"},
-			})
-			.Observe(took / 1e9);
+			});
+		search_summary.Observe(took / 1e9);
+		static auto& parse_latency = Metrics::metrics().latency("search", "parse");
+		static auto& checkout_latency = Metrics::metrics().latency("search", "checkout");
+		static auto& match_latency = Metrics::metrics().latency("search", "match");
+		static auto& fetch_latency = Metrics::metrics().latency("search", "fetch");
+		static auto& serialise_latency = Metrics::metrics().latency("search", "serialise");
+		static auto& write_latency = Metrics::metrics().latency("search", "write");
+		parse_latency.Observe(parsing / 1e9);
+		checkout_latency.Observe(checkout / 1e9);
+		match_latency.Observe(matching / 1e9);
+		fetch_latency.Observe(fetching.count() / 1e9);
+		serialise_latency.Observe(serialising / 1e9);
+		write_latency.Observe(writing.count() / 1e9);
 	}
 
 	L_SEARCH("FINISH SEARCH");
@@ -2379,7 +2759,7 @@ HttpClient::count_view(Request& request, Response& response, enum http_method me
 			db_handler.reset(endpoints, DB_OPEN, method);
 		}
 
-		if (request.raw.empty()) {
+		if (!request.has_body()) {
 			mset = db_handler.get_mset(query_field, nullptr, nullptr);
 		} else {
 			auto& decoded_body = request.decoded_body();
@@ -2490,6 +2870,7 @@ HttpClient::url_resolve(Request& request)
 void
 HttpClient::endpoints_maker(Request& request, bool master)
 {
+	end_reading();
 	endpoints.clear();
 
 	PathParser::State state;
@@ -2499,6 +2880,24 @@ HttpClient::endpoints_maker(Request& request, bool master)
 }
 
 
+void
+HttpClient::end_reading()
+{
+#ifdef XAPIAND_CLUSTERING
+	// Nodes are looked up again by name as they could have been
+	// replaced in the meantime (the count goes with the new one).
+	for (const auto& node_name : reading_nodes) {
+		auto node = Node::get_node(node_name);
+		if (node) {
+			auto reading = node->reading.load(std::memory_order_relaxed);
+			while (reading != 0 && !node->reading.compare_exchange_weak(reading, reading - 1, std::memory_order_relaxed)) { }
+		}
+	}
+	reading_nodes.clear();
+#endif
+}
+
+
 void
 HttpClient::_endpoint_maker(Request& request, bool master)
 {
@@ -2544,7 +2943,17 @@ HttpClient::_endpoint_maker(Request& request, bool master)
 #endif
 		endpoints.add(endpoint);
 	} else {
-		endpoints.add(XapiandManager::resolve_index_endpoint(Endpoint{index_path}, master));
+		auto endpoint = XapiandManager::resolve_index_endpoint(Endpoint{index_path}, master);
+#ifdef XAPIAND_CLUSTERING
+		if (!master) {
+			auto node = Node::get_node(endpoint.node.lower_name());
+			if (node) {
+				node->reading.fetch_add(1, std::memory_order_relaxed);
+				reading_nodes.push_back(node->lower_name());
+			}
+		}
+#endif
+		endpoints.add(endpoint);
 	}
 	L_HTTP("Endpoint: -> %s", endpoints.to_string());
 }
@@ -2634,6 +3043,12 @@ HttpClient::query_field_maker(Request& request, int flags)
 			query_field.sort.emplace_back(request.query_parser.get());
 		}
 
+		request.query_parser.rewind();
+		if (request.query_parser.next("after") != -1) {
+			query_field.is_after = true;
+			query_field.after = request.query_parser.get();
+		}
+
 		request.query_parser.rewind();
 		if (request.query_parser.next("metric") != -1) {
 			query_field.metric = request.query_parser.get();
@@ -2796,6 +3211,8 @@ HttpClient::clean_http_request(Request& request, Response& response)
 	request.ends = std::chrono::system_clock::now();
 	waiting = false;
 
+	end_reading();
+
 	if (request.log) {
 		request.log->clear();
 		request.log.reset();
@@ -3134,6 +3551,81 @@ HttpClient::encoding_http_response(Response& response, Encoding e, const std::st
 }
 
 
+const ct_type_t&
+HttpClient::resolve_stream_type(Request& request)
+{
+	L_CALL("HttpClient::resolve_stream_type()");
+
+	// Chunked transfer encoding is only available since HTTP/1.1
+	if (request.parser.http_major < 1 || (request.parser.http_major == 1 && request.parser.http_minor < 1)) {
+		return no_type;
+	}
+
+	// Explicitly accepting newline delimited JSON always streams
+	for (const auto& accept : request.accept_set) {
+		if (accept.ct_type == ndjson_type) {
+			return ndjson_type;
+		}
+		if (accept.ct_type == x_ndjson_type) {
+			return x_ndjson_type;
+		}
+	}
+
+	// Otherwise the stream query parameter is needed
+	request.query_parser.rewind();
+	if (request.query_parser.next("stream") == -1) {
+		return no_type;
+	}
+	if (request.query_parser.len != 0u) {
+		try {
+			if (Serialise::boolean(request.query_parser.get()) != "t") {
+				return no_type;
+			}
+		} catch (const Exception&) { }
+	}
+
+	const auto& accepted_type = get_acceptable_type(request, msgpack_serializers);
+	if (accepted_type == no_type || is_acceptable_type(accepted_type, json_type) != nullptr) {
+		return ndjson_type;
+	}
+	if (is_acceptable_type(accepted_type, msgpack_type) != nullptr) {
+		return msgpack_type;
+	}
+	if (is_acceptable_type(accepted_type, x_msgpack_type) != nullptr) {
+		return x_msgpack_type;
+	}
+	return ndjson_type;
+}
+
+
+void
+HttpClient::write_http_chunk(Request& request, Response& response, const std::string& chunk, bool start, bool end)
+{
+	L_CALL("HttpClient::write_http_chunk(%s, %s, %s)", repr(chunk), start ? "true" : "false", end ? "true" : "false");
+
+	std::string data;
+	if (request.type_encoding != Encoding::none) {
+		data = encoding_http_response(response, request.type_encoding, chunk, true, start, end);
+	} else {
+		data = chunk;
+	}
+
+	std::string response_text;
+	if (!data.empty()) {
+		response_text += string::format("%zx", data.size()) + eol;
+		response_text += data + eol;
+	}
+	if (end) {
+		response_text += "0" + eol + eol;
+	}
+
+	if (!response_text.empty()) {
+		response.size += response_text.size();
+		write(response_text);
+	}
+}
+
+
 std::string
 HttpClient::__repr__() const
 {
@@ -3151,6 +3643,308 @@ HttpClient::__repr__() const
 }
 
 
+BodyDecoder::BodyDecoder(bool ndjson_) :
+	ndjson(ndjson_),
+	received(0),
+	finished(false),
+	paused(false),
+	discarded(false) { }
+
+
+void
+BodyDecoder::push(std::string&& item)
+{
+	std::lock_guard<std::mutex> lk(mtx);
+	items.push_back(std::move(item));
+	cond.notify_one();
+}
+
+
+// Size of the first MsgPack object in data (0 if it's not complete yet),
+// found by skipping over headers and lengths without unpacking anything.
+static std::size_t
+msgpack_object_size(std::string_view data)
+{
+	std::size_t pos = 0;
+	std::size_t size = data.size();
+	unsigned long long pending = 1;  // objects still to be skipped
+
+	auto length = [&](std::size_t n, unsigned long long& value) {
+		if (pos + n > size) {
+			return false;
+		}
+		value = 0;
+		for (std::size_t i = 0; i < n; ++i) {
+			value = (value << 8) | static_cast<unsigned char>(data[pos++]);
+		}
+		return true;
+	};
+
+	while (pending != 0u) {
+		if (pos >= size) {
+			return 0;
+		}
+		auto c = static_cast<unsigned char>(data[pos++]);
+		--pending;
+		unsigned long long skip = 0;
+		unsigned long long n = 0;
+		if (c <= 0x7f || c >= 0xe0) {
+			// positive or negative fixint
+		} else if (c <= 0x8f) {
+			pending += 2 * (c & 0x0f);  // fixmap
+		} else if (c <= 0x9f) {
+			pending += c & 0x0f;  // fixarray
+		} else if (c <= 0xbf) {
+			skip = c & 0x1f;  // fixstr
+		} else {
+			switch (c) {
+				case 0xc0: case 0xc2: case 0xc3:  // nil, false, true
+					break;
+				case 0xc4: case 0xd9:  // bin 8, str 8
+					if (!length(1, skip)) return 0;
+					break;
+				case 0xc5: case 0xda:  // bin 16, str 16
+					if (!length(2, skip)) return 0;
+					break;
+				case 0xc6: case 0xdb:  // bin 32, str 32
+					if (!length(4, skip)) return 0;
+					break;
+				case 0xc7:  // ext 8
+					if (!length(1, skip)) return 0;
+					++skip;
+					break;
+				case 0xc8:  // ext 16
+					if (!length(2, skip)) return 0;
+					++skip;
+					break;
+				case 0xc9:  // ext 32
+					if (!length(4, skip)) return 0;
+					++skip;
+					break;
+				case 0xcc: case 0xd0: skip = 1; break;
+				case 0xcd: case 0xd1: skip = 2; break;
+				case 0xca: case 0xce: case 0xd2: skip = 4; break;
+				case 0xcb: case 0xcf: case 0xd3: skip = 8; break;
+				case 0xd4: skip = 2; break;  // fixext 1
+				case 0xd5: skip = 3; break;  // fixext 2
+				case 0xd6: skip = 5; break;  // fixext 4
+				case 0xd7: skip = 9; break;  // fixext 8
+				case 0xd8: skip = 17; break;  // fixext 16
+				case 0xdc:  // array 16
+					if (!length(2, n)) return 0;
+					pending += n;
+					break;
+				case 0xdd:  // array 32
+					if (!length(4, n)) return 0;
+					pending += n;
+					break;
+				case 0xde:  // map 16
+					if (!length(2, n)) return 0;
+					pending += 2 * n;
+					break;
+				case 0xdf:  // map 32
+					if (!length(4, n)) return 0;
+					pending += 2 * n;
+					break;
+				default:
+					THROW(ClientError, "Invalid MsgPack body");
+			}
+		}
+		if (skip > size - pos) {
+			return 0;
+		}
+		pos += skip;
+	}
+	return pos;
+}
+
+
+void
+BodyDecoder::decode(const char* data, std::size_t length, bool final)
+{
+	L_CALL("BodyDecoder::decode(<data>, %zu, %s)", length, final ? "true" : "false");
+
+	// Only the feeding thread gets here, so the framing state (buffer)
+	// needs no locking; only the queued documents are shared. Documents
+	// are only framed here, they're parsed by the consumer in next().
+	if (ndjson) {
+		auto frame = [&](std::string_view line) {
+			auto end = line.find_last_not_of(" \t\r");
+			if (end != std::string_view::npos) {
+				push(std::string(line.substr(0, end + 1)));
+			}
+		};
+
+		std::string_view chunk(data, length);
+		std::size_t start = 0;
+		std::size_t pos;
+		while ((pos = chunk.find('\n', start)) != std::string_view::npos) {
+			if (buffer.empty()) {
+				frame(chunk.substr(start, pos - start));
+			} else {
+				buffer.append(chunk.substr(start, pos - start));
+				frame(buffer);
+				buffer.clear();
+			}
+			start = pos + 1;
+		}
+		buffer.append(chunk.substr(start));
+		if (final && !buffer.empty()) {
+			frame(buffer);
+			buffer.clear();
+		}
+	} else {
+		buffer.append(data, length);
+		std::string_view pending(buffer);
+		std::size_t size;
+		while (!pending.empty() && (size = msgpack_object_size(pending)) != 0u) {
+			push(std::string(pending.substr(0, size)));
+			pending.remove_prefix(size);
+		}
+		buffer.erase(0, buffer.size() - pending.size());
+		if (final && !buffer.empty()) {
+			THROW(ClientError, "Incomplete MsgPack body");
+		}
+	}
+}
+
+
+bool
+BodyDecoder::feed(const char* at, std::size_t length)
+{
+	L_CALL("BodyDecoder::feed(<at>, %zu)", length);
+
+	{
+		std::lock_guard<std::mutex> lk(mtx);
+		if (finished || discarded) {
+			return false;
+		}
+		received += length;
+	}
+
+	try {
+		decode(at, length, false);
+	} catch (...) {
+		std::lock_guard<std::mutex> lk(mtx);
+		eptr = std::current_exception();
+		finished = true;
+		cond.notify_all();
+		return false;
+	}
+
+	// Returns true when the reader must stop reading (until resumed).
+	std::lock_guard<std::mutex> lk(mtx);
+	if (!discarded && resume && items.size() >= HTTP_BODY_QUEUE_SIZE) {
+		paused = true;
+	}
+	return paused;
+}
+
+
+void
+BodyDecoder::finish()
+{
+	L_CALL("BodyDecoder::finish()");
+
+	{
+		std::lock_guard<std::mutex> lk(mtx);
+		if (finished || discarded) {
+			return;
+		}
+	}
+
+	std::exception_ptr _eptr;
+	try {
+		decode(nullptr, 0, true);
+	} catch (...) {
+		_eptr = std::current_exception();
+	}
+
+	std::lock_guard<std::mutex> lk(mtx);
+	eptr = _eptr;
+	finished = true;
+	cond.notify_all();
+}
+
+
+void
+BodyDecoder::abort()
+{
+	L_CALL("BodyDecoder::abort()");
+
+	std::lock_guard<std::mutex> lk(mtx);
+	if (!finished) {
+		try {
+			THROW(ClientError, "Request body is incomplete");
+		} catch (...) {
+			eptr = std::current_exception();
+		}
+		finished = true;
+		cond.notify_all();
+	}
+}
+
+
+void
+BodyDecoder::discard()
+{
+	L_CALL("BodyDecoder::discard()");
+
+	std::function<void()> _resume;
+	{
+		std::lock_guard<std::mutex> lk(mtx);
+		discarded = true;
+		items.clear();
+		if (paused) {
+			paused = false;
+			_resume = resume;
+		}
+	}
+	// The rest of the body must still be read (and dropped).
+	if (_resume) {
+		_resume();
+	}
+}
+
+
+std::unique_ptr<MsgPack>
+BodyDecoder::next()
+{
+	L_CALL("BodyDecoder::next()");
+
+	std::string frame;
+	std::function<void()> _resume;
+	{
+		std::unique_lock<std::mutex> lk(mtx);
+		while (items.empty() && !finished) {
+			// Keep waiting for as long as the body keeps arriving.
+			auto last_received = received;
+			if (!cond.wait_for(lk, HTTP_BODY_TIMEOUT, [&]{
+				return !items.empty() || finished || received != last_received;
+			})) {
+				THROW(TimeOutError, "Timed out waiting for the request body");
+			}
+		}
+		if (items.empty()) {
+			if (eptr) {
+				std::rethrow_exception(eptr);
+			}
+			return nullptr;
+		}
+		frame = std::move(items.front());
+		items.pop_front();
+		if (paused && items.size() <= HTTP_BODY_QUEUE_SIZE / 2) {
+			paused = false;
+			_resume = resume;
+		}
+	}
+	if (_resume) {
+		_resume();
+	}
+	return std::make_unique<MsgPack>(ndjson ? json_load(frame) : MsgPack::unserialise(frame));
+}
+
+
 Request::Request(HttpClient* client)
 	: indented{-1},
 	  expect_100{false},
@@ -3165,6 +3959,10 @@ Request::Request(HttpClient* client)
 Request::~Request() noexcept
 {
 	try {
+		if (decoder) {
+			// Documents nobody is going to consume anymore
+			decoder->discard();
+		}
 		if (log) {
 			log->clear();
 		}
@@ -3179,6 +3977,30 @@ Request::_decode()
 {
 	L_CALL("Request::decode()");
 
+	if (decoder && _decoded_body.is_undefined()) {
+		// Collect all documents from the incremental decoder, a single
+		// MsgPack object is the body itself. Decoded objects are swapped
+		// in (assigning a MsgPack copies it).
+		std::vector<std::unique_ptr<MsgPack>> documents;
+		while (auto document = decoder->next()) {
+			documents.push_back(std::move(document));
+		}
+		if (decoder->is_ndjson()) {
+			ct_type = json_type;
+		} else {
+			ct_type = msgpack_type;
+		}
+		if (!decoder->is_ndjson() && documents.size() == 1) {
+			_decoded_body.swap(*documents[0]);
+		} else {
+			MsgPack decoded(MsgPack::Type::ARRAY);
+			for (auto& document : documents) {
+				decoded.append(std::move(*document));
+			}
+			_decoded_body.swap(decoded);
+		}
+	}
+
 	if (!raw.empty() && _decoded_body.is_undefined()) {
 		// Create a decoded MsgPack object from the raw body
 
@@ -3187,8 +4009,6 @@ Request::_decode()
 			ct_type_str = JSON_CONTENT_TYPE;
 		}
 
-		rapidjson::Document rdoc;
-
 		constexpr static auto _ = phf::make_phf({
 			hhl(JSON_CONTENT_TYPE),
 			hhl(MSGPACK_CONTENT_TYPE),
@@ -3198,41 +4018,36 @@ Request::_decode()
 			hhl(FORM_URLENCODED_CONTENT_TYPE),
 			hhl(X_FORM_URLENCODED_CONTENT_TYPE),
 		});
-		switch (_.fhhl(ct_type_str)) {
-			case _.fhhl(JSON_CONTENT_TYPE):
-				json_load(rdoc, raw);
-				_decoded_body = MsgPack(rdoc);
-				ct_type = json_type;
-				break;
-			case _.fhhl(NDJSON_CONTENT_TYPE):
-			case _.fhhl(X_NDJSON_CONTENT_TYPE):
-				_decoded_body = MsgPack(MsgPack::Type::ARRAY);
-				ct_type = json_type;
-				for (auto json : Split<std::string_view>(raw, '\n')) {
-					json_load(rdoc, json);
-					_decoded_body.append(rdoc);
-				}
-				break;
-			case _.fhhl(MSGPACK_CONTENT_TYPE):
-			case _.fhhl(X_MSGPACK_CONTENT_TYPE):
-				_decoded_body = MsgPack::unserialise(raw);
-				ct_type = msgpack_type;
-				break;
-			case _.fhhl(FORM_URLENCODED_CONTENT_TYPE):
-			case _.fhhl(X_FORM_URLENCODED_CONTENT_TYPE):
-				try {
-					json_load(rdoc, raw);
-					_decoded_body = MsgPack(rdoc);
+		// Decoded objects are returned (moved) and swapped in, assigning
+		// a MsgPack would copy it.
+		auto decoded = [&]() -> MsgPack {
+			switch (_.fhhl(ct_type_str)) {
+				case _.fhhl(JSON_CONTENT_TYPE):
+					ct_type = json_type;
+					return json_load(raw);
+				case _.fhhl(NDJSON_CONTENT_TYPE):
+				case _.fhhl(X_NDJSON_CONTENT_TYPE):
 					ct_type = json_type;
-				} catch (const std::exception&) {
-					_decoded_body = MsgPack(raw);
+					return ndjson_load(raw);
+				case _.fhhl(MSGPACK_CONTENT_TYPE):
+				case _.fhhl(X_MSGPACK_CONTENT_TYPE):
 					ct_type = msgpack_type;
-				}
-				break;
-			default:
-				_decoded_body = MsgPack(raw);
-				break;
-		}
+					return MsgPack::unserialise(raw);
+				case _.fhhl(FORM_URLENCODED_CONTENT_TYPE):
+				case _.fhhl(X_FORM_URLENCODED_CONTENT_TYPE):
+					try {
+						auto obj = json_load(raw);
+						ct_type = json_type;
+						return obj;
+					} catch (const std::exception&) {
+						ct_type = msgpack_type;
+						return MsgPack(raw);
+					}
+				default:
+					return MsgPack(raw);
+			}
+		}();
+		_decoded_body.swap(decoded);
 	}
 }
 
@@ -3376,6 +4191,8 @@ Request::to_text(bool decode)
 				}
 			}
 		}
+	} else if (decoder) {
+		request_text += "<body " + string::from_bytes(decoder->size()) + ">";
 	} else if (!body.empty()) {
 		if (!decode) {
 			if (body.size() > 1024 * 10) {
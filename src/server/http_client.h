@@ -25,8 +25,11 @@
 #include "config.h"                         // for XAPIAND_DATABASE_WAL
 
 #include <chrono>                           // for std::chrono, std::chrono::system_clock, std::chrono::time_point
+#include <condition_variable>               // for std::condition_variable
 #include <deque>                            // for std::deque
-#include <memory>                           // for shared_ptr
+#include <exception>                        // for std::exception_ptr
+#include <functional>                       // for std::function
+#include <memory>                           // for shared_ptr, std::unique_ptr
 #include <mutex>                            // for std::mutex, std::lock_guard
 #include <set>                              // for std::set
 #include <stdio.h>                          // for size_t
@@ -65,6 +68,10 @@ struct query_field_t;
 #define HTTP_TOTAL_COUNT_RESPONSE       (1 << 9)
 #define HTTP_MATCHES_ESTIMATED_RESPONSE (1 << 10)
 
+#define HTTP_BODY_DISPATCH_SIZE         (256 * 1024)  // start handling streamed bodies after this many bytes
+#define HTTP_BODY_TIMEOUT               std::chrono::seconds(60)  // give up waiting for more of a streamed body
+#define HTTP_BODY_QUEUE_SIZE            1024  // stop reading a streamed body when this many documents are waiting
+
 
 class AcceptLRU : private lru::LRU<std::string, accept_set_t> {
 	std::mutex qmtx;
@@ -134,6 +141,7 @@ enum class Encoding {
 
 // Available commands
 
+constexpr const char COMMAND_BULK[]        = COMMAND_PREFIX "bulk";
 constexpr const char COMMAND_CHECK[]       = COMMAND_PREFIX "check";
 constexpr const char COMMAND_COMMIT[]      = COMMAND_PREFIX "commit";
 constexpr const char COMMAND_COUNT[]       = COMMAND_PREFIX "count";
@@ -151,6 +159,7 @@ constexpr const char COMMAND_TOUCH[]       = COMMAND_PREFIX "touch";
 constexpr const char COMMAND_WAL[]         = COMMAND_PREFIX "wal";
 
 #define COMMAND_OPTIONS() \
+	OPTION(BULK) \
 	OPTION(CHECK) \
 	OPTION(COMMIT) \
 	OPTION(COUNT) \
@@ -200,6 +209,58 @@ public:
 };
 
 
+// Incremental decoder for request bodies made of a sequence of documents,
+// either newline delimited JSON or concatenated MsgPack objects. It's fed
+// by the HTTP parser as the body arrives and documents can be consumed
+// (by a different thread) while the rest of the body is still streaming.
+// The I/O thread only splits the body into raw documents (lines or
+// MsgPack objects), they are parsed by the consumer in next().
+// Once HTTP_BODY_QUEUE_SIZE documents are waiting, feed() asks the client
+// to stop reading, and resume is called when they've been consumed.
+class BodyDecoder {
+	std::mutex mtx;
+	std::condition_variable cond;
+
+	bool ndjson;
+	std::string buffer;
+
+	std::deque<std::string> items;
+	std::size_t received;
+	bool finished;
+	bool paused;
+	bool discarded;
+	std::exception_ptr eptr;
+	std::function<void()> resume;
+
+	void decode(const char* data, std::size_t length, bool final);
+	void push(std::string&& item);
+
+public:
+	BodyDecoder(bool ndjson_);
+
+	bool feed(const char* at, std::size_t length);
+	void finish();
+	void abort();
+	void discard();
+
+	std::unique_ptr<MsgPack> next();
+
+	void on_resume(std::function<void()>&& resume_) {
+		std::lock_guard<std::mutex> lk(mtx);
+		resume = std::move(resume_);
+	}
+
+	bool is_ndjson() const {
+		return ndjson;
+	}
+
+	std::size_t size() {
+		std::lock_guard<std::mutex> lk(mtx);
+		return received;
+	}
+};
+
+
 class Request {
 	MsgPack _decoded_body;
 
@@ -220,6 +281,7 @@ public:
 	std::string body;
 
 	std::string raw;
+	std::shared_ptr<BodyDecoder> decoder;
 
 	ct_type_t ct_type;
 
@@ -252,6 +314,10 @@ public:
 		return _decoded_body;
 	}
 
+	bool has_body() const {
+		return !raw.empty() || decoder;
+	}
+
 	std::string head();
 
 	std::string to_text(bool decode);
@@ -282,10 +348,19 @@ class HttpClient : public MetaBaseClient<HttpClient> {
 	static const http_parser_settings settings;
 
 	Request new_request;
+	std::shared_ptr<BodyDecoder> body_decoder;
 	mutable std::mutex runner_mutex;
 	std::deque<Request> requests;
 	Endpoints endpoints;
 
+#ifdef XAPIAND_CLUSTERING
+	// Nodes the current request reads from (for load-aware read routing).
+	std::vector<std::string> reading_nodes;
+#endif
+	void end_reading();
+
+	void enqueue_request(Request&& request);
+
 	static int message_begin_cb(http_parser* parser);
 	static int url_cb(http_parser* parser, const char* at, size_t length);
 	static int status_cb(http_parser* parser, const char* at, size_t length);
@@ -328,6 +403,7 @@ class HttpClient : public MetaBaseClient<HttpClient> {
 	void commit_view(Request& request, Response& response, enum http_method method, Command cmd);
 	void dump_view(Request& request, Response& response, enum http_method method, Command cmd);
 	void restore_view(Request& request, Response& response, enum http_method method, Command cmd);
+	void bulk_view(Request& request, Response& response, enum http_method method, Command cmd);
 	void schema_view(Request& request, Response& response, enum http_method method, Command cmd);
 #if XAPIAND_DATABASE_WAL
 	void wal_view(Request& request, Response& response, enum http_method method, Command cmd);
@@ -367,6 +443,8 @@ class HttpClient : public MetaBaseClient<HttpClient> {
 	Encoding resolve_encoding(Request& request);
 	std::string readable_encoding(Encoding e);
 	std::string encoding_http_response(Response& response, Encoding e, const std::string& response_obj, bool chunk, bool start, bool end);
+	const ct_type_t& resolve_stream_type(Request& request);
+	void write_http_chunk(Request& request, Response& response, const std::string& chunk, bool start, bool end);
 
 	friend Worker;
 
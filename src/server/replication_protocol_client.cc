@@ -25,6 +25,7 @@
 #ifdef XAPIAND_CLUSTERING
 
 #include <errno.h>                            // for errno
+#include <unordered_map>                      // for std::unordered_map
 #include <fcntl.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
@@ -38,8 +39,11 @@
 #include "fs.hh"                              // for delete_files, build_path_index
 #include "io.hh"                              // for io::*
 #include "length.h"
+#include "lru.h"                              // for lru::LRU
+#include "lz4/xxhash.h"                       // for XXH64
 #include "manager.h"                          // for XapiandManager
 #include "metrics.h"                          // for Metrics::metrics
+#include "opts.h"                             // for opts::*
 #include "tcp.h"                              // for TCP::connect
 #include "random.hh"                          // for random_int
 #include "repr.hh"                            // for repr
@@ -73,6 +77,131 @@
  */
 
 
+static std::vector<std::string>
+database_files(const std::string& path)
+{
+	static std::array<const std::string, 7> filenames = {
+		"termlist.glass",
+		"synonym.glass",
+		"spelling.glass",
+		"docdata.glass",
+		"position.glass",
+		"postlist.glass",
+		"iamglass"
+	};
+
+	std::vector<std::string> files;
+
+	for (const auto& filename : filenames) {
+		if (exists(path + filename)) {
+			files.push_back(filename);
+		}
+	}
+
+	for (size_t volume = 0; true; ++volume) {
+		auto filename = "docdata." + std::to_string(volume);
+		if (!exists(path + filename)) {
+			break;
+		}
+		files.push_back(filename);
+	}
+
+	return files;
+}
+
+
+// Reads the whole block, unless the end of file is reached
+static ssize_t
+read_block(int fd, std::string& block, size_t block_num)
+{
+	block.resize(REPLICATION_BLOCK_SIZE);
+	off_t offset = block_num * REPLICATION_BLOCK_SIZE;
+	size_t size = 0;
+	while (size < block.size()) {
+		auto r = io::pread(fd, &block[size], block.size() - size, offset + size);
+		if (r < 0) {
+			return -1;
+		}
+		if (r == 0) {
+			break;
+		}
+		size += r;
+	}
+	block.resize(size);
+	return size;
+}
+
+
+static inline void
+append_block_checksum(std::string& checksums, std::string_view block)
+{
+	uint64_t checksum = XXH64(block.data(), block.size(), 0);
+	for (int i = 56; i >= 0; i -= 8) {
+		checksums.push_back(static_cast<char>((checksum >> i) & 0xff));
+	}
+}
+
+
+// Checksums (packed as big-endian 64 bit integers) of every
+// REPLICATION_BLOCK_SIZE block in the file.
+static std::string
+file_block_checksums(int fd)
+{
+	std::string checksums;
+	std::string block;
+	for (size_t block_num = 0; read_block(fd, block, block_num) > 0; ++block_num) {
+		append_block_checksum(checksums, block);
+	}
+	return checksums;
+}
+
+
+// Block checksums of the follower's files are kept for as long as the
+// files don't change, so a bootstrap that has to be repeated (the leader
+// changing too fast, a lost connection...) doesn't hash them all again.
+// A stale entry can only make the rebuilt file fail its whole file
+// checksum, which drops the entry.
+static std::mutex file_block_checksums_mtx;
+static lru::LRU<std::string, std::pair<std::string, std::string>> file_block_checksums_cache(1000);
+
+
+static std::string
+cached_file_block_checksums(const std::string& path, int fd)
+{
+	struct stat st;
+	if (::fstat(fd, &st) == -1) {
+		return file_block_checksums(fd);
+	}
+	std::string stamp;
+	stamp.append(serialise_length(st.st_dev));
+	stamp.append(serialise_length(st.st_ino));
+	stamp.append(serialise_length(st.st_size));
+	stamp.append(serialise_length(st.st_mtime));
+	stamp.append(serialise_length(st.st_ctime));
+
+	std::unique_lock<std::mutex> lk(file_block_checksums_mtx);
+	auto it = file_block_checksums_cache.find(path);
+	if (it != file_block_checksums_cache.end() && it->second.first == stamp) {
+		return it->second.second;
+	}
+	lk.unlock();
+
+	auto checksums = file_block_checksums(fd);
+
+	lk.lock();
+	file_block_checksums_cache[path] = std::make_pair(std::move(stamp), checksums);
+	return checksums;
+}
+
+
+static void
+forget_file_block_checksums(const std::string& path)
+{
+	std::lock_guard<std::mutex> lk(file_block_checksums_mtx);
+	file_block_checksums_cache.erase(path);
+}
+
+
 ReplicationProtocolClient::ReplicationProtocolClient(const std::shared_ptr<Worker>& parent_, ev::loop_ref* ev_loop_, unsigned int ev_flags_, int sock_, double /*active_timeout_*/, double /*idle_timeout_*/, bool cluster_database_)
 	: MetaBaseClient<ReplicationProtocolClient>(std::move(parent_), ev_loop_, ev_flags_, sock_),
 	  LockableDatabase(),
@@ -85,6 +214,7 @@ ReplicationProtocolClient::ReplicationProtocolClient(const std::shared_ptr<Worke
 	  file_message_type('\xff'),
 	  temp_file_template("xapiand.XXXXXX"),
 	  cluster_database(cluster_database_),
+	  zero_copy(false),
 	  lk_db(this),
 	  changesets(0)
 {
@@ -121,6 +251,10 @@ ReplicationProtocolClient::~ReplicationProtocolClient() noexcept
 			delete_files(temp_directory.c_str());
 		}
 
+		if (!previous_database_path.empty()) {
+			delete_files(previous_database_path.c_str());
+		}
+
 		if (is_shutting_down() && !is_idle()) {
 			L_INFO("Replication client killed!");
 		}
@@ -208,6 +342,89 @@ ReplicationProtocolClient::send_file(ReplicationReplyType type, int fd)
 }
 
 
+std::string
+ReplicationProtocolClient::send_file_blocks(int fd, std::string_view checksums)
+{
+	L_CALL("ReplicationProtocolClient::send_file_blocks(%d, <checksums>)", fd);
+
+	// Blocks with the same checksum the follower has at the same position
+	// are reused from the follower's own file, only the rest are sent.
+	// The checksum of the whole file goes last, so the follower can verify
+	// the file it rebuilt, and the checksums of all the blocks that were
+	// sent are returned, so a retry can be diffed against them.
+	constexpr size_t max_run_blocks = 16;
+
+	std::string unchanged;
+	size_t unchanged_from = 0;
+	size_t unchanged_blocks = 0;
+
+	std::string changed;
+	size_t changed_from = 0;
+
+	auto flush_unchanged = [&]() {
+		if (unchanged_blocks) {
+			unchanged.append(serialise_length(unchanged_from));
+			unchanged.append(serialise_length(unchanged_blocks));
+			unchanged_blocks = 0;
+		}
+	};
+
+	auto flush_changed = [&]() {
+		if (!changed.empty()) {
+			send_message(ReplicationReplyType::REPLY_DB_FILEBLOCK, serialise_length(changed_from * REPLICATION_BLOCK_SIZE) + changed);
+			changed.clear();
+		}
+	};
+
+	size_t file_size = 0;
+	size_t remote_blocks = checksums.size() / 8;
+
+	std::unique_ptr<XXH64_state_t, decltype(&XXH64_freeState)> xxh_state(XXH64_createState(), &XXH64_freeState);
+	XXH64_reset(xxh_state.get(), 0);
+
+	std::string sent_checksums;
+	std::string block;
+	ssize_t r;
+	for (size_t block_num = 0; (r = read_block(fd, block, block_num)) > 0; ++block_num) {
+		file_size += r;
+		XXH64_update(xxh_state.get(), block.data(), block.size());
+		auto checksum_pos = sent_checksums.size();
+		append_block_checksum(sent_checksums, block);
+		auto checksum = std::string_view(sent_checksums).substr(checksum_pos);
+		if (block_num < remote_blocks && checksums.substr(block_num * 8, 8) == checksum) {
+			flush_changed();
+			if (!unchanged_blocks) {
+				unchanged_from = block_num;
+			}
+			++unchanged_blocks;
+		} else {
+			flush_unchanged();
+			if (changed.empty()) {
+				changed_from = block_num;
+			}
+			changed.append(block);
+			if (changed.size() >= max_run_blocks * REPLICATION_BLOCK_SIZE) {
+				flush_changed();
+			}
+		}
+	}
+	flush_changed();
+	flush_unchanged();
+
+	if (r < 0) {
+		auto read_errno = errno;
+		io::close(fd);
+		THROW(Error, "Cannot read file: %s (%d): %s", error::name(read_errno), read_errno, error::description(read_errno));
+	}
+
+	io::close(fd);
+
+	send_message(ReplicationReplyType::REPLY_DB_FILEDIFF, serialise_length(file_size) + serialise_length(XXH64_digest(xxh_state.get())) + unchanged);
+
+	return sent_checksums;
+}
+
+
 void
 ReplicationProtocolClient::replication_server(ReplicationMessageType type, const std::string& message)
 {
@@ -245,6 +462,19 @@ ReplicationProtocolClient::msg_get_changesets(const std::string& message)
 	auto remote_uuid = unserialise_string(&p, p_end);
 	auto remote_revision = unserialise_length(&p, p_end);
 	auto endpoint_path = unserialise_string(&p, p_end);
+	// Older followers do not send flags and expect compressed files
+	auto remote_flags = p != p_end ? unserialise_length(&p, p_end) : 0;
+
+	zero_copy = (remote_flags & REPLICATION_ZERO_COPY) != 0;
+
+	bool block_checksums = (remote_flags & REPLICATION_BLOCK_CHECKSUMS) != 0;
+	std::unordered_map<std::string, std::string> remote_checksums;
+	if (block_checksums) {
+		while (p != p_end) {
+			auto filename = unserialise_string(&p, p_end);
+			remote_checksums[std::string(filename)] = std::string(unserialise_string(&p, p_end));
+		}
+	}
 
 	flags = DB_WRITABLE;
 	endpoints = Endpoints{Endpoint{endpoint_path}};
@@ -271,6 +501,17 @@ ReplicationProtocolClient::msg_get_changesets(const std::string& message)
 
 	if (from_revision < revision) {
 		if (from_revision == 0) {
+			if ((remote_flags & REPLICATION_BLOCK_DIFF) != 0 && (remote_flags & REPLICATION_BLOCK_CHECKSUMS) == 0) {
+				// The follower already has some version of the database, ask for
+				// the checksums of its blocks so only changed blocks are sent.
+				send_message(ReplicationReplyType::REPLY_GET_CHECKSUMS, "");
+
+				auto ends = std::chrono::system_clock::now();
+				_total_sent_bytes = total_sent_bytes - _total_sent_bytes;
+				L(LOG_DEBUG, WHITE, "\"GET_CHANGESETS {%s} %llu %s\" OK CHECKSUMS %s %s", remote_uuid, remote_revision, repr(endpoint_path), string::from_bytes(_total_sent_bytes), string::from_delta(begins, ends));
+				return;
+			}
+
 			int whole_db_copies_left = 5;
 
 			while (true) {
@@ -279,36 +520,22 @@ ReplicationProtocolClient::msg_get_changesets(const std::string& message)
 					serialise_string(uuid) +
 					serialise_length(revision));
 
-				static std::array<const std::string, 7> filenames = {
-					"termlist.glass",
-					"synonym.glass",
-					"spelling.glass",
-					"docdata.glass",
-					"position.glass",
-					"postlist.glass",
-					"iamglass"
-				};
-
-				for (const auto& filename : filenames) {
+				std::unordered_map<std::string, std::string> sent_checksums;
+				for (const auto& filename : database_files(endpoints[0].path)) {
 					auto path = endpoints[0].path + filename;
 					int fd = io::open(path.c_str());
 					if (fd != -1) {
 						send_message(ReplicationReplyType::REPLY_DB_FILENAME, filename);
-						send_file(ReplicationReplyType::REPLY_DB_FILEDATA, fd);
+						if (block_checksums) {
+							auto it = remote_checksums.find(filename);
+							sent_checksums[filename] = send_file_blocks(fd, it != remote_checksums.end() ? it->second : "");
+						} else {
+							send_file(ReplicationReplyType::REPLY_DB_FILEDATA, fd);
+						}
 					}
 				}
 
-				for (size_t volume = 0; true; ++volume) {
-					auto filename = "docdata." + std::to_string(volume);
-					auto path = endpoints[0].path + filename;
-					int fd = io::open(path.c_str());
-					if (fd != -1) {
-						send_message(ReplicationReplyType::REPLY_DB_FILENAME, filename);
-						send_file(ReplicationReplyType::REPLY_DB_FILEDATA, fd);
-						continue;
-					}
-					break;
-				}
+				wait_zero_copy_sent();
 
 				lk_db.lock();
 				auto final_revision = db()->get_revision();
@@ -321,6 +548,10 @@ ReplicationProtocolClient::msg_get_changesets(const std::string& message)
 					break;
 				}
 
+				// The follower keeps the files it just got and rebuilds the
+				// next copy from them, so retries only send what changed.
+				remote_checksums = std::move(sent_checksums);
+
 				if (whole_db_copies_left == 0) {
 					send_message(ReplicationReplyType::REPLY_FAIL, "Database changing too fast");
 
@@ -401,6 +632,15 @@ ReplicationProtocolClient::replication_client(ReplicationReplyType type, const s
 		case ReplicationReplyType::REPLY_CHANGESET:
 			reply_changeset(message);
 			return;
+		case ReplicationReplyType::REPLY_GET_CHECKSUMS:
+			reply_get_checksums(message);
+			return;
+		case ReplicationReplyType::REPLY_DB_FILEBLOCK:
+			reply_db_fileblock(message);
+			return;
+		case ReplicationReplyType::REPLY_DB_FILEDIFF:
+			reply_db_filediff(message);
+			return;
 		default: {
 			std::string errmsg("Unexpected message type ");
 			errmsg += std::to_string(toUType(type));
@@ -419,6 +659,43 @@ ReplicationProtocolClient::reply_welcome(const std::string&)
 	message.append(serialise_length(db()->get_revision()));
 	message.append(serialise_string(endpoints[0].path));
 
+	size_t local_flags = opts.replica_compression ? 0 : REPLICATION_ZERO_COPY;
+	if (db()->get_revision() != 0) {
+		local_flags |= REPLICATION_BLOCK_DIFF;
+	}
+	message.append(serialise_length(local_flags));
+
+	send_message(static_cast<ReplicationReplyType>(ReplicationMessageType::MSG_GET_CHANGESETS), message);
+}
+
+
+void
+ReplicationProtocolClient::reply_get_checksums(const std::string&)
+{
+	L_CALL("ReplicationProtocolClient::reply_get_checksums(<message>)");
+
+	std::string message;
+
+	message.append(serialise_string(db()->get_uuid()));
+	message.append(serialise_length(db()->get_revision()));
+	message.append(serialise_string(endpoints[0].path));
+
+	size_t local_flags = opts.replica_compression ? 0 : REPLICATION_ZERO_COPY;
+	local_flags |= REPLICATION_BLOCK_DIFF | REPLICATION_BLOCK_CHECKSUMS;
+	message.append(serialise_length(local_flags));
+
+	for (const auto& filename : database_files(endpoints[0].path)) {
+		auto path = endpoints[0].path + filename;
+		int fd = io::open(path.c_str());
+		if (fd != -1) {
+			message.append(serialise_string(filename));
+			message.append(serialise_string(cached_file_block_checksums(path, fd)));
+			io::close(fd);
+		}
+	}
+
+	L_REPLICATION("ReplicationProtocolClient::reply_get_checksums: %s (%s of checksums)", repr(endpoints[0].path), string::from_bytes(message.size()));
+
 	send_message(static_cast<ReplicationReplyType>(ReplicationMessageType::MSG_GET_CHANGESETS), message);
 }
 
@@ -517,6 +794,11 @@ ReplicationProtocolClient::reply_db_filename(const std::string& filename)
 	ASSERT(!switch_database_path.empty());
 
 	file_path = switch_database_path + "/" + filename;
+	// Retries are built from the files received by the previous attempt.
+	file_source_path = previous_database_path + "/" + filename;
+	if (previous_database_path.empty() || !exists(file_source_path)) {
+		file_source_path = endpoints[0].path + filename;
+	}
 
 	L_REPLICATION("ReplicationProtocolClient::reply_db_filename(%s): %s", repr(filename), repr(endpoints[0].path));
 }
@@ -539,6 +821,111 @@ ReplicationProtocolClient::reply_db_filedata(const std::string& tmp_file)
 }
 
 
+void
+ReplicationProtocolClient::reply_db_fileblock(const std::string& message)
+{
+	L_CALL("ReplicationProtocolClient::reply_db_fileblock(<message>)");
+
+	ASSERT(!switch_database_path.empty());
+
+	const char *p = message.data();
+	const char *p_end = p + message.size();
+	size_t offset = unserialise_length(&p, p_end);
+
+	int fd = io::open(file_path.c_str(), O_WRONLY | O_CREAT);
+	if (fd == -1) {
+		L_ERR("Cannot open file %s: %s (%d): %s", file_path, error::name(errno), errno, error::description(errno));
+		detach();
+		return;
+	}
+	if (io::pwrite(fd, p, p_end - p, offset) != p_end - p) {
+		L_ERR("Cannot write to file %s: %s (%d): %s", file_path, error::name(errno), errno, error::description(errno));
+		io::close(fd);
+		detach();
+		return;
+	}
+	io::close(fd);
+
+	L_REPLICATION("ReplicationProtocolClient::reply_db_fileblock(%s, %zu, %zu): %s", repr(file_path), offset, p_end - p, repr(endpoints[0].path));
+}
+
+
+void
+ReplicationProtocolClient::reply_db_filediff(const std::string& message)
+{
+	L_CALL("ReplicationProtocolClient::reply_db_filediff(<message>)");
+
+	ASSERT(!switch_database_path.empty());
+
+	const char *p = message.data();
+	const char *p_end = p + message.size();
+	size_t file_size = unserialise_length(&p, p_end);
+	uint64_t file_checksum = unserialise_length(&p, p_end);
+
+	int src_fd = io::open(file_source_path.c_str());
+	if (src_fd == -1 && p != p_end) {
+		L_ERR("Cannot open file %s: %s (%d): %s", file_source_path, error::name(errno), errno, error::description(errno));
+		detach();
+		return;
+	}
+
+	int fd = io::open(file_path.c_str(), O_RDWR | O_CREAT);
+	if (fd == -1) {
+		L_ERR("Cannot open file %s: %s (%d): %s", file_path, error::name(errno), errno, error::description(errno));
+		io::close(src_fd);
+		detach();
+		return;
+	}
+
+	// Copy unchanged blocks from the current file.
+	size_t reused = 0;
+	std::string block;
+	while (p != p_end) {
+		size_t block_num = unserialise_length(&p, p_end);
+		size_t blocks = unserialise_length(&p, p_end);
+		for (; blocks; --blocks, ++block_num) {
+			auto r = read_block(src_fd, block, block_num);
+			if (r <= 0 || io::pwrite(fd, block.data(), block.size(), block_num * REPLICATION_BLOCK_SIZE) != r) {
+				L_ERR("Cannot copy block %zu from %s to %s: %s (%d): %s", block_num, file_source_path, file_path, error::name(errno), errno, error::description(errno));
+				io::close(fd);
+				io::close(src_fd);
+				detach();
+				return;
+			}
+			reused += r;
+		}
+	}
+
+	io::close(src_fd);
+
+	if (io::ftruncate(fd, file_size) == -1) {
+		L_ERR("Cannot truncate file %s: %s (%d): %s", file_path, error::name(errno), errno, error::description(errno));
+		io::close(fd);
+		detach();
+		return;
+	}
+
+	// Blocks are only matched by their own checksums, verify the
+	// rebuilt file as a whole before it's used.
+	std::unique_ptr<XXH64_state_t, decltype(&XXH64_freeState)> xxh_state(XXH64_createState(), &XXH64_freeState);
+	XXH64_reset(xxh_state.get(), 0);
+	ssize_t r;
+	for (size_t block_num = 0; (r = read_block(fd, block, block_num)) > 0; ++block_num) {
+		XXH64_update(xxh_state.get(), block.data(), block.size());
+	}
+	io::close(fd);
+
+	if (r < 0 || XXH64_digest(xxh_state.get()) != file_checksum) {
+		L_ERR("Rebuilt file %s from %s is corrupt", file_path, file_source_path);
+		forget_file_block_checksums(file_source_path);
+		detach();
+		return;
+	}
+
+	L_REPLICATION("ReplicationProtocolClient::reply_db_filediff(%s): %s of %s reused from %s: %s", repr(file_path), string::from_bytes(reused), string::from_bytes(file_size), repr(file_source_path), repr(endpoints[0].path));
+}
+
+
 void
 ReplicationProtocolClient::reply_db_footer(const std::string& message)
 {
@@ -550,8 +937,15 @@ ReplicationProtocolClient::reply_db_footer(const std::string& message)
 
 	ASSERT(!switch_database_path.empty());
 
+	if (!previous_database_path.empty()) {
+		delete_files(previous_database_path.c_str());
+		previous_database_path.clear();
+	}
+
 	if (revision != current_revision) {
-		delete_files(switch_database_path.c_str());
+		// The files are kept, the leader retries by sending only the
+		// blocks changed since.
+		previous_database_path = std::move(switch_database_path);
 		switch_database_path.clear();
 	}
 
@@ -663,7 +1057,8 @@ ReplicationProtocolClient::on_read(const char *buf, ssize_t received)
 		char type = *p++;
 		L_REPLICA_WIRE("on_read message: %s {state:%s}", repr(std::string(1, type)), StateNames(state));
 		switch (type) {
-			case FILE_FOLLOWS: {
+			case FILE_FOLLOWS:
+			case RAW_FILE_FOLLOWS: {
 				char path[PATH_MAX];
 				if (temp_directory.empty()) {
 					if (temp_directory_template.empty()) {
@@ -690,7 +1085,11 @@ ReplicationProtocolClient::on_read(const char *buf, ssize_t received)
 				} else {
 					L_REPLICA("Start reading file: %s (%d)", path, file_descriptor);
 				}
-				read_file();
+				if (type == RAW_FILE_FOLLOWS) {
+					read_raw_file();
+				} else {
+					read_file();
+				}
 				processed += p - o;
 				buffer.clear();
 				return processed;
@@ -816,12 +1215,49 @@ ReplicationProtocolClient::send_file(char type_as_char, int fd)
 {
 	L_CALL("ReplicationProtocolClient::send_file(<type_as_char>, <fd>)");
 
-	std::string buf;
-	buf += FILE_FOLLOWS;
-	buf += type_as_char;
-	write(buf);
+	if (zero_copy) {
+		// The file goes from the page cache to the socket as-is, straight
+		// from the live file, so its size must be known upfront by the
+		// follower. The buffer is released (and the promise fulfilled)
+		// once it's been sent, see wait_zero_copy_sent().
+		auto sent = std::make_shared<std::promise<void>>();
+		zero_copy_sent.push_back(sent->get_future());
+		std::shared_ptr<Buffer> file(new Buffer(fd, true), [sent](Buffer* buffer) {  // takes ownership of fd
+			delete buffer;
+			sent->set_value();
+		});
 
-	MetaBaseClient<ReplicationProtocolClient>::send_file(fd);
+		std::string buf;
+		buf += RAW_FILE_FOLLOWS;
+		buf += type_as_char;
+		buf += serialise_length(file->full_size());
+		write(buf);
+
+		write_buffer(file);
+	} else {
+		std::string buf;
+		buf += FILE_FOLLOWS;
+		buf += type_as_char;
+		write(buf);
+
+		MetaBaseClient<ReplicationProtocolClient>::send_file(fd);
+		io::close(fd);
+	}
+}
+
+
+void
+ReplicationProtocolClient::wait_zero_copy_sent()
+{
+	L_CALL("ReplicationProtocolClient::wait_zero_copy_sent()");
+
+	// Zero-copy buffers are only queued, wait for them to actually be
+	// sent (or dropped, if the connection closes) so a later revision
+	// check covers what the follower got.
+	for (auto& sent : zero_copy_sent) {
+		sent.wait();
+	}
+	zero_copy_sent.clear();
 }
 
 
@@ -28,6 +28,7 @@
 #ifdef XAPIAND_CLUSTERING
 
 #include <deque>                            // for std::deque
+#include <future>                           // for std::future, std::promise
 #include <memory>                           // for shared_ptr
 #include <mutex>                            // for std::mutex
 #include <string>                           // for std::string
@@ -36,6 +37,7 @@
 
 #include "base_client.h"                    // for MetaBaseClient
 #include "lock_database.h"                  // for LockableDatabase
+#include "string_view.hh"                   // for std::string_view
 #include "threadpool.hh"                    // for Task
 
 
@@ -48,6 +50,17 @@
 
 
 #define FILE_FOLLOWS '\xfd'
+#define RAW_FILE_FOLLOWS '\xfc'
+
+
+// Flags sent by the follower in MSG_GET_CHANGESETS
+#define REPLICATION_ZERO_COPY       0x01  // Whole database files can be sent uncompressed using zero-copy
+#define REPLICATION_BLOCK_DIFF      0x02  // Whole database copies can be built from the follower's files and changed blocks
+#define REPLICATION_BLOCK_CHECKSUMS 0x04  // Block checksums of the follower's files follow
+
+
+// Size of the blocks compared between leader and follower for block-level diffs
+#define REPLICATION_BLOCK_SIZE (64 * 1024)
 
 
 enum class ReplicaState {
@@ -102,6 +115,9 @@ enum class ReplicationReplyType {
 	REPLY_DB_FILEDATA,          // Contents of a file in a DB copy
 	REPLY_DB_FOOTER,            // End of a whole DB copy
 	REPLY_CHANGESET,            // A changeset file is being sent
+	REPLY_GET_CHECKSUMS,        // Ask the follower for block checksums of its files
+	REPLY_DB_FILEBLOCK,         // Changed blocks of a file in a DB copy
+	REPLY_DB_FILEDIFF,          // Unchanged blocks of a file in a DB copy (copied from the follower's file)
 	REPLY_MAX
 };
 
@@ -109,10 +125,10 @@ enum class ReplicationReplyType {
 inline const std::string& ReplicationReplyTypeNames(ReplicationReplyType type) {
 	static const std::string _[] = {
 		"REPLY_WELCOME",
-		"REPLY_GET_CHANGESETS",
 		"REPLY_END_OF_CHANGES", "REPLY_FAIL",
 		"REPLY_DB_HEADER", "REPLY_DB_FILENAME", "REPLY_DB_FILEDATA", "REPLY_DB_FOOTER",
 		"REPLY_CHANGESET",
+		"REPLY_GET_CHECKSUMS", "REPLY_DB_FILEBLOCK", "REPLY_DB_FILEDIFF",
 	};
 	auto idx = static_cast<size_t>(type);
 	if (idx >= 0 && idx < sizeof(_) / sizeof(_[0])) {
@@ -151,6 +167,10 @@ class ReplicationProtocolClient : public MetaBaseClient<ReplicationProtocolClien
 	std::deque<Buffer> messages;
 	bool cluster_database;
 
+	// Send whole database files using zero-copy (negotiated by the follower)
+	bool zero_copy;
+	std::vector<std::future<void>> zero_copy_sent;
+
 	ReplicationProtocolClient(const std::shared_ptr<Worker>& parent_, ev::loop_ref* ev_loop_, unsigned int ev_flags_, int sock_, double active_timeout_, double idle_timeout_, bool cluster_database_ = false);
 
 	bool is_idle() const;
@@ -167,11 +187,13 @@ public:
 	lock_database lk_db;
 
 	std::string switch_database_path;
+	std::string previous_database_path;
 	std::shared_ptr<Database> switch_database;
 
 	std::unique_ptr<DatabaseWAL> wal;
 
 	std::string file_path;
+	std::string file_source_path;
 
 	std::string current_uuid;
 	Xapian::rev current_revision;
@@ -187,6 +209,7 @@ public:
 
 	void send_message(ReplicationReplyType type, const std::string& message);
 	void send_file(ReplicationReplyType type, int fd);
+	std::string send_file_blocks(int fd, std::string_view checksums);
 
 	void replication_server(ReplicationMessageType type, const std::string& message);
 	void replication_client(ReplicationReplyType type, const std::string& message);
@@ -200,10 +223,14 @@ public:
 	void reply_db_filedata(const std::string& message);
 	void reply_db_footer(const std::string& message);
 	void reply_changeset(const std::string& message);
+	void reply_get_checksums(const std::string& message);
+	void reply_db_fileblock(const std::string& message);
+	void reply_db_filediff(const std::string& message);
 
 	char get_message(std::string &result, char max_type);
 	void send_message(char type_as_char, const std::string& message);
 	void send_file(char type_as_char, int fd);
+	void wait_zero_copy_sent();
 
 	bool init_replication() noexcept;
 	bool init_replication(const Endpoint &src_endpoint, const Endpoint &dst_endpoint) noexcept;
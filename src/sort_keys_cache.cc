@@ -0,0 +1,149 @@
+/*
+ * Copyright (C) 2019 Dubalu LLC. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "sort_keys_cache.h"
+
+#include "log.h"                  // for L_CALL
+#include "metrics.h"              // for Metrics::metrics
+#include "repr.hh"                // for repr
+
+
+bool
+SortKeysColumn::get(Xapian::docid did, std::string& result)
+{
+	auto idx = did / page_size;
+	std::lock_guard<std::mutex> lk(mtx);
+	if (idx >= pages.size() || !pages[idx]) {
+		return false;
+	}
+	const auto& page = *pages[idx];
+	const auto& entry = page.entries[did % page_size];
+	if (entry.second == 0) {
+		return false;
+	}
+	result.append(page.data, entry.first, entry.second - 1);
+	return true;
+}
+
+
+void
+SortKeysColumn::set(Xapian::docid did, std::string_view key)
+{
+	auto idx = did / page_size;
+	std::lock_guard<std::mutex> lk(mtx);
+	if (counted && cache_bytes->load() >= max_bytes) {
+		return;
+	}
+	size_t allocated = 0;
+	if (idx >= pages.size()) {
+		allocated += (idx + 1 - pages.size()) * sizeof(std::unique_ptr<Page>);
+		pages.resize(idx + 1);
+	}
+	auto& page = pages[idx];
+	if (!page) {
+		page = std::make_unique<Page>();
+		allocated += sizeof(Page);
+	}
+	auto& entry = page->entries[did % page_size];
+	if (entry.second == 0) {
+		auto capacity = page->data.capacity();
+		entry.first = page->data.size();
+		entry.second = key.size() + 1;
+		page->data.append(key.data(), key.size());
+		allocated += page->data.capacity() - capacity;
+	}
+	bytes += allocated;
+	if (counted) {
+		*cache_bytes += allocated;
+	}
+}
+
+
+void
+SortKeysColumn::detach()
+{
+	std::lock_guard<std::mutex> lk(mtx);
+	if (counted) {
+		*cache_bytes -= bytes;
+		counted = false;
+	}
+}
+
+
+std::shared_ptr<SortKeysColumn>
+SortKeysCache::get(const std::string& key, const std::string& revision)
+{
+	L_CALL("SortKeysCache::get(%s, %s)", repr(key), repr(revision));
+
+	std::shared_ptr<SortKeysColumn> column;
+	bool hit = false;
+	size_t evicted = 0;
+	{
+		std::lock_guard<std::mutex> lk(mtx);
+		auto it = find(key);
+		if (it != end() && it->second.first == revision) {
+			column = it->second.second;
+			hit = true;
+		} else {
+			// Columns at other revisions are replaced below,
+			// which doesn't go through the drop callback.
+			if (it != end()) {
+				it->second.second->detach();
+			}
+			column = std::make_shared<SortKeysColumn>(_bytes, max_size());
+			insert_and([&](const std::pair<std::string, std::shared_ptr<SortKeysColumn>>& value, ssize_t, ssize_t max_bytes) {
+				if (static_cast<ssize_t>(_bytes->load()) >= max_bytes) {
+					value.second->detach();
+					++evicted;
+					return lru::DropAction::evict;
+				}
+				return lru::DropAction::stop;
+			}, std::make_pair(key, std::make_pair(revision, column)));
+		}
+	}
+
+	if (hit) {
+		Metrics::metrics()
+			.xapiand_sort_keys_cache_hits
+			.Increment();
+		return column;
+	}
+
+	Metrics::metrics()
+		.xapiand_sort_keys_cache_misses
+		.Increment();
+	if (evicted != 0) {
+		Metrics::metrics()
+			.xapiand_sort_keys_cache_evictions
+			.Increment(evicted);
+	}
+	return column;
+}
+
+
+size_t
+SortKeysCache::columns()
+{
+	std::lock_guard<std::mutex> lk(mtx);
+	return size();
+}
@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2019 Dubalu LLC. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#pragma once
+
+#include <array>                  // for std::array
+#include <atomic>                 // for std::atomic
+#include <cstdint>                // for uint32_t
+#include <memory>                 // for std::shared_ptr, std::unique_ptr
+#include <mutex>                  // for std::mutex
+#include <string>                 // for std::string
+#include "string_view.hh"         // for std::string_view
+#include <utility>                // for std::pair
+#include <vector>                 // for std::vector
+#include <xapian.h>               // for Xapian::docid
+
+#include "lru.h"                  // for lru::LRU
+#include "opts.h"                 // for opts::*
+
+
+// Ready-made sort keys of a slot (already encoded for their position in
+// the sort key), indexed by docid in flat pages which are filled in as
+// documents get sorted. A column is only valid for one revision.
+//
+// Every column adds the bytes it allocates (pages and key data) to the
+// bytes of its cache, and stops growing once the cache is over budget.
+class SortKeysColumn {
+	static constexpr size_t page_size = 4096;
+
+	struct Page {
+		// Offset in data and length plus one (zero when missing) of each key.
+		std::array<std::pair<uint32_t, uint32_t>, page_size> entries{};
+		std::string data;
+	};
+
+	std::mutex mtx;
+	std::vector<std::unique_ptr<Page>> pages;
+
+	std::shared_ptr<std::atomic<size_t>> cache_bytes;
+	size_t max_bytes;
+	size_t bytes;
+	bool counted;
+
+public:
+	SortKeysColumn(std::shared_ptr<std::atomic<size_t>> cache_bytes_, size_t max_bytes_)
+		: cache_bytes{std::move(cache_bytes_)},
+		  max_bytes{max_bytes_},
+		  bytes{0},
+		  counted{true} { }
+
+	// Appends the key for did to result, if it's there.
+	bool get(Xapian::docid did, std::string& result);
+	void set(Xapian::docid did, std::string_view key);
+
+	// Takes the column out of the bytes of the cache, once it's dropped from
+	// it (searches still using the column keep it until they're done).
+	void detach();
+};
+
+
+class SortKeysCache : lru::LRU<std::string, std::pair<std::string, std::shared_ptr<SortKeysColumn>>> {
+	std::mutex mtx;
+
+	std::shared_ptr<std::atomic<size_t>> _bytes;
+
+public:
+	// The LRU is bounded by the bytes held by its columns, not by their number.
+	SortKeysCache(ssize_t max_bytes)
+		: LRU(max_bytes),
+		  _bytes{std::make_shared<std::atomic<size_t>>(0)} { }
+
+	// Returns the column for key at the given revision,
+	// columns at any other revision are replaced by a new one.
+	std::shared_ptr<SortKeysColumn> get(const std::string& key, const std::string& revision);
+
+	size_t bytes() const noexcept {
+		return _bytes->load();
+	}
+
+	size_t columns();
+};
+
+
+inline auto& sort_keys_cache(bool create = true) {
+	static auto sort_keys_cache = create && opts.sort_keys_cache_size ? std::make_unique<SortKeysCache>(opts.sort_keys_cache_size) : nullptr;
+	return sort_keys_cache;
+}
@@ -26,6 +26,7 @@
 #include <limits>                // for std::numeric_limits
 #include <memory>
 #include "string_view.hh"        // for std::string_view
+#include <sys/mman.h>            // for PROT_READ, MAP_SHARED, MAP_FAILED
 #include <unistd.h>
 
 #include "compressor_lz4.h"      // for LZ4CompressFile, LZ4CompressData, LZ4...
@@ -75,6 +76,8 @@ constexpr int STORAGE_ASYNC_SYNC       = 0x04;  // fsync (or full_fsync) is asyn
 constexpr int STORAGE_FULL_SYNC        = 0x08;  // Try to ensure changes are really written to disk.
 constexpr int STORAGE_NO_SYNC          = 0x10;  // Don't attempt to ensure changes have hit disk.
 constexpr int STORAGE_COMPRESS         = 0x20;  // Compress data in storage.
+constexpr int STORAGE_DEFERRED_WRITE   = 0x40;  // Keep the last (partial) block in memory until commit.
+constexpr int STORAGE_MMAP             = 0x80;  // Read bins from a memory mapping (read-only storages).
 
 constexpr int STORAGE_FLAG_COMPRESSED  = 0x01;
 constexpr int STORAGE_FLAG_DELETED     = 0x02;
@@ -256,10 +259,16 @@ class Storage {
 	LZ4DecompressFile decFile;
 	LZ4DecompressFile::iterator decFile_it;
 
+	LZ4DecompressData decData;
+
+	const char* mmap_data;
+	size_t mmap_size;
+
 	XXH32_state_t* xxh_state;
 	uint32_t bin_hash;
 
 	bool changed;
+	bool buffer_dirty;
 
 	void growfile() {
 		if (free_blocks <= STORAGE_BLOCKS_MIN_FREE) {
@@ -313,6 +322,85 @@ class Storage {
 #endif
 	}
 
+	void map_file() {
+		// (Re)map the whole file when it grew since the last mapping,
+		// on failure reads simply fall back to pread.
+		off_t file_size = io::lseek(fd, 0, SEEK_END);
+		if unlikely(file_size == -1) {
+			close();
+			L_ERR("IO error in %s: lseek: %s (%d): %s", repr(path.empty() ? base_path : path), error::name(errno), errno, error::description(errno));
+			THROW(StorageIOError, error::description(errno));
+		}
+		if (static_cast<size_t>(file_size) == mmap_size) {
+			return;
+		}
+		unmap_file();
+		if (file_size) {
+			void* addr = io::mmap(nullptr, file_size, PROT_READ, MAP_SHARED, fd, 0);
+			if unlikely(addr == MAP_FAILED) {
+				L_WARNING_ONCE("Cannot map storage file: %s (%d): %s", error::name(errno), errno, error::description(errno));
+				return;
+			}
+			mmap_data = static_cast<const char*>(addr);
+			mmap_size = file_size;
+		}
+	}
+
+	void unmap_file() {
+		if (mmap_data != nullptr) {
+			io::munmap(const_cast<char*>(mmap_data), mmap_size);
+			mmap_data = nullptr;
+			mmap_size = 0;
+		}
+	}
+
+	std::string read_mapped(uint32_t limit, void* args) {
+		// Same as read(), but straight from the mapping: the whole bin is
+		// bounds checked against the mapped range and validated, and then
+		// copied (or decompressed) only once.
+		off_t offset = bin_offset;
+		if (offset >= header.head.offset * STORAGE_ALIGNMENT || offset >= limit * STORAGE_ALIGNMENT) {
+			THROW(StorageEOF, "Storage EOF");
+		}
+
+		if unlikely(offset + sizeof(StorageBinHeader) > mmap_size) {
+			THROW(StorageCorruptVolume, "Incomplete bin header");
+		}
+		memcpy(&bin_header, mmap_data + offset, sizeof(StorageBinHeader));
+		offset += sizeof(StorageBinHeader);
+		bin_header.validate(param, args);
+
+		if unlikely(offset + bin_header.size + sizeof(StorageBinFooter) > mmap_size) {
+			THROW(StorageCorruptVolume, "Incomplete bin data");
+		}
+		const char* data = mmap_data + offset;
+
+		std::string ret;
+		if (bin_header.flags & STORAGE_FLAG_COMPRESSED) {
+			decData.reset(data, bin_header.size, STORAGE_MAGIC);
+			for (auto it = decData.begin(); it; ++it) {
+				ret.append(*it);
+			}
+			bin_hash = decData.get_digest();
+		} else {
+			ret.assign(data, bin_header.size);
+			bin_hash = XXH32(data, bin_header.size, STORAGE_MAGIC);
+		}
+		offset += bin_header.size;
+
+		memcpy(&bin_footer, mmap_data + offset, sizeof(StorageBinFooter));
+		offset += sizeof(StorageBinFooter);
+		bin_footer.validate(param, args, bin_hash);
+
+		// Align the bin_offset to the next storage alignment
+		bin_offset = ((offset + STORAGE_ALIGNMENT - 1) / STORAGE_ALIGNMENT) * STORAGE_ALIGNMENT;
+
+		bin_header.size = 0;
+		bin_size = 0;
+
+		return ret;
+	}
+
 	void write_bin(char** buffer_, uint32_t& buffer_offset_, const char** data_bin_, size_t& size_bin_) {
 		size_t size = STORAGE_BLOCK_SIZE - buffer_offset_;
 		if (size > size_bin_) {
@@ -342,6 +430,9 @@ public:
 		  xxh_state(XXH32_createState()),
 		  bin_hash(0),
 		  changed(false),
+		  buffer_dirty(false),
+		  mmap_data(nullptr),
+		  mmap_size(0),
 		  base_path(normalize_path(base_path_, true)) {
 		memset(&header, 0, sizeof(header));
 		if ((reinterpret_cast<char*>(&bin_header.size) - reinterpret_cast<char*>(&bin_header) + sizeof(bin_header.size)) > STORAGE_ALIGNMENT) {
@@ -451,6 +542,8 @@ public:
 				L_ERR("IO error in %s: pread: %s (%d): %s", repr(path.empty() ? base_path : path), error::name(errno), errno, error::description(errno));
 				THROW(StorageIOError, error::description(errno));
 			}
+		} else if (flags & STORAGE_MMAP) {
+			map_file();
 		}
 
 		seek(STORAGE_START_BLOCK_OFFSET);
@@ -464,6 +557,8 @@ public:
 		cmpData.close();
 		cmpFile.close();
 		decFile.close();
+		decData.close();
+		unmap_file();
 
 		if (fd != -1) {
 			if (flags & STORAGE_WRITABLE) {
@@ -478,6 +573,7 @@ public:
 		bin_size = 0;
 		bin_header.size = 0;
 		buffer_offset = 0;
+		buffer_dirty = false;
 		flags = 0;
 		path.clear();
 	}
@@ -491,6 +587,24 @@ public:
 		bin_offset = offset * STORAGE_ALIGNMENT;
 	}
 
+	uint32_t tell() const {
+		return bin_offset / STORAGE_ALIGNMENT;
+	}
+
+	// Skips the bin whose header was just read (i.e. after read()
+	// threw StorageNotFound for a deleted bin).
+	void skip() {
+		L_CALL("Storage::skip()");
+
+		bin_offset += bin_header.size + sizeof(StorageBinFooter);
+
+		// Align the bin_offset to the next storage alignment
+		bin_offset = ((bin_offset + STORAGE_ALIGNMENT - 1) / STORAGE_ALIGNMENT) * STORAGE_ALIGNMENT;
+
+		bin_header.size = 0;
+		bin_size = 0;
+	}
+
 	uint32_t write(const char *data, size_t data_size, void* args=nullptr) {
 		L_CALL("Storage::write() [1]");
 
@@ -576,6 +690,12 @@ public:
 				write_buffer(&buffer, tmp_buffer_offset, block_offset);
 				continue;
 			}
+			if (flags & STORAGE_DEFERRED_WRITE) {
+				// The last block gets written by commit(), so several
+				// writes landing in the same block cost a single pwrite.
+				buffer_dirty = true;
+				break;
+			}
 			if unlikely(io::pwrite(fd, buffer, STORAGE_BLOCK_SIZE, block_offset) != STORAGE_BLOCK_SIZE) {
 				close();
 				L_ERR("IO error in %s: pwrite: %s (%d): %s", repr(path.empty() ? base_path : path), error::name(errno), errno, error::description(errno));
@@ -857,6 +977,16 @@ public:
 
 		changed = false;
 
+		if (buffer_dirty) {
+			buffer_dirty = false;
+			off_t block_offset = ((header.head.offset * STORAGE_ALIGNMENT) / STORAGE_BLOCK_SIZE) * STORAGE_BLOCK_SIZE;
+			if unlikely(io::pwrite(fd, buffer_curr, STORAGE_BLOCK_SIZE, block_offset) != STORAGE_BLOCK_SIZE) {
+				close();
+				L_ERR("IO error in %s: pwrite: %s (%d): %s", repr(path.empty() ? base_path : path), error::name(errno), errno, error::description(errno));
+				THROW(StorageIOError, error::description(errno));
+			}
+		}
+
 		if unlikely(io::pwrite(fd, &header, sizeof(header), 0) != sizeof(header)) {
 			close();
 			L_ERR("IO error in %s: pwrite: %s (%d): %s", repr(path.empty() ? base_path : path), error::name(errno), errno, error::description(errno));
@@ -899,6 +1029,10 @@ public:
 	std::string read(uint32_t limit=-1, void* args=nullptr) {
 		L_CALL("Storage::read() [2]");
 
+		if (mmap_data != nullptr && !bin_header.size) {
+			return read_mapped(limit, args);
+		}
+
 		std::string ret;
 
 		char buf[LZ4_BLOCK_SIZE];
@@ -36,6 +36,9 @@ enum class ThreadPolicyType {
 	replication,
 	committers,
 	fsynchers,
+	scrubbers,
+	searchers,
+	preparers,
 	updaters,
 	http_servers,
 	binary_servers,
@@ -29,6 +29,7 @@
 #include <array>               // for array
 #include <atomic>              // for atomic_bool
 #include <condition_variable>  // for condition_variable
+#include <memory>              // for std::unique_ptr
 #include <mutex>               // for mutex
 #include <stdio.h>             // for size_t, snprintf
 #include <stdlib.h>            // for malloc, free
@@ -38,6 +39,7 @@
 #include <unordered_map>       // for unordered_map
 
 #include "lru.h"               // for LRU
+#include "metrics.h"           // for Metrics::metrics
 #include "wrapper.h"           // for wrap
 
 
@@ -135,16 +137,26 @@ class Processor {
 		v8::Platform* platform;
 		ArrayBufferAllocator allocator;
 
-		ScriptLRU script_lru;
-		std::mutex mtx;
+		// Striped by script hash, each stripe with its own lock.
+		struct Shard {
+			ScriptLRU script_lru;
+			std::mutex mtx;
+
+			explicit Shard(ssize_t shard_size)
+				: script_lru(shard_size) { }
+		};
+
+		std::array<std::unique_ptr<Shard>, SCRIPTS_CACHE_SHARDS> shards;
 
 	public:
 		v8::Isolate::CreateParams create_params;
 
-		explicit Engine(ssize_t max_size)
-			: platform(v8::platform::CreateDefaultPlatform()),
-			  script_lru(max_size)
+		explicit Engine(ssize_t shard_size)
+			: platform(v8::platform::CreateDefaultPlatform())
 		{
+			for (auto& shard : shards) {
+				shard = std::make_unique<Shard>(shard_size);
+			}
 			create_params.array_buffer_allocator = &allocator;
 			v8::V8::InitializePlatform(platform);
 			v8::V8::InitializeICU();
@@ -152,16 +164,25 @@ class Processor {
 		}
 
 		~Engine() {
-			script_lru.clear();
+			for (auto& shard : shards) {
+				shard->script_lru.clear();
+			}
 			v8::V8::Dispose();
 			v8::V8::ShutdownPlatform();
 			delete platform;
 		}
 
 		std::shared_ptr<Processor> compile(size_t script_hash, size_t body_hash, const std::string& script_body) {
-			std::unique_lock<std::mutex> lk(mtx);
-			auto it = script_lru.find(script_hash);
-			if (it != script_lru.end()) {
+			auto& shard = *shards[script_hash % SCRIPTS_CACHE_SHARDS];
+			std::unique_lock<std::mutex> lk(shard.mtx, std::try_to_lock);
+			if (!lk.owns_lock()) {
+				Metrics::metrics()
+					.xapiand_script_cache_contention
+					.Increment();
+				lk.lock();
+			}
+			auto it = shard.script_lru.find(script_hash);
+			if (it != shard.script_lru.end()) {
 				if (script_body.empty() || it->second.first == body_hash) {
 					return it->second.second;
 				}
@@ -171,7 +192,7 @@ class Processor {
 			auto processor = std::make_shared<Processor>(script_body);
 
 			lk.lock();
-			return script_lru.emplace(script_hash, std::make_pair(body_hash, std::move(processor))).first->second.second;
+			return shard.script_lru.emplace(script_hash, std::make_pair(body_hash, std::move(processor))).first->second.second;
 		}
 
 		std::shared_ptr<Processor> compile(const std::string& script_name, const std::string& script_body) {
@@ -526,7 +547,7 @@ public:
 	}
 
 	static Engine& engine() {
-		static Engine engine(SCRIPTS_CACHE_SIZE);
+		static Engine engine(SCRIPTS_CACHE_SHARD_SIZE);
 		return engine;
 	}
 
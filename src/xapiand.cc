@@ -403,15 +403,33 @@ void parseOptions(int argc, char** argv) {
 
 #if XAPIAND_DATABASE_WAL
 		ValueArg<std::size_t> num_async_wal_writers("", "writers", "Number of database async wal writers.", false, std::ceil(NUM_ASYNC_WAL_WRITERS * hardware_concurrency), "writers", cmd);
+		ValueArg<std::size_t> wal_group_commit_delay("", "wal-group-commit-delay", "Maximum milliseconds a wal writer waits to group more lines into one commit.", false, WAL_GROUP_COMMIT_DELAY, "milliseconds", cmd);
+		ValueArg<std::size_t> wal_group_commit_bytes("", "wal-group-commit-bytes", "Maximum bytes a wal writer groups into one commit.", false, WAL_GROUP_COMMIT_BYTES, "bytes", cmd);
 #endif
 #ifdef XAPIAND_CLUSTERING
 		ValueArg<std::size_t> num_replicas("", "replicas", "Default number of database replicas per index.", false, NUM_REPLICAS, "replicas", cmd);
+		SwitchArg replica_compression("", "replica-compression", "Ask for compressed (instead of zero-copy) whole database transfers when replicating.", cmd, false);
+		std::vector<std::string> read_routing_allowed({
+			"first",
+			"round-robin",
+			"least-busy",
+		});
+		ValuesConstraint<std::string> read_routing_constraint(read_routing_allowed);
+		ValueArg<std::string> read_routing("", "read-routing", "Policy for choosing the replica that serves reads (replicas other than the first one may lag behind it).", false, READ_ROUTING, &read_routing_constraint, cmd);
 #endif
 		ValueArg<std::size_t> num_committers("", "committers", "Number of threads handling the commits.", false, std::ceil(NUM_COMMITTERS * hardware_concurrency), "committers", cmd);
 		ValueArg<std::size_t> max_databases("", "max-databases", "Max number of open databases.", false, MAX_DATABASES, "databases", cmd);
 		ValueArg<std::size_t> dbpool_size("", "dbpool-size", "Maximum number of databases in database pool.", false, DBPOOL_SIZE, "size", cmd);
+		ValueArg<std::size_t> query_cache_size("", "query-cache-size", "Maximum number of search results kept in the query cache (0 disables it).", false, QUERY_CACHE_SIZE, "size", cmd);
+		ValueArg<std::size_t> sort_keys_cache_size("", "sort-keys-cache-size", "Maximum bytes of sort keys kept in the sort keys cache (0 disables it).", false, SORT_KEYS_CACHE_SIZE, "bytes", cmd);
 
 		ValueArg<std::size_t> num_fsynchers("", "fsynchers", "Number of threads handling the fsyncs.", false, std::ceil(NUM_FSYNCHERS * hardware_concurrency), "fsynchers", cmd);
+		ValueArg<std::size_t> num_shard_searchers("", "shard-searchers", "Number of threads searching the shards of sorted multi-index queries in parallel (0 searches them all in a single matcher). Queries ordered by relevance always use a single matcher, so weights use statistics from all shards.", false, std::ceil(NUM_SHARD_SEARCHERS * hardware_concurrency), "searchers", cmd);
+		ValueArg<std::size_t> num_bulk_preparers("", "bulk-preparers", "Number of threads preparing bulk operations in parallel (0 prepares them in the writer).", false, std::ceil(NUM_BULK_PREPARERS * hardware_concurrency), "preparers", cmd);
+#ifdef XAPIAND_DATA_STORAGE
+		ValueArg<std::size_t> num_scrubbers("", "scrubbers", "Number of threads verifying data storage volumes in the background (disabled by default).", false, std::ceil(NUM_SCRUBBERS * hardware_concurrency), "scrubbers", cmd);
+		ValueArg<std::size_t> scrub_rate("", "scrub-rate", "Maximum bytes per second each scrubber reads (0 = unlimited).", false, SCRUB_RATE, "bytes", cmd);
+#endif
 		ValueArg<std::size_t> max_files("", "max-files", "Maximum number of files to open.", false, 0, "files", cmd);
 		ValueArg<std::size_t> flush_threshold("", "flush-threshold", "Xapian flush threshold.", false, FLUSH_THRESHOLD, "threshold", cmd);
 
@@ -569,14 +587,26 @@ void parseOptions(int argc, char** argv) {
 		opts.gid = gid.getValue();
 		opts.num_servers = num_servers.getValue();
 		opts.dbpool_size = dbpool_size.getValue();
+		opts.query_cache_size = query_cache_size.getValue();
+		opts.sort_keys_cache_size = sort_keys_cache_size.getValue();
 #if XAPIAND_DATABASE_WAL
 		opts.num_async_wal_writers = num_async_wal_writers.getValue();
+		opts.wal_group_commit_delay = wal_group_commit_delay.getValue();
+		opts.wal_group_commit_bytes = wal_group_commit_bytes.getValue();
 #endif
 #ifdef XAPIAND_CLUSTERING
 		opts.num_replicas = opts.solo ? 0 : num_replicas.getValue();
+		opts.replica_compression = replica_compression.getValue();
+		opts.read_routing = fnv1ah32::hash(read_routing.getValue());
 #endif
 		opts.num_committers = num_committers.getValue();
 		opts.num_fsynchers = num_fsynchers.getValue();
+		opts.num_shard_searchers = num_shard_searchers.getValue();
+		opts.num_bulk_preparers = num_bulk_preparers.getValue();
+#ifdef XAPIAND_DATA_STORAGE
+		opts.num_scrubbers = num_scrubbers.getValue();
+		opts.scrub_rate = scrub_rate.getValue();
+#endif
 		opts.max_clients = max_clients.getValue();
 		opts.max_databases = max_databases.getValue();
 		opts.max_files = max_files.getValue();
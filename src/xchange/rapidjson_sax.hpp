@@ -0,0 +1,200 @@
+/*
+ * Copyright (C) 2019 Dubalu LLC. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <algorithm>                // for std::copy
+#include <cstdint>                  // for int64_t, uint64_t
+#include <cstring>                  // for std::memcpy
+#include <limits>                   // for std::numeric_limits
+#include <vector>                   // for std::vector
+
+#include "msgpack.hpp"              // for msgpack::object, msgpack::zone
+#include "rapidjson/encodedstream.h" // for EncodedInputStream
+#include "rapidjson/memorystream.h" // for MemoryStream
+#include "rapidjson/reader.h"       // for Reader, BaseReaderHandler
+#include "string_view.hh"           // for std::string_view
+
+
+namespace msgpack { MSGPACK_API_VERSION_NAMESPACE(MSGPACK_DEFAULT_API_NS) {
+
+	// rapidjson SAX handler which builds the msgpack::object tree directly
+	// in a msgpack::zone, without an intermediate rapidjson::Document.
+	// Values are pushed to a stack and containers are collapsed into zone
+	// allocated arrays once they end. Numbers get the same msgpack types
+	// the rapidjson::Document adaptor (xchange/rapidjson.hpp) gives them.
+	class json_sax_handler : public rapidjson::BaseReaderHandler<rapidjson::UTF8<>, json_sax_handler> {
+		msgpack::zone& zone;
+		std::vector<msgpack::object> stack;
+
+		bool push(const msgpack::object& obj) {
+			stack.push_back(obj);
+			return true;
+		}
+
+		bool push_str(const char* str, rapidjson::SizeType length) {
+			msgpack::object obj;
+			obj.type = msgpack::type::STR;
+			if (length) {
+				auto ptr = static_cast<char*>(zone.allocate_align(length));
+				std::memcpy(ptr, str, length);
+				obj.via.str.ptr = ptr;
+			} else {
+				obj.via.str.ptr = nullptr;
+			}
+			obj.via.str.size = length;
+			return push(obj);
+		}
+
+		bool push_int(int64_t i) {
+			msgpack::object obj;
+			obj.type = msgpack::type::NEGATIVE_INTEGER;
+			obj.via.i64 = i;
+			return push(obj);
+		}
+
+		bool push_uint(uint64_t u) {
+			msgpack::object obj;
+			obj.type = msgpack::type::POSITIVE_INTEGER;
+			obj.via.u64 = u;
+			return push(obj);
+		}
+
+	public:
+		json_sax_handler(msgpack::zone& zone_) :
+			zone(zone_) {
+			stack.reserve(64);
+		}
+
+		bool Null() {
+			msgpack::object obj;
+			obj.type = msgpack::type::NIL;
+			return push(obj);
+		}
+
+		bool Bool(bool b) {
+			msgpack::object obj;
+			obj.type = msgpack::type::BOOLEAN;
+			obj.via.boolean = b;
+			return push(obj);
+		}
+
+		bool Int(int i) {
+			return push_int(i);
+		}
+
+		bool Uint(unsigned u) {
+			if (u <= static_cast<unsigned>(std::numeric_limits<int>::max())) {
+				return push_int(u);
+			}
+			return push_uint(u);
+		}
+
+		bool Int64(int64_t i) {
+			return push_int(i);
+		}
+
+		bool Uint64(uint64_t u) {
+			if (u <= static_cast<uint64_t>(std::numeric_limits<int64_t>::max())) {
+				return push_int(u);
+			}
+			return push_uint(u);
+		}
+
+		bool Double(double d) {
+			msgpack::object obj;
+			obj.type = msgpack::type::FLOAT;
+			obj.via.f64 = d;
+			return push(obj);
+		}
+
+		bool String(const char* str, rapidjson::SizeType length, bool /*copy*/) {
+			return push_str(str, length);
+		}
+
+		bool Key(const char* str, rapidjson::SizeType length, bool /*copy*/) {
+			return push_str(str, length);
+		}
+
+		bool StartObject() {
+			return true;
+		}
+
+		bool EndObject(rapidjson::SizeType member_count) {
+			msgpack::object obj;
+			obj.type = msgpack::type::MAP;
+			obj.via.map.size = member_count;
+			if (member_count) {
+				auto p = static_cast<msgpack::object_kv*>(zone.allocate_align(sizeof(msgpack::object_kv) * member_count));
+				obj.via.map.ptr = p;
+				auto it = stack.end() - 2 * member_count;
+				for (auto pend = p + member_count; p != pend; ++p) {
+					p->key = *it++;
+					p->val = *it++;
+				}
+				stack.resize(stack.size() - 2 * member_count);
+			} else {
+				obj.via.map.ptr = nullptr;
+			}
+			return push(obj);
+		}
+
+		bool StartArray() {
+			return true;
+		}
+
+		bool EndArray(rapidjson::SizeType element_count) {
+			msgpack::object obj;
+			obj.type = msgpack::type::ARRAY;
+			obj.via.array.size = element_count;
+			if (element_count) {
+				auto p = static_cast<msgpack::object*>(zone.allocate_align(sizeof(msgpack::object) * element_count));
+				obj.via.array.ptr = p;
+				std::copy(stack.end() - element_count, stack.end(), p);
+				stack.resize(stack.size() - element_count);
+			} else {
+				obj.via.array.ptr = nullptr;
+			}
+			return push(obj);
+		}
+
+		msgpack::object get() const {
+			return stack.back();
+		}
+	};
+
+
+	// Parses JSON (with comments and trailing commas, same as json_load)
+	// into obj, allocating everything in zone.
+	inline rapidjson::ParseResult json_parse(msgpack::zone& zone, std::string_view str, msgpack::object& obj) {
+		json_sax_handler handler(zone);
+		rapidjson::Reader reader;
+		rapidjson::MemoryStream ms(str.data(), str.size());
+		rapidjson::EncodedInputStream<rapidjson::UTF8<>, rapidjson::MemoryStream> is(ms);
+		auto parse_done = reader.Parse<rapidjson::kParseCommentsFlag | rapidjson::kParseTrailingCommasFlag>(is, handler);
+		if (parse_done) {
+			obj = handler.get();
+		}
+		return parse_done;
+	}
+
+}}
@@ -0,0 +1,204 @@
+/*
+ * Copyright (C) 2019 Dubalu LLC. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+
+#include "gtest/gtest.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "database_handler.h"
+#include "multivalue/aggregation.h"
+#include "schema.h"
+
+
+// Integers above 2^53, where distinct values collapse when
+// round-tripped through a double.
+static constexpr uint64_t big = 9007199254740992;
+
+
+static std::vector<MsgPack>
+objects()
+{
+	std::vector<MsgPack> objects;
+	const std::vector<std::tuple<uint64_t, uint64_t, const char*>> values({
+		{ 7, big, "a" },
+		{ 3, big + 1, "b" },
+		{ 12, big + 2, "a" },
+		{ 13, big + 2, "b" },
+		{ 5, big + 3, "a" },
+		{ 5, big + 4, "c" },
+		{ 9, big + 5, "b" },
+		{ 1, big + 6, "c" },
+	});
+	for (const auto& value : values) {
+		objects.push_back(MsgPack({
+			{ "value", std::get<0>(value) },
+			{ "big", std::get<1>(value) },
+			{ "tag", std::get<2>(value) },
+		}));
+	}
+	return objects;
+}
+
+
+// Documents as indexed, along with the schema that has their fields.
+static std::pair<std::shared_ptr<Schema>, std::vector<Xapian::Document>>
+index_objects(const std::vector<MsgPack>& objects)
+{
+	DatabaseHandler db_handler;
+	std::shared_ptr<std::pair<std::string, const Data>> old_document_pair;
+
+	Schema initial(Schema::get_initial_schema(), nullptr, "");
+	for (size_t i = 0; i < objects.size(); ++i) {
+		initial.index(objects[i], MsgPack(i + 1), old_document_pair, db_handler);
+	}
+	auto schema = std::make_shared<Schema>(initial.get_modified_schema(), nullptr, "");
+
+	std::vector<Xapian::Document> docs;
+	for (size_t i = 0; i < objects.size(); ++i) {
+		docs.push_back(std::get<1>(schema->index(objects[i], MsgPack(i + 1), old_document_pair, db_handler)));
+	}
+	return std::make_pair(schema, docs);
+}
+
+
+// Aggregates the documents as a whole and in two shards, sending their
+// partial results through the wire format to be merged.
+static void
+aggregate(const std::vector<Xapian::Document>& docs, Aggregation& whole, Aggregation& merged, const MsgPack& aggs, const std::shared_ptr<Schema>& schema)
+{
+	Aggregation shard1(aggs, schema);
+	Aggregation shard2(aggs, schema);
+	for (size_t i = 0; i < docs.size(); ++i) {
+		whole(docs[i]);
+		(i % 2 ? shard2 : shard1)(docs[i]);
+	}
+	merged.merge_results(MsgPack::unserialise(shard1.serialise_results().serialise()));
+	merged.merge_results(MsgPack::unserialise(shard2.serialise_results().serialise()));
+	whole.update();
+	merged.update();
+}
+
+
+// Merged results must be the same as aggregating all documents at once.
+static void
+expect_merged(const MsgPack& aggs)
+{
+	auto indexed = index_objects(objects());
+	Aggregation whole(aggs, indexed.first);
+	Aggregation merged(aggs, indexed.first);
+	aggregate(indexed.second, whole, merged, aggs, indexed.first);
+	EXPECT_EQ(merged.doc_count(), whole.doc_count());
+	EXPECT_EQ(merged.get_result().to_string(), whole.get_result().to_string());
+}
+
+
+TEST(AggregationMergeTest, Metric) {
+	MsgPack aggs({
+		{ "_aggs", {
+			{ "count", { { "_count", { { "_field", "value" } } } } },
+			{ "sum", { { "_sum", { { "_field", "value" } } } } },
+			{ "avg", { { "_avg", { { "_field", "value" } } } } },
+			{ "min", { { "_min", { { "_field", "value" } } } } },
+			{ "max", { { "_max", { { "_field", "value" } } } } },
+			{ "variance", { { "_variance", { { "_field", "value" } } } } },
+			{ "median", { { "_median", { { "_field", "value" } } } } },
+			{ "mode", { { "_mode", { { "_field", "value" } } } } },
+			{ "extended_stats", { { "_extended_stats", { { "_field", "value" } } } } },
+		} },
+	});
+	expect_merged(aggs);
+}
+
+
+TEST(AggregationMergeTest, MetricModeFullPrecision) {
+	MsgPack aggs({
+		{ "_aggs", {
+			{ "mode", { { "_mode", { { "_field", "big" } } } } },
+		} },
+	});
+	auto indexed = index_objects(objects());
+	Aggregation whole(aggs, indexed.first);
+	Aggregation merged(aggs, indexed.first);
+	aggregate(indexed.second, whole, merged, aggs, indexed.first);
+	// big + 2 is the only value seen twice, but as doubles big + 3,
+	// big + 4 and big + 5 would all be counted in a single bin.
+	auto mode = merged.get_agg("mode");
+	ASSERT_NE(mode, nullptr);
+	auto value = mode->get_value_ptr("_mode");
+	ASSERT_NE(value, nullptr);
+	EXPECT_EQ(*value, static_cast<long double>(big + 2));
+}
+
+
+TEST(AggregationMergeTest, Bucket) {
+	MsgPack aggs({
+		{ "_aggs", {
+			{ "tags", { { "_values", { { "_field", "tag" } } } } },
+			{ "values", { { "_values", { { "_field", "value" } } } } },
+			{ "histogram", { { "_histogram", { { "_field", "value" }, { "_interval", 5 } } } } },
+		} },
+	});
+	expect_merged(aggs);
+}
+
+
+TEST(AggregationMergeTest, Nested) {
+	MsgPack aggs({
+		{ "_aggs", {
+			{ "tags", {
+				{ "_values", { { "_field", "tag" } } },
+				{ "_aggs", {
+					{ "sum", { { "_sum", { { "_field", "value" } } } } },
+					{ "mode", { { "_mode", { { "_field", "value" } } } } },
+					{ "values", {
+						{ "_values", { { "_field", "value" } } },
+						{ "_aggs", {
+							{ "max", { { "_max", { { "_field", "value" } } } } },
+						} },
+					} },
+				} },
+			} },
+		} },
+	});
+	expect_merged(aggs);
+}
+
+
+TEST(AggregationMergeTest, BadSerialised) {
+	MsgPack aggs({
+		{ "_aggs", {
+			{ "tags", { { "_values", { { "_field", "tag" } } } } },
+		} },
+	});
+	auto indexed = index_objects(objects());
+	Aggregation merged(aggs, indexed.first);
+	EXPECT_ANY_THROW(merged.merge_results(MsgPack({ 1, 2 })));
+	// Buckets are [slot, idx, results]
+	EXPECT_ANY_THROW(merged.merge_results(MsgPack({ 1, MsgPack({ { "tags", MsgPack({ { "a", MsgPack({ 1, 2 }) } }) } }) })));
+}
@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2019 Dubalu LLC. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "gtest/gtest.h"
+
+#include <random>
+#include <string>
+
+#include "metrics/lcsubsequence.h"
+#include "metrics/levenshtein.h"
+
+
+// Small mixed case alphabet (with a quote, which chars::toupper also maps)
+// so random strings share plenty of characters in both case modes.
+static const std::string alphabet("aAbBcCdD '\"");
+
+
+static std::string
+random_string(std::mt19937& rng, size_t length)
+{
+	std::uniform_int_distribution<size_t> dist(0, alphabet.size() - 1);
+	std::string str;
+	str.reserve(length);
+	for (size_t i = 0; i < length; ++i) {
+		str.push_back(alphabet[dist(rng)]);
+	}
+	return str;
+}
+
+
+// Compares the precomputed pattern (bit-parallel up to 64 characters)
+// against the dynamic programming versions, which get both strings.
+template <typename Metric>
+static void
+expect_equivalent()
+{
+	std::mt19937 rng(42);
+	std::uniform_int_distribution<size_t> text_length(0, 130);
+	for (auto icase : { true, false }) {
+		for (size_t length : { 1, 2, 31, 63, 64, 65 }) {
+			for (size_t i = 0; i < 500; ++i) {
+				auto pattern = random_string(rng, length);
+				auto text = random_string(rng, text_length(rng));
+				Metric metric(pattern, icase);
+				Metric dp(icase);
+				EXPECT_EQ(metric.distance(text), dp.distance(pattern, text)) << pattern << " / " << text << " icase=" << icase;
+				EXPECT_EQ(metric.similarity(text), dp.similarity(pattern, text)) << pattern << " / " << text << " icase=" << icase;
+			}
+		}
+	}
+}
+
+
+TEST(BitParallelTest, Levenshtein) {
+	expect_equivalent<Levenshtein>();
+}
+
+
+TEST(BitParallelTest, LCSubsequence) {
+	expect_equivalent<LCSubsequence>();
+}
+
+
+TEST(BitParallelTest, IgnoreCase) {
+	Levenshtein levenshtein("Web Applications");
+	EXPECT_EQ(levenshtein.distance(std::string("wEB aPPLICATIONS")), 0.0);
+	LCSubsequence lcs("Web Applications");
+	EXPECT_EQ(lcs.similarity(std::string("wEB aPPLICATIONS")), 1.0);
+
+	Levenshtein levenshtein_case("Web Applications", false);
+	EXPECT_NE(levenshtein_case.distance(std::string("wEB aPPLICATIONS")), 0.0);
+	LCSubsequence lcs_case("Web Applications", false);
+	EXPECT_NE(lcs_case.similarity(std::string("wEB aPPLICATIONS")), 1.0);
+}
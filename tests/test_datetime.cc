@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2015-2019 Dubalu LLC. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "gtest/gtest.h"
+
+#include <random>
+#include <regex>
+#include <string>
+#include <vector>
+
+#include "datetime_match.hh"
+
+
+// The regular expressions Datetime::DateMatch and Datetime::date_math_match replace.
+static const std::regex date_re(R"(([0-9]{4})([-/ ]?)(0[1-9]|1[0-2])\2(0[0-9]|[12][0-9]|3[01])([T ]?([01]?[0-9]|2[0-3]):([0-5][0-9])(:([0-5][0-9])([.,]([0-9]+))?)?([ ]*[+-]([01]?[0-9]|2[0-3]):([0-5][0-9])|Z)?)?([ ]*\|\|[ ]*([+-/\dyMwdhms]+))?)", std::regex::optimize);
+static const std::regex date_math_re("([+-]\\d+|\\/{1,2})([dyMwhms])", std::regex::optimize);
+
+
+static const std::vector<std::string> seeds{
+	"2019-01-01",
+	"20190101",
+	"2019 01 01 1:00 Z",
+	"2019/12/31T23:59:59.123+05:30||+1d/M",
+	"2019-01-01T10:00:00,5  -2:30 ||  -10y//d",
+	"2019-01-01||/d",
+	"2019-01-01T10:00Z||+1d",
+	"2019-02-30T24:00",
+	"2019-13-01",
+	"2019-01-01T10:00:00.||+1d",
+};
+
+
+static void
+expect_date_match(const std::string& date)
+{
+	std::cmatch m;
+	Datetime::DateMatch dm;
+	auto matched = std::regex_match(date.c_str(), date.c_str() + date.size(), m, date_re);
+	ASSERT_EQ(dm.match(date), matched) << date;
+	if (matched) {
+		for (size_t group = 0; group < m.size(); ++group) {
+			ASSERT_EQ(dm.matched(group), m[group].matched) << date << " group " << group;
+			ASSERT_EQ(dm.length(group), static_cast<size_t>(m.length(group))) << date << " group " << group;
+			ASSERT_EQ(std::string(dm.str(group)), m.str(group)) << date << " group " << group;
+			if (m[group].matched) {
+				ASSERT_EQ(dm.position(group), static_cast<size_t>(m.position(group))) << date << " group " << group;
+			}
+		}
+	}
+}
+
+
+static void
+expect_date_math_match(const std::string& date_math)
+{
+	size_t size_match = 0;
+	std::vector<std::string> tokens;
+	std::cregex_iterator next(date_math.c_str(), date_math.c_str() + date_math.size(), date_math_re, std::regex_constants::match_continuous);
+	std::cregex_iterator end;
+	for (; next != end; ++next) {
+		size_match += next->length(0);
+		tokens.push_back(next->str(1) + next->str(2));
+	}
+
+	std::vector<std::string> dm_tokens;
+	auto dm_size_match = Datetime::date_math_match(date_math, [&](std::string_view op, char unit) {
+		dm_tokens.push_back(std::string(op) + unit);
+	});
+	ASSERT_EQ(dm_size_match, size_match) << date_math;
+	ASSERT_EQ(dm_tokens, tokens) << date_math;
+}
+
+
+TEST(DatetimeTest, DateMatchSeeds) {
+	for (const auto& seed : seeds) {
+		expect_date_match(seed);
+	}
+}
+
+
+TEST(DatetimeTest, DateMatchFuzz) {
+	constexpr char alphabet[] = "0123456789-/ T:.,+Z|yMwdhmsx";
+	std::mt19937 rng(2019);
+	for (int i = 0; i < 200000; ++i) {
+		auto date = seeds[rng() % seeds.size()];
+		for (auto mutations = rng() % 4; mutations; --mutations) {
+			auto pos = rng() % (date.size() + 1);
+			auto chr = alphabet[rng() % (sizeof(alphabet) - 1)];
+			switch (rng() % 3) {
+				case 0:
+					date.insert(date.begin() + pos, chr);
+					break;
+				case 1:
+					if (pos < date.size()) {
+						date.erase(pos, 1);
+					}
+					break;
+				default:
+					if (pos < date.size()) {
+						date[pos] = chr;
+					}
+					break;
+			}
+		}
+		expect_date_match(date);
+		if (HasFatalFailure()) {
+			return;
+		}
+		expect_date_math_match(date.substr(rng() % (date.size() + 1)));
+		if (HasFatalFailure()) {
+			return;
+		}
+	}
+}
@@ -0,0 +1,283 @@
+/*
+ * Copyright (C) 2019 Dubalu LLC. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <map>
+#include <random>
+#include <vector>
+
+#include "multivalue/sketch.h"
+
+
+static constexpr size_t num_values = 100000;
+
+
+static std::vector<long double>
+sample(const std::string& distribution)
+{
+	std::mt19937_64 rng(42);
+	std::vector<long double> values;
+	values.reserve(num_values);
+	if (distribution == "uniform") {
+		std::uniform_real_distribution<double> dist(0.0, 1000.0);
+		for (size_t i = 0; i < num_values; ++i) {
+			values.push_back(dist(rng));
+		}
+	} else if (distribution == "normal") {
+		std::normal_distribution<double> dist(0.0, 1.0);
+		for (size_t i = 0; i < num_values; ++i) {
+			values.push_back(dist(rng));
+		}
+	} else if (distribution == "exponential") {
+		std::exponential_distribution<double> dist(1.0);
+		for (size_t i = 0; i < num_values; ++i) {
+			values.push_back(dist(rng));
+		}
+	}
+	return values;
+}
+
+
+// Rank error: fraction of the (sorted) values between the requested
+// quantile and the estimate, which is what the t-digest bounds.
+static long double
+rank_error(const std::vector<long double>& sorted, long double q, long double estimate)
+{
+	auto lower = std::lower_bound(sorted.begin(), sorted.end(), estimate) - sorted.begin();
+	auto upper = std::upper_bound(sorted.begin(), sorted.end(), estimate) - sorted.begin();
+	auto target = q * sorted.size();
+	if (target < lower) {
+		return (lower - target) / sorted.size();
+	}
+	if (target > upper) {
+		return (target - upper) / sorted.size();
+	}
+	return 0;
+}
+
+
+// The k1 scale function keeps the error proportional to q (1 - q),
+// so the tails are held to a much tighter bound than the median.
+static long double
+max_rank_error(long double q)
+{
+	return 0.001L + 0.01L * q * (1 - q);
+}
+
+
+static void
+expect_quantiles(TDigest& digest, std::vector<long double> values, const std::string& distribution)
+{
+	std::sort(values.begin(), values.end());
+	EXPECT_EQ(digest.size(), values.size()) << distribution;
+	EXPECT_EQ(digest.quantile(0), values.front()) << distribution;
+	EXPECT_EQ(digest.quantile(1), values.back()) << distribution;
+	for (auto q : { 0.001L, 0.01L, 0.1L, 0.25L, 0.5L, 0.75L, 0.9L, 0.99L, 0.999L }) {
+		EXPECT_LE(rank_error(values, q, digest.quantile(q)), max_rank_error(q)) << distribution << " q=" << static_cast<double>(q);
+	}
+}
+
+
+TEST(TDigestTest, Empty) {
+	TDigest digest;
+	EXPECT_EQ(digest.size(), 0);
+	EXPECT_EQ(digest.quantile(0.5), 0);
+}
+
+
+TEST(TDigestTest, SingleValue) {
+	TDigest digest;
+	digest.add(7);
+	EXPECT_EQ(digest.quantile(0), 7);
+	EXPECT_EQ(digest.quantile(0.5), 7);
+	EXPECT_EQ(digest.quantile(1), 7);
+}
+
+
+TEST(TDigestTest, QuantileError) {
+	for (const auto& distribution : { "uniform", "normal", "exponential" }) {
+		auto values = sample(distribution);
+		TDigest digest;
+		for (auto value : values) {
+			digest.add(value);
+		}
+		expect_quantiles(digest, values, distribution);
+	}
+}
+
+
+TEST(TDigestTest, SortedInput) {
+	auto values = sample("uniform");
+	std::sort(values.begin(), values.end());
+	TDigest digest;
+	for (auto value : values) {
+		digest.add(value);
+	}
+	expect_quantiles(digest, values, "sorted");
+}
+
+
+TEST(TDigestTest, Merge) {
+	for (const auto& distribution : { "uniform", "normal", "exponential" }) {
+		auto values = sample(distribution);
+		std::vector<TDigest> shards(4);
+		for (size_t i = 0; i < values.size(); ++i) {
+			shards[i % shards.size()].add(values[i]);
+		}
+		TDigest digest;
+		for (auto& shard : shards) {
+			shard.quantile(0.5);  // compress the shard before serialising it
+			digest.merge(shard.serialise());
+		}
+		expect_quantiles(digest, values, distribution);
+	}
+}
+
+
+TEST(TDigestTest, BadSerialised) {
+	TDigest digest;
+	EXPECT_ANY_THROW(digest.merge(MsgPack(1)));
+	MsgPack bad(MsgPack::Type::ARRAY);
+	bad.append(MsgPack(MsgPack::Type::ARRAY));
+	EXPECT_ANY_THROW(digest.merge(bad));
+}
+
+
+// Zipf-like stream: value i appears about n / (i + 1) / H times.
+static std::vector<long double>
+skewed(size_t distinct)
+{
+	std::mt19937_64 rng(42);
+	std::vector<double> weights;
+	for (size_t i = 0; i < distinct; ++i) {
+		weights.push_back(1.0 / (i + 1));
+	}
+	std::discrete_distribution<size_t> dist(weights.begin(), weights.end());
+	std::vector<long double> values;
+	values.reserve(num_values);
+	for (size_t i = 0; i < num_values; ++i) {
+		values.push_back(dist(rng));
+	}
+	return values;
+}
+
+
+// Misra-Gries guarantees: counts are never overestimated, are
+// underestimated by at most n / (counters + 1) and any value seen
+// more than n / counters times is kept.
+static void
+expect_heavy_hitters(const FrequentItems& items, const std::vector<long double>& values, size_t counters)
+{
+	std::map<long double, size_t> exact;
+	for (auto value : values) {
+		++exact[value];
+	}
+	auto n = values.size();
+	for (const auto& item : exact) {
+		auto estimate = items.count(item.first);
+		EXPECT_LE(estimate, item.second) << static_cast<double>(item.first);
+		EXPECT_GE(estimate + n / (counters + 1), item.second) << static_cast<double>(item.first);
+		if (item.second > n / counters) {
+			EXPECT_GT(estimate, 0) << static_cast<double>(item.first);
+		}
+	}
+	auto most = std::max_element(exact.begin(), exact.end(), [](const auto& a, const auto& b) {
+		return a.second < b.second;
+	});
+	EXPECT_EQ(items.most_frequent().first, most->first);
+}
+
+
+TEST(FrequentItemsTest, Empty) {
+	FrequentItems items;
+	EXPECT_TRUE(items.empty());
+	EXPECT_EQ(items.count(1), 0);
+}
+
+
+TEST(FrequentItemsTest, HeavyHitters) {
+	for (size_t counters : { 10, 100 }) {
+		auto values = skewed(10000);
+		FrequentItems items(counters);
+		for (auto value : values) {
+			items.add(value);
+		}
+		EXPECT_LT(items.size(), counters * 2);
+		expect_heavy_hitters(items, values, counters);
+	}
+}
+
+
+TEST(FrequentItemsTest, Merge) {
+	for (size_t counters : { 10, 100 }) {
+		auto values = skewed(10000);
+		std::vector<FrequentItems> shards(4, FrequentItems(counters));
+		for (size_t i = 0; i < values.size(); ++i) {
+			shards[i % shards.size()].add(values[i]);
+		}
+		FrequentItems items(counters);
+		for (const auto& shard : shards) {
+			items.merge(shard.serialise());
+		}
+		EXPECT_LE(items.size(), counters);
+		expect_heavy_hitters(items, values, counters);
+	}
+}
+
+
+TEST(FrequentItemsTest, Exact) {
+	// With no more distinct values than counters nothing is pruned.
+	FrequentItems items(10);
+	for (size_t i = 0; i < 10; ++i) {
+		items.add(i, i + 1);
+	}
+	for (size_t i = 0; i < 10; ++i) {
+		EXPECT_EQ(items.count(i), i + 1);
+	}
+	EXPECT_EQ(items.most_frequent(), std::make_pair(9.0L, static_cast<size_t>(10)));
+}
+
+
+TEST(FrequentItemsTest, BadSerialised) {
+	FrequentItems items;
+	EXPECT_ANY_THROW(items.merge(MsgPack(1)));
+	MsgPack bad(MsgPack::Type::ARRAY);
+	bad.append(MsgPack(MsgPack::Type::ARRAY));
+	EXPECT_ANY_THROW(items.merge(bad));
+}
+
+
+TEST(FrequentItemsTest, MergeFullPrecision) {
+	// Above 2^53 these are different values only as long doubles.
+	const long double big = 9007199254740992.0L;
+	FrequentItems shard;
+	shard.add(big + 1, 3);
+	shard.add(big, 2);
+	FrequentItems items;
+	items.merge(MsgPack::unserialise(shard.serialise().serialise()));
+	EXPECT_EQ(items.count(big + 1), 3);
+	EXPECT_EQ(items.count(big), 2);
+	EXPECT_EQ(items.most_frequent().first, big + 1);
+}